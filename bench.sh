@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# bench.sh - Benchmarks for wavsilence (make bench)
+#
+# Makes a set of synthetic WAVs with wavgen and runs wavsilence over them
+# with a matrix of -b, -s, -P and -l settings.  wavbench prints one JSON
+# line per run (MB/s, peak RSS, system calls per MB); they all go to
+# $BENCH_OUT, so two of them can be compared to find a regression.
+#
+#   BENCH_SECONDS  Length of the inputs in seconds (default: 300)
+#   BENCH_RUNS     Timed runs per setting, the best one counts (default: 3)
+#   BENCH_DIR      Where the inputs and pieces go (default: bench.tmp)
+#   BENCH_OUT      Results (default: bench.json)
+#
+
+SECONDS_=${BENCH_SECONDS:-300}
+RUNS=${BENCH_RUNS:-3}
+DIR=${BENCH_DIR:-bench.tmp}
+OUT=${BENCH_OUT:-bench.json}
+
+TOP=$(pwd)
+WAVSILENCE=$TOP/wavsilence
+WAVGEN=$TOP/wavgen
+WAVBENCH=$TOP/wavbench
+
+mkdir -p "$DIR" || exit 1
+case "$OUT" in /*) ;; *) OUT=$TOP/$OUT ;; esac
+: > "$OUT"
+
+# name: wavgen options
+INPUTS="
+s16-stereo:-c 2 -b 16 -d 0.2 -n 0.001
+s16-stereo-sparse:-c 2 -b 16 -d 0.8 -n 0.02
+u8-mono:-c 1 -b 8 -r 22050 -d 0.3 -n 0.005
+s24-stereo:-c 2 -b 24 -r 48000 -d 0.2 -n 0.001
+f32-stereo:-c 2 -f -r 48000 -d 0.2 -n 0.001
+s16-surround:-c 6 -b 16 -r 48000 -d 0.1 -n 0.001
+"
+
+# name: wavsilence options
+SETTINGS="
+b64:-b 64
+b4096:-b 4096
+b4096-skip:-b 4096 -s
+b4096-log:-b 4096 -l bench.log
+b4096-pipe:-b 4096
+"
+
+echo "$INPUTS" | while IFS=: read input gen; do
+  [ -n "$input" ] || continue
+  if [ ! -f "$DIR/$input.wav" ]; then
+    $WAVGEN -o "$DIR/$input.wav" -l "$SECONDS_" $gen || exit 1
+  fi
+done || exit 1
+
+run() {
+  name=$1; input=$2; shift 2
+  rm -rf "$DIR/out"
+  mkdir "$DIR/out"
+  (cd "$DIR/out" && $WAVBENCH -n "$name" -r "$RUNS" -f "../$input.wav" "$@") \
+    | tee -a "$OUT"
+}
+
+echo "$INPUTS" | while IFS=: read input gen; do
+  [ -n "$input" ] || continue
+  echo "$SETTINGS" | while IFS=: read setting ws; do
+    [ -n "$setting" ] || continue
+    # -P takes a shell command, which doesn't survive the word splitting
+    case "$setting" in
+    *-pipe) set -- -P "cat >/dev/null" ;;
+    *) set -- ;;
+    esac
+    run "$input/$setting/file" "$input" -- \
+      $WAVSILENCE -g 0.5 -t 3 $ws "$@" -i "../$input.wav"
+    run "$input/$setting/stdin" "$input" -i -- \
+      $WAVSILENCE -g 0.5 -t 3 $ws "$@"
+  done
+done
+
+rm -rf "$DIR/out"
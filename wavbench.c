@@ -0,0 +1,266 @@
+/*  wavbench.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Runs a command a few times for the benchmarks (make bench) and prints
+    one JSON line: the best time, MB/s for the input, the peak RSS, and the
+    system calls the command made per MB.
+
+    The time and the RSS come from untraced runs.  The system calls are
+    counted in one more run under ptrace(), following the command's threads
+    but not the programs it starts (-P), so they stay out of the timings.
+*/
+
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+
+char *name;
+char *input;            // The WAV the command reads, for MB/s
+int feed_stdin;         // Give input to the command as stdin
+int runs;
+int count_syscalls;
+
+void print_usage() {
+
+  printf("usage: wavbench <options> -f file -- command [args]\n");
+  printf("Options:\n");
+  printf("  -f <file>  The input the command reads, for MB/s\n");
+  printf("  -i         Give <file> to the command as stdin\n");
+  printf("  -n <name>  Name of the benchmark\n");
+  printf("  -r <runs>  Timed runs; the best one counts (default: 3)\n");
+  printf("  -T         Don't count system calls\n");
+  printf("  -h         Show this message\n");
+
+  printf("\n");
+}
+
+void process_args(int argc, char**argv) {
+
+  int c;
+
+  while((c = getopt(argc, argv, "+f:in:r:Th")) != -1) {
+    switch(c) {
+    case 'f':
+      input = optarg;
+      break;
+    case 'i':
+      feed_stdin = 1;
+      break;
+    case 'n':
+      name = optarg;
+      break;
+    case 'r':
+      runs = atoi(optarg);
+      if(runs <= 0) {
+	printf("Invalid number of runs!\n");
+	exit(1);
+      }
+      break;
+    case 'T':
+      count_syscalls = 0;
+      break;
+    case 'h':
+      print_usage();
+      exit(0);
+    default:
+      exit(1);
+    }
+  }
+
+}
+
+// In the child: stdin from the input if asked, output thrown away
+void start_child(char **command, int traced) {
+
+  int fd;
+
+  if(feed_stdin) {
+    fd = open(input, O_RDONLY);
+    if(fd == -1)
+      _exit(127);
+    dup2(fd, 0);
+    close(fd);
+  }
+
+  fd = open("/dev/null", O_WRONLY);
+  if(fd != -1) {
+    dup2(fd, 1);
+    dup2(fd, 2);
+    close(fd);
+  }
+
+  if(traced && (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1))
+    _exit(127);
+
+  execvp(command[0], command);
+  _exit(127);
+
+}
+
+// Returns the wall time of one run, or -1 if it failed
+double timed_run(char **command, long *max_rss) {
+
+  struct timespec start, end;
+  struct rusage ru;
+  pid_t pid;
+  int status;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pid = fork();
+  if(pid == 0)
+    start_child(command, 0);
+  if(pid == -1)
+    return -1;
+
+  if(wait4(pid, &status, 0, &ru) != pid)
+    return -1;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if(!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    return -1;
+
+  if(ru.ru_maxrss > *max_rss)
+    *max_rss = ru.ru_maxrss;
+
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Returns the system calls of one run, or -1 if it can't be traced
+long long traced_run(char **command) {
+
+  struct __ptrace_syscall_info info;
+  long long calls = 0;
+  pid_t pid, child;
+  int status, sig;
+
+  child = fork();
+  if(child == 0)
+    start_child(command, 1);
+  if(child == -1)
+    return -1;
+
+  // Stopped by the exec
+  if((waitpid(child, &status, 0) != child) || !WIFSTOPPED(status))
+    return -1;
+
+  ptrace(PTRACE_SETOPTIONS, child, NULL,
+	 PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL);
+  ptrace(PTRACE_SYSCALL, child, NULL, NULL);
+
+  while((pid = waitpid(-1, &status, __WALL)) > 0) {
+
+    if(WIFEXITED(status) || WIFSIGNALED(status)) {
+      if(pid == child)
+	break;
+      continue;
+    }
+
+    sig = WSTOPSIG(status);
+
+    if(sig == (SIGTRAP | 0x80)) {
+      if((ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) > 0) &&
+	 (info.op == PTRACE_SYSCALL_INFO_ENTRY))
+	calls++;
+      sig = 0;
+    } else if((sig == SIGTRAP) || (sig == SIGSTOP))
+      sig = 0;  // Clone events, and new threads starting
+
+    ptrace(PTRACE_SYSCALL, pid, NULL, sig);
+  }
+
+  if(!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    return -1;
+
+  return calls;
+}
+
+int main(int argc, char**argv) {
+
+  struct stat st;
+  double best = -1, t, mb;
+  long max_rss = 0;
+  long long calls = -1;
+  int i;
+
+  name = "";
+  input = NULL;
+  feed_stdin = 0;
+  runs = 3;
+  count_syscalls = 1;
+
+  process_args(argc, argv);
+
+  if((input == NULL) || (optind >= argc)) {
+    print_usage();
+    return 1;
+  }
+
+  if(stat(input, &st) == -1) {
+    perror(input);
+    return 1;
+  }
+
+  mb = st.st_size / 1048576.0;
+
+  for(i = 0; i < runs; i++) {
+    t = timed_run(argv + optind, &max_rss);
+    if(t < 0) {
+      fprintf(stderr, "%s: %s failed\n", name, argv[optind]);
+      return 1;
+    }
+    if((best < 0) || (t < best))
+      best = t;
+  }
+
+  if(count_syscalls)
+    calls = traced_run(argv + optind);
+
+  printf("{\"name\": \"%s\", \"mb\": %.3f, \"seconds\": %.4f, "
+	 "\"mb_per_s\": %.1f, \"peak_rss_kb\": %ld, ",
+	 name, mb, best, best > 0 ? mb / best : 0, max_rss);
+
+  if(calls >= 0)
+    printf("\"syscalls\": %lld, \"syscalls_per_mb\": %.1f}\n",
+	   calls, mb > 0 ? calls / mb : 0);
+  else
+    printf("\"syscalls\": null, \"syscalls_per_mb\": null}\n");
+
+  return 0;
+}
@@ -0,0 +1,211 @@
+/*  wavcopy.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    Piece copying for -K.
+
+    Once the pieces are planned, each one is the header and a range of the
+    input.  Cloning only works on whole filesystem blocks at the same
+    offset within a block in both files, so the caller pads the header
+    (align_data()) and the blocks in the middle of the range are cloned,
+    with the partial blocks at its ends copied.  Whichever way fails with
+    "not supported here" isn't tried again.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#include "wavcopy.h"
+
+#define COPY_BUFFER     (1024 * 1024)
+#define DEFAULT_BLOCK   4096
+#define MAX_BLOCK       65536
+
+int copier_init(struct ws_copier *c, int in_fd) {
+
+  struct stat st;
+
+  memset(c, 0, sizeof(*c));
+
+  if(fstat(in_fd, &st) == -1) {
+    perror("input file");
+    return 0;
+  }
+
+  c->in_fd = in_fd;
+  c->in_size = st.st_size;
+  c->block = st.st_blksize;
+  if((c->block < 512) || (c->block > MAX_BLOCK) ||
+     (c->block & (c->block - 1)))
+    c->block = DEFAULT_BLOCK;
+
+#ifdef FICLONE_RANGE
+  c->clone = 1;
+#endif
+  c->copy_range = 1;
+
+  c->buffer = malloc(COPY_BUFFER);
+  if(c->buffer == NULL) {
+    fprintf(stderr, "copy: Could not allocate a buffer\n");
+    return 0;
+  }
+
+  return 1;
+}
+
+void copier_free(struct ws_copier *c) {
+
+  free(c->buffer);
+  c->buffer = NULL;
+
+}
+
+// The errors that mean a way of copying doesn't work for these files
+static int unsupported(int error) {
+
+  return (error == EOPNOTSUPP) || (error == ENOTTY) || (error == EXDEV) ||
+         (error == EINVAL) || (error == ENOSYS) || (error == EPERM) ||
+         (error == ETXTBSY);
+
+}
+
+static int copy_buffered(struct ws_copier *c, off_t in_offset, int out_fd,
+                         off_t out_offset, off_t length) {
+
+  ssize_t size, done, n;
+  off_t left;
+
+  for(left = length; left > 0; left -= size) {
+
+    size = (left < COPY_BUFFER) ? left : COPY_BUFFER;
+    size = pread(c->in_fd, c->buffer, size, in_offset);
+    if(size <= 0) {
+      perror("input file");
+      return 0;
+    }
+
+    for(done = 0; done < size; ) {
+      n = pwrite(out_fd, c->buffer + done, size - done,
+                         out_offset + done);
+      if(n <= 0) {
+        perror("output file");
+        return 0;
+      }
+      done += n;
+    }
+
+    in_offset += size;
+    out_offset += size;
+    c->copied += size;
+  }
+
+  return 1;
+}
+
+static int copy_kernel(struct ws_copier *c, off_t in_offset, int out_fd,
+                       off_t out_offset, off_t length) {
+
+  loff_t in = in_offset, out = out_offset;
+  ssize_t n;
+
+  while(c->copy_range && (length > 0)) {
+
+    n = copy_file_range(c->in_fd, &in, out_fd, &out, length, 0);
+
+    if(n == -1) {
+      if(errno == EINTR)
+        continue;
+      if(!unsupported(errno)) {
+        perror("copy_file_range");
+        return 0;
+      }
+      c->copy_range = 0;
+      break;
+    }
+
+    // The input ended early
+    if(n == 0) {
+      fprintf(stderr, "copy: Input ended at offset %lld\n", (long long)in);
+      return 0;
+    }
+
+    c->ranged += n;
+    length -= n;
+  }
+
+  return copy_buffered(c, in, out_fd, out, length);
+}
+
+// Copies length bytes of the input at in_offset to out_fd at out_offset.
+// Returns 0 on error.
+int copier_copy(struct ws_copier *c, off_t in_offset, int out_fd,
+                off_t out_offset, off_t length) {
+
+#ifdef FICLONE_RANGE
+  struct file_clone_range range;
+  off_t start, end;
+
+  // Whole blocks, or up to the end of the input
+  start = (in_offset + c->block - 1) & ~(off_t)(c->block - 1);
+  end = in_offset + length;
+  if(end < c->in_size)
+    end &= ~(off_t)(c->block - 1);
+
+  if(c->clone && (end > start) &&
+     (((out_offset - in_offset) & (c->block - 1)) == 0)) {
+
+    range.src_fd = c->in_fd;
+    range.src_offset = start;
+    range.src_length = end - start;
+    range.dest_offset = out_offset + (start - in_offset);
+
+    if(ioctl(out_fd, FICLONE_RANGE, &range) == 0) {
+      c->cloned += end - start;
+      return copy_kernel(c, in_offset, out_fd, out_offset, start - in_offset)
+        && copy_kernel(c, end, out_fd, out_offset + (end - in_offset),
+                       in_offset + length - end);
+    }
+
+    if(!unsupported(errno)) {
+      perror("FICLONE_RANGE");
+      return 0;
+    }
+
+    c->clone = 0;
+  }
+#endif
+
+  return copy_kernel(c, in_offset, out_fd, out_offset, length);
+}
@@ -0,0 +1,61 @@
+/*  wavcopy.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_COPY_H
+#define WAV_COPY_H
+
+#include <sys/types.h>
+
+// Copies ranges of the input into pieces, sharing the input's extents where
+// the filesystem can (FICLONE_RANGE), in the kernel where it can't
+// (copy_file_range()), and through a buffer as a last resort
+struct ws_copier {
+
+  int in_fd;
+  off_t in_size;
+  unsigned int block;       // Filesystem block size, a power of two
+
+  int clone;                // Still worth trying each way
+  int copy_range;
+
+  unsigned char *buffer;
+
+  long long cloned;         // Bytes done each way
+  long long ranged;
+  long long copied;
+
+};
+
+// Functions
+
+int copier_init(struct ws_copier *c, int in_fd);
+void copier_free(struct ws_copier *c);
+
+int copier_copy(struct ws_copier *c, off_t in_offset, int out_fd,
+                off_t out_offset, off_t length);
+
+#endif
@@ -0,0 +1,1343 @@
+/*  wavdetect.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Block silence detection.
+
+    A sample is silent when -boundary < sample < boundary, which is the test
+    is_silence() used to make one sample at a time.  The kernels below look at
+    a whole block instead and only report what process_data() needs from it:
+    whether any sample was loud, and how many silent samples trail the last
+    loud one.  Because of that they scan backwards and can stop at the first
+    loud sample they find, which on normal material is in the last vector.
+
+    There is a set of kernels for each sample format (8-bit unsigned, 16, 24
+    and 32-bit signed PCM, and 32 and 64-bit float), and detect_init() picks
+    one for the input's format and the CPU, with the threshold already
+    scaled to the format, so nothing in the per-sample loops depends on the
+    format.  The threshold means the same for all of them: a fraction of
+    full scale, so -t 3 is about -30 dBFS whatever the input is.
+
+    With -k the channels are tracked one by one: each has its own count of
+    silent frames, and the policy takes the largest (any channel silent) or
+    that of one channel.  The channel kernels compare whole interleaved
+    vectors as above and deinterleave the loud mask instead of the samples:
+    a table gives, for each phase of the frame a vector starts in, the mask
+    bits of the channels still wanted, so a dead channel next to a live
+    one costs no more than a silent block.  8-bit and 64-bit float inputs
+    have only the scalar channel kernels, which walk each channel back.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#include "wavdetect.h"
+
+// Thresholds that can't be expressed in the sample format: nothing or
+// everything is silence.
+static int scan_none(const struct ws_detector *d, const void *samples,
+                     int count, int *tail) {
+  *tail = 0;
+  return count > 0;
+}
+
+static int scan_all(const struct ws_detector *d, const void *samples,
+                    int count, int *tail) {
+  *tail = count;
+  return 0;
+}
+
+// 24-bit samples are three bytes, little endian
+static inline int s24(const unsigned char *p) {
+
+  return p[0] | (p[1] << 8) | ((signed char)p[2] * 65536);
+
+}
+
+static int scan_s16(const struct ws_detector *d, const void *samples,
+                    int count, int *tail) {
+
+  const short *s = samples;
+  int i;
+
+  for(i = count - 1; i >= 0; i--)
+    if(s[i] > d->hi || s[i] < d->lo)
+      break;
+
+  *tail = count - 1 - i;
+
+  return i >= 0;
+}
+
+static int scan_u8(const struct ws_detector *d, const void *samples,
+                   int count, int *tail) {
+
+  const unsigned char *s = samples;
+  int i, v;
+
+  for(i = count - 1; i >= 0; i--) {
+    v = s[i] - 128;
+    if(v > d->ihi || v < d->ilo)
+      break;
+  }
+
+  *tail = count - 1 - i;
+
+  return i >= 0;
+}
+
+static int scan_s24(const struct ws_detector *d, const void *samples,
+                    int count, int *tail) {
+
+  const unsigned char *s = samples;
+  int i, v;
+
+  for(i = count - 1; i >= 0; i--) {
+    v = s24(s + 3 * i);
+    if(v > d->ihi || v < d->ilo)
+      break;
+  }
+
+  *tail = count - 1 - i;
+
+  return i >= 0;
+}
+
+static int scan_s32(const struct ws_detector *d, const void *samples,
+                    int count, int *tail) {
+
+  const int *s = samples;
+  int i;
+
+  for(i = count - 1; i >= 0; i--)
+    if(s[i] > d->ihi || s[i] < d->ilo)
+      break;
+
+  *tail = count - 1 - i;
+
+  return i >= 0;
+}
+
+// NaNs count as loud
+static int scan_f32(const struct ws_detector *d, const void *samples,
+                    int count, int *tail) {
+
+  const float *s = samples;
+  int i;
+
+  for(i = count - 1; i >= 0; i--)
+    if(!(fabsf(s[i]) < d->fhi))
+      break;
+
+  *tail = count - 1 - i;
+
+  return i >= 0;
+}
+
+static int scan_f64(const struct ws_detector *d, const void *samples,
+                    int count, int *tail) {
+
+  const double *s = samples;
+  int i;
+
+  for(i = count - 1; i >= 0; i--)
+    if(!(fabs(s[i]) < d->dhi))
+      break;
+
+  *tail = count - 1 - i;
+
+  return i >= 0;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// The vector kernels check the odd samples at the end of the block one at a
+// time, then whole vectors going backwards.  In a loud vector, the highest
+// mask bit belongs to the last loud sample; bits is how many mask bits each
+// sample has.
+#define LAST_LOUD(i, mask, bits)  ((i) + (31 - __builtin_clz(mask)) / (bits))
+
+__attribute__((target("sse2")))
+static int scan_s16_sse2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const short *s = samples;
+  __m128i hi = _mm_set1_epi16(d->hi);
+  __m128i lo = _mm_set1_epi16(d->lo);
+  __m128i v, loud;
+  int i = count;
+  int mask;
+
+  while(i % 8) {
+    i--;
+    if(s[i] > d->hi || s[i] < d->lo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 8;
+    v = _mm_loadu_si128((const __m128i *)(s + i));
+    loud = _mm_or_si128(_mm_cmpgt_epi16(v, hi), _mm_cmpgt_epi16(lo, v));
+    mask = _mm_movemask_epi8(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 2);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("avx2")))
+static int scan_s16_avx2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const short *s = samples;
+  __m256i hi = _mm256_set1_epi16(d->hi);
+  __m256i lo = _mm256_set1_epi16(d->lo);
+  __m256i v, loud;
+  int i = count;
+  unsigned int mask;
+
+  while(i % 16) {
+    i--;
+    if(s[i] > d->hi || s[i] < d->lo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 16;
+    v = _mm256_loadu_si256((const __m256i *)(s + i));
+    loud = _mm256_or_si256(_mm256_cmpgt_epi16(v, hi),
+                           _mm256_cmpgt_epi16(lo, v));
+    mask = _mm256_movemask_epi8(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 2);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+// 8-bit samples are unsigned; flipping the top bit makes them signed bytes
+// centred on 0, which the signed compares can take.
+__attribute__((target("sse2")))
+static int scan_u8_sse2(const struct ws_detector *d, const void *samples,
+                        int count, int *tail) {
+
+  const unsigned char *s = samples;
+  __m128i flip = _mm_set1_epi8(-128);
+  __m128i hi = _mm_set1_epi8(d->ihi);
+  __m128i lo = _mm_set1_epi8(d->ilo);
+  __m128i v, loud;
+  int i = count;
+  int mask, x;
+
+  while(i % 16) {
+    i--;
+    x = s[i] - 128;
+    if(x > d->ihi || x < d->ilo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 16;
+    v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(s + i)), flip);
+    loud = _mm_or_si128(_mm_cmpgt_epi8(v, hi), _mm_cmpgt_epi8(lo, v));
+    mask = _mm_movemask_epi8(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("avx2")))
+static int scan_u8_avx2(const struct ws_detector *d, const void *samples,
+                        int count, int *tail) {
+
+  const unsigned char *s = samples;
+  __m256i flip = _mm256_set1_epi8(-128);
+  __m256i hi = _mm256_set1_epi8(d->ihi);
+  __m256i lo = _mm256_set1_epi8(d->ilo);
+  __m256i v, loud;
+  int i = count;
+  unsigned int mask;
+  int x;
+
+  while(i % 32) {
+    i--;
+    x = s[i] - 128;
+    if(x > d->ihi || x < d->ilo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 32;
+    v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(s + i)), flip);
+    loud = _mm256_or_si256(_mm256_cmpgt_epi8(v, hi),
+                           _mm256_cmpgt_epi8(lo, v));
+    mask = _mm256_movemask_epi8(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+// 24-bit samples are shuffled into the top three bytes of 32-bit lanes, so
+// each lane holds sample * 256 and is compared against the limits * 256.  A
+// 16-byte load holds four samples and four bytes of the next, so the last
+// couple of samples in the block are left to the scalar loop.
+__attribute__((target("ssse3")))
+static int scan_s24_ssse3(const struct ws_detector *d, const void *samples,
+                          int count, int *tail) {
+
+  const unsigned char *s = samples;
+  __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                  -1, 6, 7, 8, -1, 9, 10, 11);
+  __m128i hi = _mm_set1_epi32(d->ihi * 256);
+  __m128i lo = _mm_set1_epi32(d->ilo * 256);
+  __m128i v, loud;
+  int i = count;
+  int mask, x;
+
+  while((i % 4) || (i > count - 2)) {
+    if(i == 0)
+      break;
+    i--;
+    x = s24(s + 3 * i);
+    if(x > d->ihi || x < d->ilo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 4;
+    v = _mm_loadu_si128((const __m128i *)(s + 3 * i));
+    v = _mm_shuffle_epi8(v, shuffle);
+    loud = _mm_or_si128(_mm_cmpgt_epi32(v, hi), _mm_cmpgt_epi32(lo, v));
+    mask = _mm_movemask_ps(_mm_castsi128_ps(loud));
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_s24_avx2(const unsigned char *p, __m256i shuffle) {
+
+  __m256i v;
+
+  v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+        _mm_loadu_si128((const __m128i *)(p + 12)), 1);
+
+  return _mm256_shuffle_epi8(v, shuffle);
+}
+
+__attribute__((target("avx2")))
+static int scan_s24_avx2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const unsigned char *s = samples;
+  __m256i shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                     -1, 6, 7, 8, -1, 9, 10, 11,
+                                     -1, 0, 1, 2, -1, 3, 4, 5,
+                                     -1, 6, 7, 8, -1, 9, 10, 11);
+  __m256i hi = _mm256_set1_epi32(d->ihi * 256);
+  __m256i lo = _mm256_set1_epi32(d->ilo * 256);
+  __m256i a, b, loud;
+  int i = count;
+  unsigned int mask;
+  int x;
+
+  while((i % 8) || (i > count - 2)) {
+    if(i == 0)
+      break;
+    i--;
+    x = s24(s + 3 * i);
+    if(x > d->ihi || x < d->ilo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  // Silent stretches go sixteen samples at a time, which keeps more loads
+  // in flight; the loop below finds the sample once something is loud
+  while(i >= 16) {
+    a = load_s24_avx2(s + 3 * (i - 16), shuffle);
+    b = load_s24_avx2(s + 3 * (i - 8), shuffle);
+    loud = _mm256_or_si256(
+             _mm256_or_si256(_mm256_cmpgt_epi32(a, hi),
+                             _mm256_cmpgt_epi32(lo, a)),
+             _mm256_or_si256(_mm256_cmpgt_epi32(b, hi),
+                             _mm256_cmpgt_epi32(lo, b)));
+    if(!_mm256_testz_si256(loud, loud))
+      break;
+    i -= 16;
+  }
+
+  while(i > 0) {
+    i -= 8;
+    a = load_s24_avx2(s + 3 * i, shuffle);
+    loud = _mm256_or_si256(_mm256_cmpgt_epi32(a, hi),
+                           _mm256_cmpgt_epi32(lo, a));
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(loud));
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("sse2")))
+static int scan_s32_sse2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const int *s = samples;
+  __m128i hi = _mm_set1_epi32(d->ihi);
+  __m128i lo = _mm_set1_epi32(d->ilo);
+  __m128i v, loud;
+  int i = count;
+  int mask;
+
+  while(i % 4) {
+    i--;
+    if(s[i] > d->ihi || s[i] < d->ilo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 4;
+    v = _mm_loadu_si128((const __m128i *)(s + i));
+    loud = _mm_or_si128(_mm_cmpgt_epi32(v, hi), _mm_cmpgt_epi32(lo, v));
+    mask = _mm_movemask_ps(_mm_castsi128_ps(loud));
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("avx2")))
+static int scan_s32_avx2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const int *s = samples;
+  __m256i hi = _mm256_set1_epi32(d->ihi);
+  __m256i lo = _mm256_set1_epi32(d->ilo);
+  __m256i v, loud;
+  int i = count;
+  unsigned int mask;
+
+  while(i % 8) {
+    i--;
+    if(s[i] > d->ihi || s[i] < d->ilo) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 8;
+    v = _mm256_loadu_si256((const __m256i *)(s + i));
+    loud = _mm256_or_si256(_mm256_cmpgt_epi32(v, hi),
+                           _mm256_cmpgt_epi32(lo, v));
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(loud));
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+// Float: clear the sign bits and compare with "not less than", which is also
+// true for NaN, the same as the scalar kernels.
+__attribute__((target("sse2")))
+static int scan_f32_sse2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const float *s = samples;
+  __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 hi = _mm_set1_ps(d->fhi);
+  __m128 loud;
+  int i = count;
+  int mask;
+
+  while(i % 4) {
+    i--;
+    if(!(fabsf(s[i]) < d->fhi)) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 4;
+    loud = _mm_cmpnlt_ps(_mm_and_ps(_mm_loadu_ps(s + i), abs), hi);
+    mask = _mm_movemask_ps(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("avx2")))
+static int scan_f32_avx2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const float *s = samples;
+  __m256 abs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 hi = _mm256_set1_ps(d->fhi);
+  __m256 loud;
+  int i = count;
+  unsigned int mask;
+
+  while(i % 8) {
+    i--;
+    if(!(fabsf(s[i]) < d->fhi)) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 8;
+    loud = _mm256_cmp_ps(_mm256_and_ps(_mm256_loadu_ps(s + i), abs), hi,
+                         _CMP_NLT_UQ);
+    mask = _mm256_movemask_ps(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("sse2")))
+static int scan_f64_sse2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const double *s = samples;
+  __m128d abs = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+  __m128d hi = _mm_set1_pd(d->dhi);
+  __m128d loud;
+  int i = count;
+  int mask;
+
+  while(i % 2) {
+    i--;
+    if(!(fabs(s[i]) < d->dhi)) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 2;
+    loud = _mm_cmpnlt_pd(_mm_and_pd(_mm_loadu_pd(s + i), abs), hi);
+    mask = _mm_movemask_pd(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+__attribute__((target("avx2")))
+static int scan_f64_avx2(const struct ws_detector *d, const void *samples,
+                         int count, int *tail) {
+
+  const double *s = samples;
+  __m256d abs = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+  __m256d hi = _mm256_set1_pd(d->dhi);
+  __m256d loud;
+  int i = count;
+  unsigned int mask;
+
+  while(i % 4) {
+    i--;
+    if(!(fabs(s[i]) < d->dhi)) {
+      *tail = count - 1 - i;
+      return 1;
+    }
+  }
+
+  while(i > 0) {
+    i -= 4;
+    loud = _mm256_cmp_pd(_mm256_and_pd(_mm256_loadu_pd(s + i), abs), hi,
+                         _CMP_NLT_UQ);
+    mask = _mm256_movemask_pd(loud);
+    if(mask) {
+      *tail = count - 1 - LAST_LOUD(i, mask, 1);
+      return 1;
+    }
+  }
+
+  *tail = count;
+  return 0;
+}
+
+#endif
+
+// Loud tests for sample i of each format, for the channel kernels
+static inline int loud_u8(const struct ws_detector *d, const void *s, int i) {
+
+  int v = ((const unsigned char *)s)[i] - 128;
+
+  return v > d->ihi || v < d->ilo;
+}
+
+static inline int loud_s16(const struct ws_detector *d, const void *s, int i) {
+
+  short v = ((const short *)s)[i];
+
+  return v > d->hi || v < d->lo;
+}
+
+static inline int loud_s24(const struct ws_detector *d, const void *s, int i) {
+
+  int v = s24((const unsigned char *)s + 3 * i);
+
+  return v > d->ihi || v < d->ilo;
+}
+
+static inline int loud_s32(const struct ws_detector *d, const void *s, int i) {
+
+  int v = ((const int *)s)[i];
+
+  return v > d->ihi || v < d->ilo;
+}
+
+static inline int loud_f32(const struct ws_detector *d, const void *s, int i) {
+
+  return !(fabsf(((const float *)s)[i]) < d->fhi);
+}
+
+static inline int loud_f64(const struct ws_detector *d, const void *s, int i) {
+
+  return !(fabs(((const double *)s)[i]) < d->dhi);
+}
+
+// The same for whatever format d was set up for
+static int loud_at(const struct ws_detector *d, const void *s, int i) {
+
+  if(d->scan == scan_none)
+    return 1;
+  if(d->scan == scan_all)
+    return 0;
+
+  if(d->format == WAVE_FORMAT_IEEE_FLOAT)
+    return (d->bits == 32) ? loud_f32(d, s, i) : loud_f64(d, s, i);
+
+  switch(d->bits) {
+  case 8:
+    return loud_u8(d, s, i);
+  case 16:
+    return loud_s16(d, s, i);
+  case 24:
+    return loud_s24(d, s, i);
+  default:
+    return loud_s32(d, s, i);
+  }
+}
+
+// Every sample is loud, or none is
+static unsigned int chan_none(const struct ws_detector *d,
+                              const void *samples, int count, int channels,
+                              unsigned int want, int *last) {
+
+  int k, frames = count / channels;
+
+  if(frames == 0)
+    return 0;
+
+  for(k = 0; k < channels; k++)
+    last[k] = frames - 1;
+
+  return want;
+}
+
+static unsigned int chan_all(const struct ws_detector *d,
+                             const void *samples, int count, int channels,
+                             unsigned int want, int *last) {
+  return 0;
+}
+
+// The scalar kernels walk each wanted channel back on its own, one frame at
+// a time
+#define CHAN_SCALAR(name, loud)                                         \
+static unsigned int name(const struct ws_detector *d,                   \
+                         const void *samples, int count, int channels,  \
+                         unsigned int want, int *last) {                \
+                                                                        \
+  unsigned int found = 0;                                               \
+  int f, k, frames = count / channels;                                  \
+                                                                        \
+  for(k = 0; k < channels; k++) {                                       \
+    if(!(want & (1U << k)))                                             \
+      continue;                                                         \
+    for(f = frames - 1; f >= 0; f--)                                    \
+      if(loud(d, samples, f * channels + k)) {                          \
+        last[k] = f;                                                    \
+        found |= 1U << k;                                               \
+        break;                                                          \
+      }                                                                 \
+  }                                                                     \
+                                                                        \
+  return found;                                                         \
+}
+
+CHAN_SCALAR(chan_u8, loud_u8)
+CHAN_SCALAR(chan_s16, loud_s16)
+CHAN_SCALAR(chan_s24, loud_s24)
+CHAN_SCALAR(chan_s32, loud_s32)
+CHAN_SCALAR(chan_f32, loud_f32)
+CHAN_SCALAR(chan_f64, loud_f64)
+
+#ifdef HAVE_X86_KERNELS
+
+// Mask bits (bits per sample) of the wanted channels in a vector of lanes
+// samples, for each channel the vector can start on
+static void chan_masks(unsigned int *masks, int channels, unsigned int want,
+                       int lanes, int bits) {
+
+  int phase, j;
+
+  for(phase = 0; phase < channels; phase++) {
+    masks[phase] = 0;
+    for(j = 0; j < lanes; j++)
+      if(want & (1U << ((phase + j) % channels)))
+        masks[phase] |= ((1U << bits) - 1) << (j * bits);
+  }
+
+}
+
+// Checks the samples at the end of the block one at a time while cond holds,
+// like the scan kernels do before the vector loop
+#define CHAN_ODD(cond, loud)                                            \
+  while(cond) {                                                         \
+    i--;                                                                \
+    k = i % channels;                                                   \
+    if((want & (1U << k)) && loud(d, samples, i)) {                     \
+      last[k] = i / channels;                                           \
+      found |= 1U << k;                                                 \
+      want &= ~(1U << k);                                               \
+      if(!want)                                                         \
+        return found;                                                   \
+    }                                                                   \
+  }
+
+// Takes the channels of the loud samples in mask, last first, until none
+// of the wanted ones are left in it
+#define CHAN_TAKE(mask, lanes, bits)                                    \
+  while(mask) {                                                         \
+    j = LAST_LOUD(i, mask, bits);                                       \
+    k = j % channels;                                                   \
+    last[k] = j / channels;                                             \
+    found |= 1U << k;                                                   \
+    want &= ~(1U << k);                                                 \
+    if(!want)                                                           \
+      return found;                                                     \
+    chan_masks(masks, channels, want, lanes, bits);                     \
+    mask &= masks[i % channels];                                        \
+  }
+
+__attribute__((target("sse2")))
+static unsigned int chan_s16_sse2(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want,
+                                  int *last) {
+
+  const short *s = samples;
+  __m128i hi = _mm_set1_epi16(d->hi);
+  __m128i lo = _mm_set1_epi16(d->lo);
+  __m128i v, loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int i = (count / channels) * channels;
+  int j, k;
+
+  CHAN_ODD(i % 8, loud_s16);
+
+  chan_masks(masks, channels, want, 8, 2);
+
+  while(i > 0) {
+    i -= 8;
+    v = _mm_loadu_si128((const __m128i *)(s + i));
+    loud = _mm_or_si128(_mm_cmpgt_epi16(v, hi), _mm_cmpgt_epi16(lo, v));
+    mask = _mm_movemask_epi8(loud) & masks[i % channels];
+    CHAN_TAKE(mask, 8, 2);
+  }
+
+  return found;
+}
+
+__attribute__((target("avx2")))
+static unsigned int chan_s16_avx2(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want,
+                                  int *last) {
+
+  const short *s = samples;
+  __m256i hi = _mm256_set1_epi16(d->hi);
+  __m256i lo = _mm256_set1_epi16(d->lo);
+  __m256i v, loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int i = (count / channels) * channels;
+  int j, k;
+
+  CHAN_ODD(i % 16, loud_s16);
+
+  chan_masks(masks, channels, want, 16, 2);
+
+  while(i > 0) {
+    i -= 16;
+    v = _mm256_loadu_si256((const __m256i *)(s + i));
+    loud = _mm256_or_si256(_mm256_cmpgt_epi16(v, hi),
+                           _mm256_cmpgt_epi16(lo, v));
+    mask = _mm256_movemask_epi8(loud) & masks[i % channels];
+    CHAN_TAKE(mask, 16, 2);
+  }
+
+  return found;
+}
+
+// 24-bit lanes are loaded as in scan_s24_ssse3(), so the last couple of
+// samples are left to the scalar loop here too
+__attribute__((target("ssse3")))
+static unsigned int chan_s24_ssse3(const struct ws_detector *d,
+                                   const void *samples, int count,
+                                   int channels, unsigned int want,
+                                   int *last) {
+
+  const unsigned char *s = samples;
+  __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                  -1, 6, 7, 8, -1, 9, 10, 11);
+  __m128i hi = _mm_set1_epi32(d->ihi * 256);
+  __m128i lo = _mm_set1_epi32(d->ilo * 256);
+  __m128i v, loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int n = (count / channels) * channels;
+  int i = n;
+  int j, k;
+
+  CHAN_ODD((i > 0) && ((i % 4) || (i > n - 2)), loud_s24);
+
+  chan_masks(masks, channels, want, 4, 1);
+
+  while(i > 0) {
+    i -= 4;
+    v = _mm_loadu_si128((const __m128i *)(s + 3 * i));
+    v = _mm_shuffle_epi8(v, shuffle);
+    loud = _mm_or_si128(_mm_cmpgt_epi32(v, hi), _mm_cmpgt_epi32(lo, v));
+    mask = _mm_movemask_ps(_mm_castsi128_ps(loud)) & masks[i % channels];
+    CHAN_TAKE(mask, 4, 1);
+  }
+
+  return found;
+}
+
+__attribute__((target("avx2")))
+static unsigned int chan_s24_avx2(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want,
+                                  int *last) {
+
+  const unsigned char *s = samples;
+  __m256i shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                     -1, 6, 7, 8, -1, 9, 10, 11,
+                                     -1, 0, 1, 2, -1, 3, 4, 5,
+                                     -1, 6, 7, 8, -1, 9, 10, 11);
+  __m256i hi = _mm256_set1_epi32(d->ihi * 256);
+  __m256i lo = _mm256_set1_epi32(d->ilo * 256);
+  __m256i v, loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int n = (count / channels) * channels;
+  int i = n;
+  int j, k;
+
+  CHAN_ODD((i > 0) && ((i % 8) || (i > n - 2)), loud_s24);
+
+  chan_masks(masks, channels, want, 8, 1);
+
+  while(i > 0) {
+    i -= 8;
+    v = load_s24_avx2(s + 3 * i, shuffle);
+    loud = _mm256_or_si256(_mm256_cmpgt_epi32(v, hi),
+                           _mm256_cmpgt_epi32(lo, v));
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(loud)) & masks[i % channels];
+    CHAN_TAKE(mask, 8, 1);
+  }
+
+  return found;
+}
+
+__attribute__((target("sse2")))
+static unsigned int chan_s32_sse2(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want,
+                                  int *last) {
+
+  const int *s = samples;
+  __m128i hi = _mm_set1_epi32(d->ihi);
+  __m128i lo = _mm_set1_epi32(d->ilo);
+  __m128i v, loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int i = (count / channels) * channels;
+  int j, k;
+
+  CHAN_ODD(i % 4, loud_s32);
+
+  chan_masks(masks, channels, want, 4, 1);
+
+  while(i > 0) {
+    i -= 4;
+    v = _mm_loadu_si128((const __m128i *)(s + i));
+    loud = _mm_or_si128(_mm_cmpgt_epi32(v, hi), _mm_cmpgt_epi32(lo, v));
+    mask = _mm_movemask_ps(_mm_castsi128_ps(loud)) & masks[i % channels];
+    CHAN_TAKE(mask, 4, 1);
+  }
+
+  return found;
+}
+
+__attribute__((target("avx2")))
+static unsigned int chan_s32_avx2(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want,
+                                  int *last) {
+
+  const int *s = samples;
+  __m256i hi = _mm256_set1_epi32(d->ihi);
+  __m256i lo = _mm256_set1_epi32(d->ilo);
+  __m256i v, loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int i = (count / channels) * channels;
+  int j, k;
+
+  CHAN_ODD(i % 8, loud_s32);
+
+  chan_masks(masks, channels, want, 8, 1);
+
+  while(i > 0) {
+    i -= 8;
+    v = _mm256_loadu_si256((const __m256i *)(s + i));
+    loud = _mm256_or_si256(_mm256_cmpgt_epi32(v, hi),
+                           _mm256_cmpgt_epi32(lo, v));
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(loud)) & masks[i % channels];
+    CHAN_TAKE(mask, 8, 1);
+  }
+
+  return found;
+}
+
+__attribute__((target("sse2")))
+static unsigned int chan_f32_sse2(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want,
+                                  int *last) {
+
+  const float *s = samples;
+  __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 hi = _mm_set1_ps(d->fhi);
+  __m128 loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int i = (count / channels) * channels;
+  int j, k;
+
+  CHAN_ODD(i % 4, loud_f32);
+
+  chan_masks(masks, channels, want, 4, 1);
+
+  while(i > 0) {
+    i -= 4;
+    loud = _mm_cmpnlt_ps(_mm_and_ps(_mm_loadu_ps(s + i), abs), hi);
+    mask = _mm_movemask_ps(loud) & masks[i % channels];
+    CHAN_TAKE(mask, 4, 1);
+  }
+
+  return found;
+}
+
+__attribute__((target("avx2")))
+static unsigned int chan_f32_avx2(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want,
+                                  int *last) {
+
+  const float *s = samples;
+  __m256 abs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 hi = _mm256_set1_ps(d->fhi);
+  __m256 loud;
+  unsigned int masks[MAX_CHANNELS];
+  unsigned int found = 0, mask;
+  int i = (count / channels) * channels;
+  int j, k;
+
+  CHAN_ODD(i % 8, loud_f32);
+
+  chan_masks(masks, channels, want, 8, 1);
+
+  while(i > 0) {
+    i -= 8;
+    loud = _mm256_cmp_ps(_mm256_and_ps(_mm256_loadu_ps(s + i), abs), hi,
+                         _CMP_NLT_UQ);
+    mask = _mm256_movemask_ps(loud) & masks[i % channels];
+    CHAN_TAKE(mask, 8, 1);
+  }
+
+  return found;
+}
+
+#endif
+
+struct kernel {
+
+  int format;           // WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT
+  int bits;
+  const char *name;
+  scan_func scalar;
+  scan_func sse;        // SSE2 (SSSE3 for 24-bit)
+  scan_func avx2;
+  chan_func chan;       // The same three for -k
+  chan_func chan_sse;
+  chan_func chan_avx2;
+
+};
+
+static const struct kernel kernels[] = {
+#ifdef HAVE_X86_KERNELS
+  { WAVE_FORMAT_PCM,         8,  "u8",  scan_u8,  scan_u8_sse2,
+                                        scan_u8_avx2,
+                                        chan_u8,  NULL, NULL },
+  { WAVE_FORMAT_PCM,         16, "s16", scan_s16, scan_s16_sse2,
+                                        scan_s16_avx2,
+                                        chan_s16, chan_s16_sse2,
+                                        chan_s16_avx2 },
+  { WAVE_FORMAT_PCM,         24, "s24", scan_s24, scan_s24_ssse3,
+                                        scan_s24_avx2,
+                                        chan_s24, chan_s24_ssse3,
+                                        chan_s24_avx2 },
+  { WAVE_FORMAT_PCM,         32, "s32", scan_s32, scan_s32_sse2,
+                                        scan_s32_avx2,
+                                        chan_s32, chan_s32_sse2,
+                                        chan_s32_avx2 },
+  { WAVE_FORMAT_IEEE_FLOAT,  32, "f32", scan_f32, scan_f32_sse2,
+                                        scan_f32_avx2,
+                                        chan_f32, chan_f32_sse2,
+                                        chan_f32_avx2 },
+  { WAVE_FORMAT_IEEE_FLOAT,  64, "f64", scan_f64, scan_f64_sse2,
+                                        scan_f64_avx2,
+                                        chan_f64, NULL, NULL },
+#else
+  { WAVE_FORMAT_PCM,         8,  "u8",  scan_u8,  NULL, NULL,
+                                        chan_u8,  NULL, NULL },
+  { WAVE_FORMAT_PCM,         16, "s16", scan_s16, NULL, NULL,
+                                        chan_s16, NULL, NULL },
+  { WAVE_FORMAT_PCM,         24, "s24", scan_s24, NULL, NULL,
+                                        chan_s24, NULL, NULL },
+  { WAVE_FORMAT_PCM,         32, "s32", scan_s32, NULL, NULL,
+                                        chan_s32, NULL, NULL },
+  { WAVE_FORMAT_IEEE_FLOAT,  32, "f32", scan_f32, NULL, NULL,
+                                        chan_f32, NULL, NULL },
+  { WAVE_FORMAT_IEEE_FLOAT,  64, "f64", scan_f64, NULL, NULL,
+                                        chan_f64, NULL, NULL },
+#endif
+  { 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+};
+
+// Sets d up for threshold and samples of the given AudioFormat and
+// BitsPerSample (the SubFormat's for WAVE_FORMAT_EXTENSIBLE).  Returns 0 if
+// there is no kernel for the format.
+int detect_init(struct ws_detector *d, float threshold, int format, int bits) {
+
+  const struct kernel *k;
+  double limit;
+
+  for(k = kernels; k->name; k++)
+    if((k->format == format) && (k->bits == bits))
+      break;
+
+  if(k->name == NULL)
+    return 0;
+
+  d->format = format;
+  d->bits = bits;
+
+  // Same arithmetic is_silence() used, so the split points don't move
+  d->boundary = (threshold * 65536) / 2;
+  if((d->boundary > 0) && (d->boundary <= 32768)) {
+    d->hi = d->boundary - 1;
+    d->lo = -(d->boundary - 1);
+  }
+
+  if(format == WAVE_FORMAT_IEEE_FLOAT) {
+    d->fhi = threshold;
+    d->dhi = threshold;
+    limit = (threshold > 0) ? 1 : 0;
+  } else {
+    // The boundary in the format's own scale
+    limit = floor(ldexp(threshold, bits) / 2);
+    if(bits == 16)
+      limit = d->boundary;
+    if((limit > 0) && (limit <= ldexp(1, bits - 1))) {
+      d->ihi = limit - 1;
+      d->ilo = -(limit - 1);
+    }
+  }
+
+  if(limit <= 0) {
+    snprintf(d->name, sizeof(d->name), "none");
+    d->scan = scan_none;
+    d->chan = chan_none;
+    return 1;
+  }
+
+  if((format == WAVE_FORMAT_PCM) && (limit > ldexp(1, bits - 1))) {
+    snprintf(d->name, sizeof(d->name), "all");
+    d->scan = scan_all;
+    d->chan = chan_all;
+    return 1;
+  }
+
+  d->scan = k->scalar;
+  d->chan = k->chan;
+  snprintf(d->name, sizeof(d->name), "%s/scalar", k->name);
+
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2")) {
+    d->scan = k->avx2;
+    if(k->chan_avx2)
+      d->chan = k->chan_avx2;
+    snprintf(d->name, sizeof(d->name), "%s/avx2", k->name);
+  } else if((bits == 24) ? __builtin_cpu_supports("ssse3")
+                          : __builtin_cpu_supports("sse2")) {
+    d->scan = k->sse;
+    if(k->chan_sse)
+      d->chan = k->chan_sse;
+    snprintf(d->name, sizeof(d->name), "%s/%s", k->name,
+             (bits == 24) ? "ssse3" : "sse2");
+  }
+#endif
+
+  return 1;
+}
+
+int detect_block(const struct ws_detector *d, const void *samples, int count,
+                 int *tail) {
+
+  return d->scan(d, samples, count, tail);
+
+}
+
+// The coarse level of process_data()'s scan: cuts count samples into cells
+// of cell samples and returns non-zero if every cell has a loud sample in it,
+// so that no run of silence inside the span is longer than 2 * cell - 2.
+// Each cell is scanned backwards like a block, so on loud material only its
+// last vector is looked at.  *tail is set as detect_block() would, and
+// *cells to the number of cells scanned.
+int detect_coarse(const struct ws_detector *d, const void *samples, int count,
+                  int cell, int *tail, int *cells) {
+
+  const unsigned char *s = samples;
+  int size = d->bits / 8;
+  int start, quiet;
+
+  *cells = 0;
+
+  // The last cell (which may be short) gives the tail
+  start = ((count - 1) / cell) * cell;
+  for(;;) {
+    ++*cells;
+    if(!d->scan(d, s + start * size, count - start, &quiet))
+      return 0;
+    if(*cells == 1)
+      *tail = quiet;
+    if(start == 0)
+      return 1;
+    count = start;
+    start -= cell;
+  }
+
+}
+
+// Sample i of a block, in the format's own units
+double detect_value(const struct ws_detector *d, const void *samples, int i) {
+
+  const unsigned char *s = samples;
+
+  if(d->format == WAVE_FORMAT_IEEE_FLOAT)
+    return (d->bits == 32) ? ((const float *)s)[i] : ((const double *)s)[i];
+
+  switch(d->bits) {
+  case 8:
+    return s[i] - 128;
+  case 16:
+    return ((const short *)s)[i];
+  case 24:
+    return s24(s + 3 * i);
+  default:
+    return ((const int *)s)[i];
+  }
+}
+
+// Returns non-zero if a block of 16-bit samples that lie between min and max
+// has a loud sample in it, without looking at the samples.
+int detect_range(const struct ws_detector *d, int min, int max) {
+
+  if(d->boundary <= 0)
+    return 1;
+
+  if(d->boundary > 32768)
+    return 0;
+
+  return (max > d->hi) || (min < d->lo);
+
+}
+
+// Sets ch up for policy (CHANNELS_ANY, or a channel from 0).  Returns 0 if
+// the input doesn't have that channel.
+int channels_init(struct ws_channels *ch, int policy, int channels) {
+
+  memset(ch, 0, sizeof(*ch));
+
+  if((channels < 1) || (channels > MAX_CHANNELS) || (policy >= channels))
+    return 0;
+
+  ch->policy = policy;
+  ch->channels = channels;
+  ch->want = (policy == CHANNELS_ANY)
+    ? ((channels == 32) ? ~0U : (1U << channels) - 1) : 1U << policy;
+
+  return 1;
+}
+
+// Runs a block through the channels and returns the silence counter (in
+// samples) for the splitter: the silent frames of the policy's channel,
+// or of the channel that has been silent longest
+long long channels_block(const struct ws_detector *d, struct ws_channels *ch,
+                         const void *samples, int count) {
+
+  int last[MAX_CHANNELS];
+  unsigned int found;
+  int k, frames = count / ch->channels;
+  long long quiet = 0;
+
+  found = d->chan(d, samples, count, ch->channels, ch->want, last);
+
+  for(k = 0; k < ch->channels; k++) {
+    if(!(ch->want & (1U << k)))
+      continue;
+    if(found & (1U << k))
+      ch->quiet[k] = frames - 1 - last[k];
+    else
+      ch->quiet[k] += frames;
+    if(ch->quiet[k] > quiet)
+      quiet = ch->quiet[k];
+  }
+
+  return quiet * ch->channels;
+}
+
+// Silent samples at the start of a block that ended the silence: up to
+// the first loud frame of the policy's channel, or of the channel that was
+// loud last
+int channels_head(const struct ws_detector *d, const struct ws_channels *ch,
+                  const void *samples, int count) {
+
+  int f, k, head = 0, frames = count / ch->channels;
+
+  for(k = 0; k < ch->channels; k++) {
+    if(!(ch->want & (1U << k)))
+      continue;
+    for(f = 0; f < frames; f++)
+      if(loud_at(d, samples, f * ch->channels + k))
+        break;
+    if((f < frames) && (f > head))
+      head = f;
+  }
+
+  return head * ch->channels;
+}
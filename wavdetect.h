@@ -0,0 +1,104 @@
+/*  wavdetect.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_DETECT_H
+#define WAV_DETECT_H
+
+#define WAVE_FORMAT_PCM         1
+#define WAVE_FORMAT_IEEE_FLOAT  3
+
+struct ws_detector;
+
+// Scans count samples and returns non-zero if any of them is loud. The number
+// of silent samples at the end of the block is stored in *tail (count if the
+// whole block is silent).
+typedef int (*scan_func)(const struct ws_detector *d, const void *samples,
+                         int count, int *tail);
+
+// Finds the last loud frame of each channel in want (a bit per channel) in
+// count interleaved samples.  Returns the channels found, with their frames
+// in last[].
+typedef unsigned int (*chan_func)(const struct ws_detector *d,
+                                  const void *samples, int count,
+                                  int channels, unsigned int want, int *last);
+
+#define MAX_CHANNELS    32
+
+#define CHANNELS_ALL    -1  // Silence is when every channel is silent
+#define CHANNELS_ANY    -2  // Silence is when any channel is silent
+
+// Silence tracked for each channel (-k)
+struct ws_channels {
+
+  int policy;               // CHANNELS_ANY, or the channel that decides
+  int channels;
+  unsigned int want;        // The channels looked at
+  long long quiet[MAX_CHANNELS];    // Silent frames at the end of each
+
+};
+
+struct ws_detector {
+
+  int boundary;        // 16-bit: |sample| < boundary is silence
+  short hi;            // boundary - 1, for the vector compares
+  short lo;            // -(boundary - 1)
+
+  // The same limits for the other formats, worked out once in detect_init()
+  int ihi;             // 8-bit (after flipping the sign bit), 24 and 32-bit
+  int ilo;
+  float fhi;           // Float: |sample| < fhi is silence
+  double dhi;
+
+  int format;          // AudioFormat and BitsPerSample it was set up for
+  int bits;
+  char name[16];       // Kernel name, for verbose output
+  scan_func scan;
+  chan_func chan;
+
+};
+
+// Functions
+
+int detect_init(struct ws_detector *d, float threshold, int format, int bits);
+
+int detect_block(const struct ws_detector *d, const void *samples, int count,
+                 int *tail);
+
+int detect_coarse(const struct ws_detector *d, const void *samples, int count,
+                  int cell, int *tail, int *cells);
+
+double detect_value(const struct ws_detector *d, const void *samples, int i);
+
+int detect_range(const struct ws_detector *d, int min, int max);
+
+int channels_init(struct ws_channels *ch, int policy, int channels);
+long long channels_block(const struct ws_detector *d, struct ws_channels *ch,
+                         const void *samples, int count);
+int channels_head(const struct ws_detector *d, const struct ws_channels *ch,
+                  const void *samples, int count);
+
+#endif
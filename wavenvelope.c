@@ -0,0 +1,250 @@
+/*  wavenvelope.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    Windowed level detector (-D).
+
+    The sample detector calls a block loud if one sample in it is, so a
+    single click ends a gap.  This one follows the level of the last
+    window frames instead: the RMS, kept as a running sum of the frames'
+    mean squares, or the peak, kept as a queue of the falling maxima of
+    the window.  Either way each frame costs the same whatever the window.
+    The running sum is worked out again from the window once per window,
+    so rounding can't build up.
+
+    An input that is loud goes quiet when its level drops below the -t
+    threshold, and only gets loud again when it reaches the -E one, so a
+    level hovering around one threshold doesn't flip back and forth.
+    envelope_block() answers the same questions detect_block() does
+    (whether anything in the block was loud, and how many quiet samples
+    end it), so the splitter's GAP and OVERRIDE logic is unchanged.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "wavdetect.h"
+#include "wavenvelope.h"
+
+int envelope_init(struct ws_envelope *env, int type, int window,
+                  float quiet, float loud, int format, int bits,
+                  int channels) {
+
+  memset(env, 0, sizeof(*env));
+
+  if((format == WAVE_FORMAT_IEEE_FLOAT) && ((bits == 32) || (bits == 64)))
+    env->scale = 1;
+  else if((format == WAVE_FORMAT_PCM) &&
+          ((bits == 8) || (bits == 16) || (bits == 24) || (bits == 32)))
+    env->scale = ldexp(1, 1 - bits);
+  else
+    return 0;
+
+  if(window < 1)
+    window = 1;
+
+  env->type = type;
+  env->format = format;
+  env->bits = bits;
+  env->channels = channels;
+  env->window = window;
+
+  // The RMS is compared squared
+  env->quiet = (type == ENV_RMS) ? (double)quiet * quiet : quiet;
+  env->loud = (type == ENV_RMS) ? (double)loud * loud : loud;
+
+  if(type == ENV_RMS)
+    env->levels = calloc(window, sizeof(double));
+  else {
+    env->peak_frame = malloc(window * sizeof(long long));
+    env->peak_level = malloc(window * sizeof(double));
+  }
+
+  if((env->levels == NULL) &&
+     ((env->peak_frame == NULL) || (env->peak_level == NULL))) {
+    fprintf(stderr, "envelope: Could not allocate a %i frame window\n",
+            window);
+    envelope_free(env);
+    return 0;
+  }
+
+  return 1;
+}
+
+void envelope_free(struct ws_envelope *env) {
+
+  free(env->levels);
+  free(env->peak_frame);
+  free(env->peak_level);
+  free(env->frame_levels);
+  env->levels = NULL;
+  env->peak_frame = NULL;
+  env->peak_level = NULL;
+  env->frame_levels = NULL;
+
+}
+
+// Reads the frames of a block into env->frame_levels: the mean square of
+// the channels for ENV_RMS, the largest magnitude for ENV_PEAK
+static void convert(struct ws_envelope *env, const void *samples,
+                    int frames) {
+
+  const unsigned char *s = samples;
+  double *out = env->frame_levels;
+  double v, level;
+  int f, c, i, channels = env->channels;
+
+  for(f = 0, i = 0; f < frames; f++) {
+
+    level = 0;
+
+    for(c = 0; c < channels; c++, i++) {
+
+      if(env->format == WAVE_FORMAT_IEEE_FLOAT)
+        v = (env->bits == 32) ? ((const float *)s)[i] : ((const double *)s)[i];
+      else switch(env->bits) {
+      case 8:
+        v = s[i] - 128;
+        break;
+      case 16:
+        v = ((const short *)s)[i];
+        break;
+      case 24:
+        v = s[3 * i] | (s[3 * i + 1] << 8) | ((signed char)s[3 * i + 2] * 65536);
+        break;
+      default:
+        v = ((const int *)s)[i];
+        break;
+      }
+
+      v *= env->scale;
+
+      if(env->type == ENV_RMS)
+        level += v * v;
+      else if(fabs(v) > level)
+        level = fabs(v);
+    }
+
+    out[f] = (env->type == ENV_RMS) ? level / channels : level;
+  }
+
+}
+
+// Adds one frame level to the window and returns the window's level
+static double window_level(struct ws_envelope *env, double level) {
+
+  int i, last;
+
+  if(env->type == ENV_RMS) {
+
+    if(env->filled == env->window)
+      env->sum -= env->levels[env->pos];
+    else
+      env->filled++;
+
+    env->levels[env->pos] = level;
+    env->sum += level;
+
+    if(++env->pos == env->window) {
+      env->pos = 0;
+      env->sum = 0;
+      for(i = 0; i < env->filled; i++)
+        env->sum += env->levels[i];
+    }
+
+    return (env->sum > 0) ? env->sum / env->filled : 0;
+  }
+
+  // The oldest maximum leaves with its frame; newer, larger levels push
+  // out the smaller ones before them
+  if(env->peak_count &&
+     (env->peak_frame[env->peak_first] <= env->frame - env->window)) {
+    env->peak_first = (env->peak_first + 1) % env->window;
+    env->peak_count--;
+  }
+
+  while(env->peak_count) {
+    last = (env->peak_first + env->peak_count - 1) % env->window;
+    if(env->peak_level[last] > level)
+      break;
+    env->peak_count--;
+  }
+
+  last = (env->peak_first + env->peak_count) % env->window;
+  env->peak_frame[last] = env->frame;
+  env->peak_level[last] = level;
+  env->peak_count++;
+
+  return env->peak_level[env->peak_first];
+}
+
+// Runs count samples through the envelope.  Returns non-zero if it was
+// loud at any frame of them, and stores the quiet samples that end the
+// block in *tail, like detect_block().
+int envelope_block(struct ws_envelope *env, const void *samples, int count,
+                   int *tail) {
+
+  int frames = count / env->channels;
+  int f, first = -1, last = -1;
+  double level;
+  double *p;
+
+  if(frames > env->frame_levels_size) {
+    p = realloc(env->frame_levels, frames * sizeof(double));
+    if(p == NULL) {
+      fprintf(stderr, "envelope: Could not allocate %i frames\n", frames);
+      exit(1);
+    }
+    env->frame_levels = p;
+    env->frame_levels_size = frames;
+  }
+
+  convert(env, samples, frames);
+
+  for(f = 0; f < frames; f++, env->frame++) {
+
+    level = window_level(env, env->frame_levels[f]);
+
+    if(env->is_loud ? (level < env->quiet) : (level >= env->loud))
+      env->is_loud = !env->is_loud;
+
+    if(env->is_loud) {
+      if(first < 0)
+        first = f;
+      last = f;
+    }
+  }
+
+  // A split frame at the end counts as quiet
+  env->head = (first < 0) ? count : first * env->channels;
+  *tail = (last < 0) ? count : count - (last + 1) * env->channels;
+
+  return last >= 0;
+}
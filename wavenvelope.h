@@ -0,0 +1,76 @@
+/*  wavenvelope.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_ENVELOPE_H
+#define WAV_ENVELOPE_H
+
+#define ENV_RMS         1
+#define ENV_PEAK        2
+
+// Sliding-window level of the input, with separate thresholds for going
+// quiet and for getting loud again
+struct ws_envelope {
+
+  int type;                 // ENV_RMS or ENV_PEAK
+  int format;               // AudioFormat and BitsPerSample of the input
+  int bits;
+  int channels;
+  double scale;             // 1 / full scale
+  double quiet;             // Level below which a loud input goes quiet
+  double loud;              // Level at which a quiet input gets loud again
+
+  int window;               // Frames
+  double *levels;           // Last window frame levels (ENV_RMS)
+  int pos;
+  int filled;
+  double sum;               // Of levels
+
+  long long *peak_frame;    // Falling maxima of the window (ENV_PEAK)
+  double *peak_level;
+  int peak_first;
+  int peak_count;
+
+  double *frame_levels;     // One block, converted
+  int frame_levels_size;
+  long long frame;          // Frames seen
+  int is_loud;
+  int head;                 // Quiet samples before the first loud one in
+                            // the last block
+
+};
+
+// Functions
+
+int envelope_init(struct ws_envelope *env, int type, int window,
+                  float quiet, float loud, int format, int bits,
+                  int channels);
+void envelope_free(struct ws_envelope *env);
+
+int envelope_block(struct ws_envelope *env, const void *samples, int count,
+                   int *tail);
+
+#endif
@@ -0,0 +1,296 @@
+/*  wavgen.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Makes synthetic WAV files for the benchmarks (make bench): stretches of
+    tones and stretches of silence, in any of the formats wavsilence reads.
+    The same options and seed always give the same file.
+*/
+
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "wavheader.h"
+
+#define FRAMES          4096            // Written at a time
+
+double length;          // Seconds
+int rate;
+int channels;
+int bits;
+int is_float;
+double silence;         // Fraction of the stretches that are silent
+double noise;           // Noise floor, as a fraction of full scale
+double stretch;         // Seconds per stretch
+unsigned long long seed;
+char *output;
+
+// xorshift64*, so the files don't depend on the C library's rand()
+unsigned long long next_random() {
+
+  seed ^= seed >> 12;
+  seed ^= seed << 25;
+  seed ^= seed >> 27;
+
+  return seed * 2685821657736338717ULL;
+}
+
+// Uniform in [0, 1)
+double uniform() {
+
+  return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void put_sample(unsigned char *p, double v) {
+
+  long long s;
+  float f;
+
+  if(v > 1.0)
+    v = 1.0;
+  if(v < -1.0)
+    v = -1.0;
+
+  if(is_float) {
+    f = v;
+    memcpy(p, &f, 4);
+    return;
+  }
+
+  s = llrint(v * ((1LL << (bits - 1)) - 1));
+
+  switch(bits) {
+  case 8:
+    p[0] = s + 128;
+    break;
+  case 16:
+    p[0] = s;
+    p[1] = s >> 8;
+    break;
+  case 24:
+    p[0] = s;
+    p[1] = s >> 8;
+    p[2] = s >> 16;
+    break;
+  case 32:
+    p[0] = s;
+    p[1] = s >> 8;
+    p[2] = s >> 16;
+    p[3] = s >> 24;
+    break;
+  }
+
+}
+
+void print_usage() {
+
+  printf("usage: wavgen <options> -o file\n");
+  printf("Options:\n");
+  printf("  -o <file>  Write the WAV to <file>\n");
+  printf("  -l <sec>   Length in seconds (default: 60)\n");
+  printf("  -r <rate>  Sample rate (default: 44100)\n");
+  printf("  -c <num>   Channels (default: 2)\n");
+  printf("  -b <bits>  8, 16, 24 or 32-bit PCM (default: 16)\n");
+  printf("  -f         32-bit float samples\n");
+  printf("  -d <frac>  Fraction of the stretches that are silent (default: 0.2)\n");
+  printf("  -n <frac>  Noise floor, as a fraction of full scale (default: 0.001)\n");
+  printf("  -g <sec>   Length of a stretch (default: 2)\n");
+  printf("  -S <seed>  Random seed (default: 1)\n");
+  printf("  -h         Show this message\n");
+
+  printf("\n");
+}
+
+void process_args(int argc, char**argv) {
+
+  int c;
+
+  while((c = getopt(argc, argv, "o:l:r:c:b:fd:n:g:S:Vh")) != -1) {
+    switch(c) {
+    case 'o':
+      output = optarg;
+      break;
+    case 'l':
+      length = atof(optarg);
+      break;
+    case 'r':
+      rate = atoi(optarg);
+      break;
+    case 'c':
+      channels = atoi(optarg);
+      break;
+    case 'b':
+      bits = atoi(optarg);
+      if((bits != 8) && (bits != 16) && (bits != 24) && (bits != 32)) {
+	printf("Invalid number of bits!\n");
+	exit(1);
+      }
+      break;
+    case 'f':
+      is_float = 1;
+      break;
+    case 'd':
+      silence = atof(optarg);
+      break;
+    case 'n':
+      noise = atof(optarg);
+      break;
+    case 'g':
+      stretch = atof(optarg);
+      break;
+    case 'S':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'V':
+      printf(WAVSILENCE_VERSION "\n");
+      exit(0);
+    case 'h':
+      print_usage();
+      exit(0);
+    default:
+      exit(1);
+    }
+  }
+
+  if((rate <= 0) || (channels <= 0) || (length <= 0) || (stretch <= 0)) {
+    printf("Invalid length, rate or channels!\n");
+    exit(1);
+  }
+
+  if(is_float)
+    bits = 32;
+
+}
+
+int main(int argc, char**argv) {
+
+  struct wav_file_headers h;
+  unsigned char *buffer, *p;
+  long long frames, frame, stretch_frames, n, i;
+  double amplitude = 0, step = 0, phase = 0, v;
+  int fd, sample_size, ch, silent = 1;
+
+  length = 60;
+  rate = 44100;
+  channels = 2;
+  bits = 16;
+  is_float = 0;
+  silence = 0.2;
+  noise = 0.001;
+  stretch = 2;
+  seed = 1;
+  output = NULL;
+
+  process_args(argc, argv);
+
+  if(output == NULL) {
+    print_usage();
+    return 1;
+  }
+
+  if(seed == 0)
+    seed = 1;
+
+  sample_size = bits / 8;
+  frames = (long long)(length * rate);
+  stretch_frames = (long long)(stretch * rate);
+  if(stretch_frames < 1)
+    stretch_frames = 1;
+
+  memset(&h, 0, sizeof(h));
+  h.riff.Format = 0x45564157; // "WAVE"
+  h.fmt.header.id = FMT_CHUNK_ID;
+  h.fmt.AudioFormat = is_float ? 3 : 1;
+  h.fmt.NumChannels = channels;
+  h.fmt.SampleRate = rate;
+  h.fmt.ByteRate = rate * channels * sample_size;
+  h.fmt.BlockAlign = channels * sample_size;
+  h.fmt.BitsPerSample = bits;
+  h.data.id = DATA_CHUNK_ID;
+
+  // Over 4 GB, it has to be RF64
+  if(!set_data_size(&h, frames * channels * sample_size)) {
+    reserve_ds64(&h);
+    set_data_size(&h, frames * channels * sample_size);
+  }
+
+  fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1) {
+    perror(output);
+    return 1;
+  }
+
+  if(!write_headers(fd, &h)) {
+    close(fd);
+    return 1;
+  }
+
+  buffer = malloc((size_t)FRAMES * channels * sample_size);
+  if(buffer == NULL) {
+    fprintf(stderr, "Could not allocate the buffer\n");
+    return 1;
+  }
+
+  for(frame = 0; frame < frames; frame += n) {
+
+    n = (frames - frame < FRAMES) ? frames - frame : FRAMES;
+
+    for(i = 0, p = buffer; i < n; i++) {
+
+      // A new stretch: silence, or a tone of its own pitch and loudness
+      if((frame + i) % stretch_frames == 0) {
+	silent = uniform() < silence;
+	amplitude = 0.2 + 0.6 * uniform();
+	step = 2 * M_PI * (100 + 1900 * uniform()) / rate;
+      }
+
+      v = silent ? 0 : amplitude * sin(phase);
+      phase += step;
+      if(phase > 2 * M_PI)
+	phase -= 2 * M_PI;
+
+      for(ch = 0; ch < channels; ch++, p += sample_size)
+	put_sample(p, v * (1.0 - 0.1 * ch) + noise * (2 * uniform() - 1));
+    }
+
+    if(write(fd, buffer, p - buffer) != p - buffer) {
+      perror(output);
+      return 1;
+    }
+  }
+
+  free(buffer);
+  close(fd);
+
+  return 0;
+}
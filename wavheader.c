@@ -45,134 +45,100 @@ static void skip_chunk_error(const char *which, unsigned int target_id) {
            target_id);
 }
 
-// Attempts to read the next chunk, verifying that the ID matches and that
-// the data in the chunk can be read completely.
-//
-// If the ID does not match, header is NULL, or if data_size is greater than the
-// number of bytes in the chunk, this function will fail and return 0.
-//
-// chunk_data is optional. If chunk_data is NULL or data_size is 0, then only
-// the header is read.
-//
-// If skip_data is 0 and chunk data is being read (chunk_data and data_size are
-// both non-zero), then the read position does not skip the rest of the chunk
-// data, if any is remaining. Note: If the data is not skipped, then the padding
-// byte at the the end of the chunk data must be taken into account.
-//
-// If skip_data is 1 and chunk data is being read, then data_size bytes are read
-// into chunk_data, then the read position skips to the beginning of the next
-// chunk header.
-//
-// Returns a non-zero value on success
-static int read_chunk(int fd, unsigned int id, struct chunk_header *header, void *chunk_data, size_t data_size, int skip_data) {
-   if (!header) {
-      fprintf(stderr, "read_chunk: NULL header for chunk ID 0x%08X\n", id);
-      return 0;
+// Reads more input into b, after moving what's left of it to the front.
+// Returns 0 at EOF or on an error.
+static int fill_buffer(int fd, struct ws_header_buffer *b) {
+   ssize_t count;
+
+   if (b->start > 0) {
+      memmove(b->data, b->data + b->start, b->end - b->start);
+      b->end -= b->start;
+      b->start = 0;
    }
 
-   if (!chunk_data || !data_size) {
-      chunk_data  = NULL;
-      data_size   = 0;
-   }
+   do
+      count = read(fd, b->data + b->end, sizeof(b->data) - b->end);
+   while (count == -1 && errno == EINTR);
 
-   if (read(fd, header, sizeof(*header)) != sizeof(*header)) {
-      fprintf(stderr,
-              "Error reading the header for chunk ID 0x%08X. Error = %d. "
-                 "Offset = %d.\n",
-              id,
-              errno,
-              lseek(fd, 0, SEEK_CUR));
+   if (count <= 0)
       return 0;
-   }
 
-   if (header->id != id) {
-      fprintf(stderr,
-              "Expected chunk ID = 0x%08x. Read chunk ID = 0x%08X. Offset = "
-                 "%d.\n",
-              id,
-              header->id,
-              lseek(fd, 0, SEEK_CUR));
-      return 0;
-   }
+   b->end += count;
+   return 1;
+}
 
-   // Copy data in the chunk into chunk_data
-   if (chunk_data) {
-      assert(data_size > 0);
-
-      if (data_size > header->size) {
-         fprintf(stderr,
-                 "Tried to read more data than the chunk contains for ID "
-                    "0x%08X. Chunk data size = %d bytes, read size = %d "
-                    "bytes. Offset = %d.\n",
-                 id,
-                 header->size,
-                 data_size,
-                 lseek(fd, 0, SEEK_CUR));
-         return 0;         
-      }
-
-      if (read(fd, chunk_data, data_size) != data_size) {
-         fprintf(stderr,
-                 "Error while reading chunk data for chunk ID 0x%08X. "
-                    "Error = %d. Offset = %d.\n",
-                 id,
-                 errno,
-                 lseek(fd, 0, SEEK_CUR));
-         return 0;
-      }
-
-      // data_size now contains the number of bytes of chunk data to skip
-      data_size = header->size - data_size;
-   } else
-     data_size = header->size;
-
-   if (skip_data) {
-      // Add a padding byte if necessary
-      data_size += header->size % 2;
-
-      // Skip the rest of the chunk's data
-      if (lseek(fd, data_size, SEEK_CUR)==-1) {
-         fprintf(stderr,
-                 "Error while seeking to the end of chunk ID 0x%08X. Error = "
-                    "%d.\n",
-                 id,
-                 errno);
+// Takes exactly size bytes (no more than HEADER_BUFFER) from the input.
+// Returns 0 at EOF or on an error.
+static int take_bytes(int fd, struct ws_header_buffer *b,
+                      void *buffer, size_t size) {
+
+   while (b->end - b->start < size)
+      if (!fill_buffer(fd, b))
          return 0;
-      }
-   }
 
+   memcpy(buffer, b->data + b->start, size);
+   b->start += size;
+   b->pos += size;
    return 1;
 }
 
-// Skips every chunk in the file until it finds one with an ID matching
-// target_id. On success, the matching chunk header is copied into header and a
-// non-zero value is returned.
-static int skip_chunks(int fd, unsigned int target_id, struct chunk_header *header) {
-   if (!header) {
-      fprintf(stderr,
-              "skip_chunks: NULL header while looking for chunk ID 0x%08X\n",
-              target_id);
+// Skips size bytes of input: the ones already read, then seeking past the
+// rest, or reading them through the buffer if fd is a pipe
+static int skip_bytes(int fd, struct ws_header_buffer *b,
+                      unsigned long long size) {
+   size_t count;
+
+   b->pos += size;
+
+   count = b->end - b->start < size ? b->end - b->start : size;
+   b->start += count;
+   size -= count;
+
+   if (size == 0)
+      return 1;
+
+   b->start = b->end = 0;
+
+   if (lseek(fd, size, SEEK_CUR) != -1)
+      return 1;
+
+   if (errno != ESPIPE)
       return 0;
-   }
 
-   do {
-      if (read(fd, header, sizeof(*header)) != sizeof(*header)) {
-         skip_chunk_error("Read error", target_id);
+   while (size > 0) {
+      if (!fill_buffer(fd, b))
          return 0;
-      }
-
-      if (header->id != target_id) {
-         // Skip to the next chunk
-         if (lseek(fd, header->size + (header->size % 2), SEEK_CUR)==-1) {
-            skip_chunk_error("Unexpected EOF", target_id);
-            return 0;
-         }
-      }
-   } while (header->id != target_id);
+      count = b->end < size ? b->end : size;
+      b->start = count;
+      size -= count;
+   }
 
    return 1;
 }
 
+// Reads the start of a chunk's data into chunk_data (at most data_size bytes)
+// and skips the rest of it, with the padding byte.  Returns the number of
+// bytes read, or -1 on an error.
+static long read_chunk_data(int fd, struct ws_header_buffer *b,
+                            struct chunk_header *header,
+                            void *chunk_data, size_t data_size) {
+
+   if (data_size > header->size)
+      data_size = header->size;
+
+   if (!take_bytes(fd, b, chunk_data, data_size) ||
+       !skip_bytes(fd, b, header->size - data_size + header->size % 2)) {
+      fprintf(stderr,
+              "Error while reading chunk data for chunk ID 0x%08X. "
+                 "Error = %d.\n",
+              header->id,
+              errno);
+      return -1;
+   }
+
+   return data_size;
+}
+
 void print_riff_info(struct riff_header* h) {
 
   char id_string[5];
@@ -210,6 +176,15 @@ void print_format_info(struct fmt_header* h) {
 
 }
 
+void print_ds64_info(struct ds64_chunk* h) {
+
+  printf("-- RF64 Sizes --\n");
+  printf("  RIFF Size: %.2f KiB\n", h->riff_size / 1024.0);
+  printf("  Data Size: %.2f KiB\n", h->data_size / 1024.0);
+  printf("  Sample Count: %llu\n", h->sample_count);
+
+}
+
 void print_data_info(struct chunk_header* h) {
 
   char id_string[5];
@@ -222,28 +197,348 @@ void print_data_info(struct chunk_header* h) {
 
 }
 
-int process_headers(int fd, struct wav_file_headers *h) {
+// Sets h->format from the size bytes of a fmt chunk: its AudioFormat, or for
+// WAVE_FORMAT_EXTENSIBLE the format code the SubFormat GUID starts with.
+// Returns 0 if the chunk is too short to have them.
+static int sample_format(struct wav_file_headers *h,
+                         const unsigned char *fmt, size_t size) {
+
+  if (size < sizeof(h->fmt) - sizeof(h->fmt.header))
+     return 0;
+
+  h->format = (unsigned short)h->fmt.AudioFormat;
+
+  if (h->format == WAVE_FORMAT_EXTENSIBLE) {
+     if (size < FMT_EXTENSIBLE_SIZE)
+        return 0;
+     h->format = fmt[FMT_SUBFORMAT_OFFSET] |
+                 (fmt[FMT_SUBFORMAT_OFFSET + 1] << 8);
+  }
+
+  return 1;
+}
+
+// Reads the headers of a RIFF or RF64 WAV file, up to the start of the data.
+// The fmt chunk (and the ds64 chunk of RF64) may come in any order before the
+// data; other chunks are skipped.  The input is read HEADER_BUFFER bytes at a
+// time into b, so chunks of any size are passed over in bounded memory.  If
+// fd can seek, it's left at the first sample and b is empty; otherwise the
+// samples read past the data chunk header are left in b from b->start to
+// b->end, for the reader of the data to take first.
+int read_headers(int fd, struct wav_file_headers *h,
+                 struct ws_header_buffer *b) {
+
+  struct chunk_header chunk;
+  unsigned char fmt[FMT_EXTENSIBLE_SIZE];
+  long size;
+  int have_fmt = 0;
 
   if (!h) {
-     fprintf(stderr, "process_headers: wav_file_header is NULL\n");
+     fprintf(stderr, "read_headers: wav_file_header is NULL\n");
      return 0;
   }
 
-  if (!read_chunk(fd, RIFF_CHUNK_ID, &h->riff.header, (unsigned char *)&h->riff + sizeof(h->riff.header), sizeof(h->riff) - sizeof(h->riff.header), 0))
+  memset(h, 0, sizeof(*h));
+  b->start = b->end = 0;
+  b->pos = 0;
+
+  if (!take_bytes(fd, b, &h->riff, sizeof(h->riff))) {
+     fprintf(stderr,
+             "Error reading the RIFF header. Error = %d.\n",
+             errno);
      return 0;
+  }
 
-  if (!read_chunk(fd, FMT_CHUNK_ID, &h->fmt.header, (unsigned char *)&h->fmt + sizeof(h->fmt.header), sizeof(h->fmt) - sizeof(h->fmt.header), 1))
+  if (h->riff.header.id != RIFF_CHUNK_ID &&
+      h->riff.header.id != RF64_CHUNK_ID) {
+     fprintf(stderr,
+             "Expected chunk ID = 0x%08X or 0x%08X. Read chunk ID = 0x%08X.\n",
+             RIFF_CHUNK_ID,
+             RF64_CHUNK_ID,
+             h->riff.header.id);
      return 0;
+  }
+
+  for (;;) {
+     if (!take_bytes(fd, b, &chunk, sizeof(chunk))) {
+        skip_chunk_error("Read error", DATA_CHUNK_ID);
+        return 0;
+     }
+
+     if (chunk.id == DATA_CHUNK_ID)
+        break;
+
+     if (chunk.id == FMT_CHUNK_ID) {
+        h->fmt.header = chunk;
+        size = read_chunk_data(fd, b, &chunk, fmt, sizeof(fmt));
+        if (size == -1)
+           return 0;
+        memcpy((unsigned char *)&h->fmt + sizeof(chunk), fmt,
+               sizeof(h->fmt) - sizeof(chunk));
+        if (!sample_format(h, fmt, size)) {
+           fprintf(stderr,
+                   "The format chunk is too short (%u bytes)\n",
+                   chunk.size);
+           return 0;
+        }
+        have_fmt = 1;
+     } else if (chunk.id == DS64_CHUNK_ID) {
+        h->ds64.header = chunk;
+        if (read_chunk_data(fd, b, &chunk, (unsigned char *)&h->ds64 + sizeof(chunk), sizeof(h->ds64) - sizeof(chunk)) == -1)
+           return 0;
+     } else if (!skip_bytes(fd, b, chunk.size + chunk.size % 2)) {
+        skip_chunk_error("Unexpected EOF", DATA_CHUNK_ID);
+        return 0;
+     }
+  }
 
-  // Skip optional chunks
-  if (!skip_chunks(fd, DATA_CHUNK_ID, &h->data))
+  if (!have_fmt) {
+     fprintf(stderr, "No format chunk before the data\n");
      return 0;
+  }
+
+  h->data = chunk;
+  h->data_size = chunk.size;
+
+  if (h->riff.header.id == RF64_CHUNK_ID && chunk.size == RF64_SIZE)
+     h->data_size = h->ds64.data_size;
+
+  if (b->end > b->start &&
+      lseek(fd, -(off_t)(b->end - b->start), SEEK_CUR) != -1)
+     b->start = b->end = 0;
+
+  return 1;
+}
+
+// read_headers() for input that can seek, with a buffer of its own
+int process_headers(int fd, struct wav_file_headers *h) {
+
+  struct ws_header_buffer *b;
+  int ok;
+
+  b = malloc(sizeof(*b));
+  if (!b) {
+     fprintf(stderr, "Out of memory reading the headers\n");
+     return 0;
+  }
+
+  ok = read_headers(fd, h, b);
+  if (ok && b->end > b->start) {
+     fprintf(stderr, "Can't seek back to the start of the data\n");
+     ok = 0;
+  }
+
+  free(b);
+  return ok;
+}
+
+// The same as process_headers(), on the first size bytes of a file that are
+// already in memory, and without printing anything.  Returns HEADERS_OK with
+// the offset of the first sample in *data_offset, HEADERS_SHORT if the data
+// chunk isn't within the size bytes, or one of the errors.
+int parse_headers(const unsigned char *buffer, size_t size,
+                  struct wav_file_headers *h,
+                  unsigned long long *data_offset) {
+
+  struct chunk_header chunk;
+  unsigned long long pos;
+  size_t n;
+  int have_fmt = 0;
+
+  memset(h, 0, sizeof(*h));
+
+  if (size < sizeof(h->riff))
+     return HEADERS_SHORT;
+
+  memcpy(&h->riff, buffer, sizeof(h->riff));
+
+  if (h->riff.header.id != RIFF_CHUNK_ID &&
+      h->riff.header.id != RF64_CHUNK_ID)
+     return HEADERS_NOT_WAV;
+
+  for (pos = sizeof(h->riff);; pos += chunk.size + chunk.size % 2) {
+     if (pos + sizeof(chunk) > size)
+        return HEADERS_SHORT;
+
+     memcpy(&chunk, buffer + pos, sizeof(chunk));
+     pos += sizeof(chunk);
+
+     if (chunk.id == DATA_CHUNK_ID)
+        break;
+
+     if (chunk.id == FMT_CHUNK_ID) {
+        n = (chunk.size < FMT_EXTENSIBLE_SIZE) ? chunk.size
+                                               : FMT_EXTENSIBLE_SIZE;
+        if (pos + n > size)
+           return HEADERS_SHORT;
+        h->fmt.header = chunk;
+        if (n >= sizeof(h->fmt) - sizeof(chunk))
+           memcpy((unsigned char *)&h->fmt + sizeof(chunk), buffer + pos,
+                  sizeof(h->fmt) - sizeof(chunk));
+        if (!sample_format(h, buffer + pos, n))
+           return HEADERS_SHORT_FMT;
+        have_fmt = 1;
+     } else if (chunk.id == DS64_CHUNK_ID) {
+        n = sizeof(h->ds64) - sizeof(chunk);
+        if (n > chunk.size)
+           n = chunk.size;
+        if (pos + n > size)
+           return HEADERS_SHORT;
+        h->ds64.header = chunk;
+        memcpy((unsigned char *)&h->ds64 + sizeof(chunk), buffer + pos, n);
+     }
+  }
+
+  if (!have_fmt)
+     return HEADERS_NO_FMT;
+
+  h->data = chunk;
+  h->data_size = chunk.size;
+
+  if (h->riff.header.id == RF64_CHUNK_ID && chunk.size == RF64_SIZE)
+     h->data_size = h->ds64.data_size;
+
+  *data_offset = pos;
+
+  return HEADERS_OK;
+}
+
+const char *headers_error(int code) {
+
+  switch (code) {
+  case HEADERS_OK:
+     return "ok";
+  case HEADERS_SHORT:
+     return "no data chunk";
+  case HEADERS_NOT_WAV:
+     return "not a RIFF or RF64 file";
+  case HEADERS_SHORT_FMT:
+     return "format chunk too short";
+  default:
+     return "no format chunk before the data";
+  }
+}
+
+int headers_size(struct wav_file_headers* h) {
+
+  return sizeof(h->riff) + (h->reserve_ds64 ? sizeof(h->ds64) : 0) +
+         sizeof(h->fmt) + h->pad + sizeof(h->data);
+}
+
+// Lays out the headers as they go at the start of a file.  Returns the size,
+// which is headers_size(h).
+int pack_headers(struct wav_file_headers* h, unsigned char* buffer) {
+
+  struct chunk_header junk;
+
+  unsigned char *p = buffer;
+
+  memcpy(p, &h->riff, sizeof(h->riff));
+  p += sizeof(h->riff);
+
+  if (h->reserve_ds64) {
+     memcpy(p, &h->ds64, sizeof(h->ds64));
+     p += sizeof(h->ds64);
+  }
+
+  memcpy(p, &h->fmt, sizeof(h->fmt));
+  p += sizeof(h->fmt);
+
+  if (h->pad) {
+     junk.id = JUNK_CHUNK_ID;
+     junk.size = h->pad - sizeof(junk);
+     memcpy(p, &junk, sizeof(junk));
+     memset(p + sizeof(junk), 0, junk.size);
+     p += h->pad;
+  }
+
+  memcpy(p, &h->data, sizeof(h->data));
+  p += sizeof(h->data);
+
+  return p - buffer;
+}
+
+// Files made from h will start with a JUNK chunk that set_data_size() can
+// turn into a ds64 chunk
+void reserve_ds64(struct wav_file_headers* h) {
+
+  h->reserve_ds64 = 1;
+  h->riff.header.id = RIFF_CHUNK_ID;
+
+  memset(&h->ds64, 0, sizeof(h->ds64));
+  h->ds64.header.id = JUNK_CHUNK_ID;
+  h->ds64.header.size = sizeof(h->ds64) - sizeof(h->ds64.header);
+
+}
+
+// Pads the headers with a JUNK chunk so the samples of a file made from h
+// start at the same offset within a block as offset does (in the input), as
+// cloning a range of the input needs.  Returns the padding; 0 if none was
+// needed or the offsets can't line up.
+unsigned int align_data(struct wav_file_headers* h, unsigned long long offset,
+                        unsigned int block) {
+
+  unsigned int need;
+
+  h->pad = 0;
+  need = (offset - headers_size(h)) % block;
+
+  // RIFF chunks are a whole number of words, and a chunk header is 8 bytes
+  if (need & 1)
+     return 0;
+  if (need && (need < sizeof(struct chunk_header)))
+     need += block;
+
+  h->pad = need;
+
+  return need;
+}
+
+// Sets the sizes for length bytes of data.  Headers with reserve_ds64 set
+// become RF64 if the RIFF sizes can't hold length; returns 0 if that was
+// needed but there was no room, in which case the sizes are 0xFFFFFFFF.
+int set_data_size(struct wav_file_headers* h, unsigned long long length) {
+
+  unsigned long long riff_size = headers_size(h) - sizeof(h->riff.header) +
+                                 length;
+
+  // The fmt chunk is written without the extensible fields, so it takes the
+  // format the SubFormat named
+  h->fmt.header.size = sizeof(h->fmt) - sizeof(h->fmt.header);
+  if ((unsigned short)h->fmt.AudioFormat == WAVE_FORMAT_EXTENSIBLE)
+     h->fmt.AudioFormat = h->format;
+  h->data_size = length;
+
+  if (h->reserve_ds64)
+     reserve_ds64(h);
+
+  if (riff_size < RF64_SIZE) {
+     h->riff.header.id = RIFF_CHUNK_ID;
+     h->riff.header.size = riff_size;
+     h->data.size = length;
+     return 1;
+  }
+
+  h->riff.header.size = RF64_SIZE;
+  h->data.size = RF64_SIZE;
+
+  if (!h->reserve_ds64)
+     return 0;
+
+  h->riff.header.id = RF64_CHUNK_ID;
+  h->ds64.header.id = DS64_CHUNK_ID;
+  h->ds64.riff_size = riff_size;
+  h->ds64.data_size = length;
+  if (h->fmt.BlockAlign > 0)
+     h->ds64.sample_count = length / h->fmt.BlockAlign;
 
   return 1;
 }
 
 int write_headers(int fd, struct wav_file_headers* h) {
 
+   unsigned char buffer[MAX_HEADER_SIZE];
+   int size;
    off_t offset = lseek(fd, 0, SEEK_CUR);
 
    if (offset==-1) {
@@ -258,39 +553,16 @@ int write_headers(int fd, struct wav_file_headers* h) {
       return 0;
    }
 
-  // RIFF Header
-  if (write(fd, &h->riff, sizeof(h->riff)) != sizeof(h->riff)) {
-     fprintf(stderr,
-             "write_headers: Error while writing RIFF header. Start offset = "
-                "%d. Error = %d.\n",
-             offset,
-             errno);
-     return 0;
-   }
-
-  offset += sizeof(h->riff);
+   size = pack_headers(h, buffer);
 
-  // FMT Header
-  if (write(fd, &h->fmt, sizeof(h->fmt)) != sizeof(h->fmt)) {
+   if (write(fd, buffer, size) != size) {
      fprintf(stderr,
-             "write_headers: Error while writing format header. Start offset = "
-                "%d. Error = %d.\n",
-             offset,
+             "write_headers: Error while writing the headers. Start offset = "
+                "%lld. Error = %d.\n",
+             (long long)offset,
              errno);
      return 0;
-  }
-
-  offset += sizeof(h->fmt);
-
-  // DATA Header
-  if (write(fd, &h->data, sizeof(h->data)) != sizeof(h->data)) {
-     fprintf(stderr,
-             "write_headers: Error while writing data header. Start offset = "
-               "%d. Error = %d.\n",
-             offset,
-             errno);
-     return 0;
-  }
+   }
 
   return 1;
 }
@@ -36,6 +36,25 @@
 #define RIFF_CHUNK_ID 0x46464952 // "RIFF"
 #define FMT_CHUNK_ID  0x20746d66 // "fmt "
 #define DATA_CHUNK_ID 0x61746164 // "DATA"
+#define RF64_CHUNK_ID 0x34364652 // "RF64"
+#define DS64_CHUNK_ID 0x34367364 // "ds64"
+#define JUNK_CHUNK_ID 0x4b4e554a // "JUNK"
+
+// WAVE_FORMAT_EXTENSIBLE keeps the real format in the first two bytes of
+// the SubFormat GUID, after the fmt_header fields and 8 bytes of its own
+#define WAVE_FORMAT_EXTENSIBLE  0xFFFE
+#define FMT_SUBFORMAT_OFFSET    24
+#define FMT_EXTENSIBLE_SIZE     (FMT_SUBFORMAT_OFFSET + 2)
+
+// What parse_headers() found
+#define HEADERS_OK         1
+#define HEADERS_SHORT      0   // The data chunk is further on
+#define HEADERS_NOT_WAV   -1
+#define HEADERS_SHORT_FMT -2
+#define HEADERS_NO_FMT    -3
+
+// RIFF sizes of RF64 files; the real ones are in the ds64 chunk
+#define RF64_SIZE     0xFFFFFFFFU
 
 #pragma pack(push, 1)
 
@@ -66,14 +85,56 @@ struct fmt_header {
 
 };
 
+// EBU Tech 3306: 64-bit sizes for files over 4 GB, right after the RIFF
+// header.  A JUNK chunk of the same size keeps its place in files that might
+// need it.
+struct ds64_chunk {
+
+   struct chunk_header header;
+
+  unsigned long long riff_size;
+  unsigned long long data_size;
+  unsigned long long sample_count;
+  unsigned int table_length;
+
+};
+
 #pragma pack(pop)
 
+#define MAX_HEADER_SIZE (sizeof(struct riff_header) + \
+                         sizeof(struct ds64_chunk) + \
+                         sizeof(struct fmt_header) + \
+                         sizeof(struct chunk_header))
+
+// Input read by read_headers(), HEADER_BUFFER bytes at a time
+#define HEADER_BUFFER (64 * 1024)
+
+struct ws_header_buffer {
+
+  unsigned char data[HEADER_BUFFER];
+  size_t start;                     // Bytes not taken yet
+  size_t end;
+  unsigned long long pos;           // Bytes of input taken or skipped; the
+                                    // offset of the first sample after
+                                    // read_headers()
+
+};
+
 struct wav_file_headers {
 
   struct riff_header  riff;
   struct fmt_header   fmt;
   struct chunk_header data;
 
+  struct ds64_chunk   ds64;         // Read from RF64 input
+  int format;                       // AudioFormat, or the SubFormat of
+                                    // WAVE_FORMAT_EXTENSIBLE
+  int reserve_ds64;                 // Write a JUNK chunk to make RF64 of
+  unsigned int pad;                 // Bytes of JUNK chunk before the data
+                                    // chunk, to align the samples (not in
+                                    // MAX_HEADER_SIZE)
+  unsigned long long data_size;     // The real size of the data chunk
+
 };
 
 // Functions
@@ -81,8 +142,22 @@ struct wav_file_headers {
 void print_riff_info(struct riff_header* h);
 void print_format_info(struct fmt_header* h);
 void print_data_info(struct chunk_header* h);
+void print_ds64_info(struct ds64_chunk* h);
 
+int read_headers(int fd, struct wav_file_headers *h,
+                 struct ws_header_buffer *b);
 int process_headers(int fd, struct wav_file_headers *h);
+int parse_headers(const unsigned char *buffer, size_t size,
+                  struct wav_file_headers *h,
+                  unsigned long long *data_offset);
+const char *headers_error(int code);
+
+int headers_size(struct wav_file_headers* h);
+int pack_headers(struct wav_file_headers* h, unsigned char* buffer);
+void reserve_ds64(struct wav_file_headers* h);
+unsigned int align_data(struct wav_file_headers* h, unsigned long long offset,
+                        unsigned int block);
+int set_data_size(struct wav_file_headers* h, unsigned long long length);
 
 int write_headers(int fd, struct wav_file_headers* h);
 int fp_write_headers(FILE* fp, struct wav_file_headers* h);
@@ -0,0 +1,319 @@
+/*  wavhook.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    -e commands.  Each piece's command is queued, and at most -J of them
+    run at once; the rest wait their turn, so hundreds of short pieces no
+    longer start hundreds of encoders.
+
+    The commands are started with posix_spawn() (through /bin/sh, since
+    -e may have arguments), and a reaper thread waits for SIGCHLD, which is
+    blocked everywhere else, collects the commands that exited and starts
+    the next ones in the queue.  It only waits for its own children, so the
+    ones popen() starts for -P are left to pclose().
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "wavhook.h"
+
+extern char **environ;
+
+static double seconds(const struct timespec *from, const struct timespec *to) {
+
+  return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+
+}
+
+// Must be called before any thread is started, so they all inherit it
+void hooks_block_sigchld(void) {
+
+  sigset_t set;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGCHLD);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+}
+
+// Starts hook; called with the lock held
+static void start_hook(struct ws_hooks *h, struct ws_hook *hook) {
+
+  posix_spawn_file_actions_t actions;
+  char *argv[5];
+  int err;
+
+  // The piece name goes in as $0 of "sh -c", so it needs no quoting
+  argv[0] = "sh";
+  argv[1] = "-c";
+  argv[2] = hook->command;
+  argv[3] = hook->path;
+  argv[4] = NULL;
+
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+  clock_gettime(CLOCK_MONOTONIC, &hook->started);
+
+  err = posix_spawn(&hook->pid, "/bin/sh", &actions, NULL, argv, environ);
+
+  posix_spawn_file_actions_destroy(&actions);
+
+  if(err) {
+    fprintf(stderr, "Could not run %s. Error = %d.\n", hook->command, err);
+    hook->pid = 0;
+    hook->status = -1;
+    hook->done = 1;
+    hook->finished = hook->started;
+    return;
+  }
+
+  hook->next_running = h->run;
+  h->run = hook;
+  h->running++;
+
+}
+
+// Starts queued hooks while there are free slots; called with the lock held
+static void dispatch(struct ws_hooks *h) {
+
+  struct ws_hook *hook;
+
+  while((h->running < h->max) && h->queue) {
+    hook = h->queue;
+    h->queue = hook->next_queued;
+    if(h->queue == NULL)
+      h->queue_last = NULL;
+    start_hook(h, hook);
+  }
+
+}
+
+// Collects every finished hook; called with the lock held
+static void reap(struct ws_hooks *h) {
+
+  struct ws_hook **p = &h->run;
+  struct ws_hook *hook;
+  int status;
+
+  while((hook = *p) != NULL) {
+
+    if(waitpid(hook->pid, &status, WNOHANG) <= 0) {
+      p = &hook->next_running;
+      continue;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &hook->finished);
+    hook->status = status;
+    hook->done = 1;
+
+    // Only a command that worked may take the piece away
+    if(hook->remove && WIFEXITED(status) && (WEXITSTATUS(status) == 0))
+      hook->removed = (unlink(hook->path) == 0);
+
+    *p = hook->next_running;
+    h->running--;
+  }
+
+}
+
+static void *reaper(void *arg) {
+
+  struct ws_hooks *h = arg;
+  struct timespec timeout = { 1, 0 };
+  sigset_t set;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGCHLD);
+
+  pthread_mutex_lock(&h->lock);
+
+  while(!h->stopping) {
+    pthread_mutex_unlock(&h->lock);
+
+    // The timeout only guards against a lost wakeup; SIGCHLDs that arrive
+    // together are merged, and reap() checks every running hook anyway
+    sigtimedwait(&set, NULL, &timeout);
+
+    pthread_mutex_lock(&h->lock);
+    reap(h);
+    dispatch(h);
+    pthread_cond_broadcast(&h->changed);
+  }
+
+  pthread_mutex_unlock(&h->lock);
+
+  return NULL;
+}
+
+// Returns 0 if the reaper can't be started
+int hooks_init(struct ws_hooks *h, int max) {
+
+  memset(h, 0, sizeof(*h));
+  h->max = (max > 0) ? max : 1;
+
+  pthread_mutex_init(&h->lock, NULL);
+  pthread_cond_init(&h->changed, NULL);
+
+  if(pthread_create(&h->reaper, NULL, reaper, h) != 0) {
+    fprintf(stderr, "Could not start the hook reaper\n");
+    return 0;
+  }
+
+  h->started = 1;
+
+  return 1;
+}
+
+void hooks_stop(struct ws_hooks *h) {
+
+  if(!h->started)
+    return;
+
+  pthread_mutex_lock(&h->lock);
+  h->stopping = 1;
+  pthread_mutex_unlock(&h->lock);
+
+  pthread_kill(h->reaper, SIGCHLD);
+  pthread_join(h->reaper, NULL);
+
+  h->started = 0;
+
+}
+
+// Queues command for path, and starts it if there is a free slot
+void hook_run(struct ws_hooks *h, struct ws_hook_list *list,
+              const char *command, const char *path, int remove) {
+
+  struct ws_hook *hook;
+  size_t len = strlen(command);
+
+  hook = calloc(1, sizeof(*hook));
+  if(hook)
+    hook->command = malloc(len + 6);
+  if(hook)
+    hook->path = strdup(path);
+
+  if(!hook || !hook->command || !hook->path) {
+    fprintf(stderr, "Could not queue the command for %s\n", path);
+    if(hook) {
+      free(hook->command);
+      free(hook->path);
+    }
+    free(hook);
+    return;
+  }
+
+  snprintf(hook->command, len + 6, "%s \"$0\"", command);
+  hook->remove = remove;
+  clock_gettime(CLOCK_MONOTONIC, &hook->queued);
+
+  pthread_mutex_lock(&h->lock);
+
+  if(list->last)
+    list->last->next = hook;
+  else
+    list->first = hook;
+  list->last = hook;
+
+  if(h->queue_last)
+    h->queue_last->next_queued = hook;
+  else
+    h->queue = hook;
+  h->queue_last = hook;
+
+  dispatch(h);
+
+  pthread_mutex_unlock(&h->lock);
+
+}
+
+// Waits until every hook in list has finished
+void hooks_wait(struct ws_hooks *h, struct ws_hook_list *list) {
+
+  struct ws_hook *hook;
+
+  pthread_mutex_lock(&h->lock);
+
+  for(hook = list->first; hook; hook = hook->next)
+    while(!hook->done)
+      pthread_cond_wait(&h->changed, &h->lock);
+
+  pthread_mutex_unlock(&h->lock);
+
+}
+
+// One line per hook, for the -l log
+void hooks_log(struct ws_hook_list *list, FILE *fp) {
+
+  struct ws_hook *hook;
+  char result[64];
+
+  if(list->first)
+    fprintf(fp, "\n# === Commands ===\n");
+
+  for(hook = list->first; hook; hook = hook->next) {
+
+    if(hook->status == -1)
+      snprintf(result, sizeof(result), "could not start");
+    else if(WIFEXITED(hook->status))
+      snprintf(result, sizeof(result), "exit %i%s",
+               WEXITSTATUS(hook->status), hook->removed ? ", removed" : "");
+    else
+      snprintf(result, sizeof(result), "signal %i",
+               WTERMSIG(hook->status));
+
+    fprintf(fp, "# %20s: %s, waited %.2f s, ran %.2f s\n", hook->path, result,
+            seconds(&hook->queued, &hook->started),
+            seconds(&hook->started, &hook->finished));
+  }
+
+}
+
+void hooks_free(struct ws_hook_list *list) {
+
+  struct ws_hook *hook, *next;
+
+  for(hook = list->first; hook; hook = next) {
+    next = hook->next;
+    free(hook->command);
+    free(hook->path);
+    free(hook);
+  }
+
+  list->first = list->last = NULL;
+
+}
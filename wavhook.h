@@ -0,0 +1,95 @@
+/*  wavhook.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_HOOK_H
+#define WAV_HOOK_H
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// One -e command for one piece
+struct ws_hook {
+
+  char *command;
+  char *path;               // The piece
+  int remove;               // -r: unlink path if the command succeeds
+
+  pid_t pid;                // 0 until it runs
+  int status;               // From waitpid(), or -1 if it couldn't start
+  int done;
+  int removed;
+
+  struct timespec queued;
+  struct timespec started;
+  struct timespec finished;
+
+  struct ws_hook *next;     // In its job's list
+  struct ws_hook *next_queued;
+  struct ws_hook *next_running;
+
+};
+
+// The hooks of one job, in the order they were queued
+struct ws_hook_list {
+
+  struct ws_hook *first;
+  struct ws_hook *last;
+
+};
+
+struct ws_hooks {
+
+  int max;                  // Commands run at once (-J)
+  int running;
+
+  struct ws_hook *queue;    // Waiting for a free slot
+  struct ws_hook *queue_last;
+  struct ws_hook *run;      // Running
+
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  pthread_t reaper;
+  int started;
+  int stopping;
+
+};
+
+// Functions
+
+void hooks_block_sigchld(void);
+int hooks_init(struct ws_hooks *h, int max);
+void hooks_stop(struct ws_hooks *h);
+
+void hook_run(struct ws_hooks *h, struct ws_hook_list *list,
+              const char *command, const char *path, int remove);
+void hooks_wait(struct ws_hooks *h, struct ws_hook_list *list);
+void hooks_log(struct ws_hook_list *list, FILE *fp);
+void hooks_free(struct ws_hook_list *list);
+
+#endif
@@ -0,0 +1,519 @@
+/*  wavindex.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Sidecar peak index (<input>.wsidx).
+
+    The index holds the min, max and RMS of every INDEX_FRAMES frames of the
+    data chunk, and of every INDEX_FANOUT entries of the level below that, for
+    INDEX_LEVELS levels.  Min and max don't depend on -t, so one index answers
+    "is there a loud sample in here" for any threshold, and the split points
+    for any -t/-g/-o/-m can be worked out without reading the audio.
+
+    The only thing the index can't say is exactly where in an entry the last
+    loud sample is.  That only matters when the silence that follows comes
+    close to GAP or OVERRIDE (or a -b block doesn't line up with the entries),
+    and then the few samples in question are read from the input.
+
+    The index is tied to the input's size and modification time, and is
+    ignored if either has changed.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "wavindex.h"
+
+static long long entry_count(long long samples, long long per_entry) {
+
+  return (samples + per_entry - 1) / per_entry;
+
+}
+
+static int flush_level(struct ws_index *ix, int l) {
+
+  struct index_level *lv = &ix->level[l];
+  size_t size = lv->buffered * sizeof(struct index_entry);
+
+  if(lv->buffered == 0)
+    return 1;
+
+  if(pwrite(ix->fd, lv->buffer, size, lv->offset) != (ssize_t)size) {
+    fprintf(stderr, "index: Error writing %s. Error = %d.\n",
+            ix->tmp_path, errno);
+    return 0;
+  }
+
+  lv->offset += size;
+  ix->written[l] += lv->buffered;
+  lv->buffered = 0;
+
+  return 1;
+}
+
+// Closes the entry being accumulated at level l and folds it into the level
+// above.
+static int push_entry(struct ws_index *ix, int l) {
+
+  struct index_level *lv = &ix->level[l];
+  struct index_level *up;
+  struct index_entry *e;
+  double rms;
+
+  if(lv->samples == 0)
+    return 1;
+
+  rms = sqrt((double)lv->sum_squares / lv->samples);
+
+  e = &lv->buffer[lv->buffered++];
+  e->min = lv->min;
+  e->max = lv->max;
+  e->rms = (rms > 65535) ? 65535 : (unsigned short)rms;
+
+  if(l + 1 < INDEX_LEVELS) {
+    up = &ix->level[l + 1];
+    if((up->samples == 0) || (lv->min < up->min))
+      up->min = lv->min;
+    if((up->samples == 0) || (lv->max > up->max))
+      up->max = lv->max;
+    up->sum_squares += lv->sum_squares;
+    up->samples += lv->samples;
+    up->children++;
+  }
+
+  lv->samples = 0;
+  lv->sum_squares = 0;
+  lv->children = 0;
+
+  if((lv->buffered == INDEX_BUFFER) && !flush_level(ix, l))
+    return 0;
+
+  if((l + 1 < INDEX_LEVELS) && (ix->level[l + 1].children == INDEX_FANOUT))
+    return push_entry(ix, l + 1);
+
+  return 1;
+}
+
+// Starts an index for the data chunk of input_fd, which begins at
+// data_offset.  The index is written to a temporary file next to the input and
+// only takes the real name in index_finish().
+int index_create(struct ws_index *ix, const char *input_path, int input_fd,
+                 off_t data_offset, struct wav_file_headers *h) {
+
+  struct stat st;
+  long long samples;
+  off_t offset;
+  int l;
+
+  memset(ix, 0, sizeof(*ix));
+  ix->fd = -1;
+
+  if(fstat(input_fd, &st) == -1)
+    return 0;
+
+  if(snprintf(ix->path, sizeof(ix->path), "%s" INDEX_SUFFIX, input_path) >=
+     (int)sizeof(ix->path)) {
+    fprintf(stderr, "index: The name of the index of %s is too long\n",
+            input_path);
+    return 0;
+  }
+  snprintf(ix->tmp_path, sizeof(ix->tmp_path), "%s.tmp", ix->path);
+
+  ix->entry_samples = INDEX_FRAMES * h->fmt.NumChannels;
+  samples = (st.st_size - data_offset) / sizeof(short);
+
+  ix->header.magic = INDEX_MAGIC;
+  ix->header.version = INDEX_VERSION;
+  ix->header.input_size = st.st_size;
+  ix->header.input_mtime = st.st_mtim.tv_sec;
+  ix->header.input_mtime_nsec = st.st_mtim.tv_nsec;
+  ix->header.data_offset = data_offset;
+  ix->header.fmt = h->fmt;
+  ix->header.frames = INDEX_FRAMES;
+  ix->header.fanout = INDEX_FANOUT;
+  ix->header.levels = INDEX_LEVELS;
+
+  ix->header.count[0] = entry_count(samples, ix->entry_samples);
+  for(l = 1; l < INDEX_LEVELS; l++)
+    ix->header.count[l] = entry_count(ix->header.count[l - 1], INDEX_FANOUT);
+
+  ix->fd = open(ix->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if(ix->fd == -1) {
+    fprintf(stderr, "index: Could not create %s. Error = %d.\n",
+            ix->tmp_path, errno);
+    return 0;
+  }
+
+  offset = sizeof(ix->header);
+  for(l = 0; l < INDEX_LEVELS; l++) {
+    ix->level[l].buffer = malloc(INDEX_BUFFER * sizeof(struct index_entry));
+    ix->level[l].offset = offset;
+    offset += ix->header.count[l] * sizeof(struct index_entry);
+  }
+
+  return 1;
+}
+
+// Adds the next count samples of the data chunk to the index.
+int index_add(struct ws_index *ix, const short *samples, int count) {
+
+  struct index_level *lv = &ix->level[0];
+  long long sum_squares;
+  int min, max;
+  int i, n;
+
+  while(count > 0) {
+
+    n = ix->entry_samples - lv->samples;
+    if(n > count)
+      n = count;
+
+    min = max = samples[0];
+    sum_squares = 0;
+    for(i = 0; i < n; i++) {
+      if(samples[i] < min)
+        min = samples[i];
+      if(samples[i] > max)
+        max = samples[i];
+      sum_squares += samples[i] * samples[i];
+    }
+
+    if((lv->samples == 0) || (min < lv->min))
+      lv->min = min;
+    if((lv->samples == 0) || (max > lv->max))
+      lv->max = max;
+    lv->sum_squares += sum_squares;
+    lv->samples += n;
+
+    if((lv->samples == ix->entry_samples) && !push_entry(ix, 0))
+      return 0;
+
+    samples += n;
+    count -= n;
+  }
+
+  return 1;
+}
+
+// Writes out what is left of the index and gives it its real name.
+int index_finish(struct ws_index *ix) {
+
+  int l;
+
+  for(l = 0; l < INDEX_LEVELS; l++)
+    if(!push_entry(ix, l) || !flush_level(ix, l))
+      goto fail;
+
+  for(l = 0; l < INDEX_LEVELS; l++)
+    if(ix->written[l] != ix->header.count[l]) {
+      fprintf(stderr, "index: Input changed while it was being indexed\n");
+      goto fail;
+    }
+
+  if(pwrite(ix->fd, &ix->header, sizeof(ix->header), 0) !=
+     sizeof(ix->header)) {
+    fprintf(stderr, "index: Error writing %s. Error = %d.\n",
+            ix->tmp_path, errno);
+    goto fail;
+  }
+
+  close(ix->fd);
+  ix->fd = -1;
+
+  if(rename(ix->tmp_path, ix->path) == -1) {
+    fprintf(stderr, "index: Could not rename %s. Error = %d.\n",
+            ix->tmp_path, errno);
+    unlink(ix->tmp_path);
+    index_close(ix);
+    return 0;
+  }
+
+  index_close(ix);
+  return 1;
+
+ fail:
+  index_abort(ix);
+  return 0;
+}
+
+void index_abort(struct ws_index *ix) {
+
+  if(ix->fd != -1) {
+    close(ix->fd);
+    unlink(ix->tmp_path);
+  }
+  ix->fd = -1;
+
+  index_close(ix);
+
+}
+
+// Maps the index for input_fd, if there is one and it still matches the
+// input.  Returns 0 (quietly) if there is no usable index.
+int index_open(struct ws_index *ix, const char *input_path, int input_fd,
+               off_t data_offset, struct wav_file_headers *h) {
+
+  struct stat st, ist;
+  struct index_file_header *hdr;
+  size_t size;
+  int l;
+
+  memset(ix, 0, sizeof(*ix));
+  ix->fd = -1;
+
+  // index_create() says if the name is too long
+  if(snprintf(ix->path, sizeof(ix->path), "%s" INDEX_SUFFIX, input_path) >=
+     (int)sizeof(ix->path))
+    return 0;
+
+  if((fstat(input_fd, &st) == -1) || (stat(ix->path, &ist) == -1) ||
+     (ist.st_size < (off_t)sizeof(*hdr)))
+    return 0;
+
+  ix->fd = open(ix->path, O_RDONLY);
+  if(ix->fd == -1)
+    return 0;
+
+  ix->map = mmap(NULL, ist.st_size, PROT_READ, MAP_SHARED, ix->fd, 0);
+  close(ix->fd);
+  ix->fd = -1;
+
+  if(ix->map == MAP_FAILED) {
+    ix->map = NULL;
+    return 0;
+  }
+  ix->map_len = ist.st_size;
+
+  hdr = (struct index_file_header *)ix->map;
+
+  if((hdr->magic != INDEX_MAGIC) || (hdr->version != INDEX_VERSION) ||
+     (hdr->input_size != st.st_size) ||
+     (hdr->input_mtime != st.st_mtim.tv_sec) ||
+     (hdr->input_mtime_nsec != st.st_mtim.tv_nsec) ||
+     (hdr->data_offset != data_offset) ||
+     memcmp(&hdr->fmt, &h->fmt, sizeof(h->fmt)) ||
+     (hdr->frames != INDEX_FRAMES) || (hdr->fanout != INDEX_FANOUT) ||
+     (hdr->levels != INDEX_LEVELS))
+    goto stale;
+
+  size = sizeof(*hdr);
+  for(l = 0; l < INDEX_LEVELS; l++) {
+    ix->entries[l] = (const struct index_entry *)(ix->map + size);
+    size += hdr->count[l] * sizeof(struct index_entry);
+  }
+
+  if(size != ix->map_len)
+    goto stale;
+
+  ix->header = *hdr;
+  ix->entry_samples = INDEX_FRAMES * h->fmt.NumChannels;
+
+  return 1;
+
+ stale:
+  index_close(ix);
+  return 0;
+}
+
+static int entry_loud(struct ws_index *ix, const struct ws_detector *d,
+                      int l, long long e) {
+
+  return detect_range(d, ix->entries[l][e].min, ix->entries[l][e].max);
+
+}
+
+// Returns the last finest-level entry between first and last (inclusive) with
+// a loud sample in it, or -1.  Silent stretches are skipped a whole coarse
+// entry at a time.
+static long long last_loud_entry(struct ws_index *ix,
+                                 const struct ws_detector *d,
+                                 long long first, long long last) {
+
+  long long e = last;
+  long long span[INDEX_LEVELS];
+  int l, skipped;
+
+  span[0] = 1;
+  for(l = 1; l < INDEX_LEVELS; l++)
+    span[l] = span[l - 1] * INDEX_FANOUT;
+
+  while(e >= first) {
+
+    skipped = 0;
+    for(l = INDEX_LEVELS - 1; l > 0; l--) {
+      if(((e + 1) % span[l] == 0) && (e + 1 - span[l] >= first) &&
+         !entry_loud(ix, d, l, e / span[l])) {
+        e -= span[l];
+        skipped = 1;
+        break;
+      }
+    }
+
+    if(skipped)
+      continue;
+
+    if(entry_loud(ix, d, 0, e))
+      return e;
+    e--;
+  }
+
+  return -1;
+}
+
+static int read_samples(int fd, off_t offset, short *buffer, int count) {
+
+  ssize_t size = count * sizeof(short);
+
+  if(pread(fd, buffer, size, offset) != size) {
+    fprintf(stderr, "index: Error reading input at offset %lld. Error = %d.\n",
+            (long long)offset, errno);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Works out the pieces for the whole data chunk from the index, feeding the
+// splitter one -b block at a time just like process_data() does.
+int index_plan(struct ws_index *ix, int input_fd,
+               const struct ws_detector *d, struct ws_splitter *sp,
+               int block_samples, struct ws_plan *plan) {
+
+  off_t data_offset = ix->header.data_offset;
+  off_t data_size = ix->header.input_size - data_offset;
+  off_t block_size = block_samples * sizeof(short);
+  long long samples = data_size / sizeof(short);
+  long long s0, s1, e, e_start, e_end;
+  long long tail_lo = 0, tail_hi = 0, tail_e = -1, tail_s1 = 0;
+  long long run = 0;               // Silent samples since the tail block
+  long long c_lo, c_hi;
+  short *buffer;
+  off_t offset;
+  int size, count, frames, tail, result;
+  int channels = ix->header.fmt.NumChannels;
+  int F = ix->entry_samples;
+
+  buffer = malloc(block_size > F * sizeof(short) ?
+                  block_size : F * sizeof(short));
+
+  for(offset = 0; offset < data_size; offset += block_size) {
+
+    size = (data_size - offset < block_size) ? data_size - offset : block_size;
+    count = size / sizeof(short);
+    frames = count / channels;
+
+    s0 = offset / sizeof(short);
+    s1 = s0 + count;
+
+    e = (count > 0) ? last_loud_entry(ix, d, s0 / F, (s1 - 1) / F) : -1;
+
+    if(e == -1)
+      run += count;
+    else {
+      e_start = e * F;
+      e_end = (e_start + F < samples) ? e_start + F : samples;
+
+      if((e_start < s0) || (e_end > s1)) {
+        // The entry hangs over the edge of the block, so the loud sample
+        // could be in the next or previous block
+        if(!read_samples(input_fd, data_offset + offset, buffer, count))
+          goto fail;
+        ix->pcm_reads++;
+        if(detect_block(d, buffer, count, &tail)) {
+          tail_lo = tail_hi = tail;
+          tail_e = -1;
+          run = 0;
+        } else
+          run += count;
+      } else {
+        tail_lo = s1 - e_end;
+        tail_hi = s1 - e_start - 1;
+        tail_e = e;
+        tail_s1 = s1;
+        run = 0;
+      }
+    }
+
+    c_lo = tail_lo + run;
+    c_hi = tail_hi + run;
+
+    // Pin the counter down when the decision depends on where in the entry
+    // the last loud sample was
+    if((c_lo != c_hi) &&
+       ((sp->silence_flag && (c_lo == 0)) ||
+        (!sp->silence_flag && (((c_lo <= sp->gap) && (c_hi > sp->gap)) ||
+                               ((sp->override >= 0) &&
+                                (c_lo <= sp->override) &&
+                                (c_hi > sp->override)))))) {
+      e_start = tail_e * F;
+      e_end = (e_start + F < samples) ? e_start + F : samples;
+      if(!read_samples(input_fd, data_offset + e_start * sizeof(short),
+                       buffer, e_end - e_start))
+        goto fail;
+      ix->pcm_reads++;
+      detect_block(d, buffer, e_end - e_start, &tail);
+      tail_lo = tail_hi = tail + (tail_s1 - e_end);
+      c_lo = c_hi = tail_lo + run;
+    }
+
+    result = split_feed(sp, c_lo, frames);
+    if(!plan_add(plan, result, offset, size, frames))
+      goto fail;
+  }
+
+  plan_finish(plan);
+  free(buffer);
+  return 1;
+
+ fail:
+  free(buffer);
+  return 0;
+}
+
+void index_close(struct ws_index *ix) {
+
+  int l;
+
+  if(ix->map)
+    munmap(ix->map, ix->map_len);
+  ix->map = NULL;
+
+  for(l = 0; l < INDEX_LEVELS; l++) {
+    free(ix->level[l].buffer);
+    ix->level[l].buffer = NULL;
+  }
+
+}
@@ -0,0 +1,129 @@
+/*  wavindex.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_INDEX_H
+#define WAV_INDEX_H
+
+#include <sys/types.h>
+
+#include "wavheader.h"
+#include "wavdetect.h"
+#include "wavsplit.h"
+
+#define INDEX_SUFFIX    ".wsidx"
+
+#define INDEX_MAGIC     0x58495357 // "WSIX"
+#define INDEX_VERSION   1
+
+#define INDEX_LEVELS    3
+#define INDEX_FRAMES    32         // Frames per entry at the finest level
+#define INDEX_FANOUT    32         // Entries per entry at the next level up
+#define INDEX_BUFFER    4096       // Entries buffered per level when writing
+
+#pragma pack(push, 1)
+
+struct index_entry {
+
+  short min;
+  short max;
+  unsigned short rms;
+
+};
+
+struct index_file_header {
+
+  unsigned int magic;
+  unsigned int version;
+
+  // The input this index describes
+  long long input_size;
+  long long input_mtime;
+  long long input_mtime_nsec;
+  long long data_offset;
+  struct fmt_header fmt;
+
+  unsigned int frames;
+  unsigned int fanout;
+  unsigned int levels;
+  long long count[INDEX_LEVELS];
+
+};
+
+#pragma pack(pop)
+
+struct index_level {
+
+  // Entry being accumulated
+  short min;
+  short max;
+  long long sum_squares;
+  long long samples;
+  int children;
+
+  // Entries waiting to be written
+  struct index_entry *buffer;
+  int buffered;
+  off_t offset;
+
+};
+
+struct ws_index {
+
+  char path[FILENAME_MAX];
+  char tmp_path[FILENAME_MAX + 4]; // path and ".tmp"
+  int fd;
+  struct index_file_header header;
+  int entry_samples;               // Samples per entry at the finest level
+  long long written[INDEX_LEVELS];
+
+  // Building
+  struct index_level level[INDEX_LEVELS];
+
+  // Reading
+  unsigned char *map;
+  size_t map_len;
+  const struct index_entry *entries[INDEX_LEVELS];
+  long long pcm_reads;             // Blocks the index couldn't decide alone
+
+};
+
+// Functions
+
+int index_create(struct ws_index *ix, const char *input_path, int input_fd,
+                 off_t data_offset, struct wav_file_headers *h);
+int index_add(struct ws_index *ix, const short *samples, int count);
+int index_finish(struct ws_index *ix);
+void index_abort(struct ws_index *ix);
+
+int index_open(struct ws_index *ix, const char *input_path, int input_fd,
+               off_t data_offset, struct wav_file_headers *h);
+int index_plan(struct ws_index *ix, int input_fd,
+               const struct ws_detector *d, struct ws_splitter *sp,
+               int block_samples, struct ws_plan *plan);
+void index_close(struct ws_index *ix);
+
+#endif
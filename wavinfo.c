@@ -37,36 +37,123 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "wavheader.h"
+#include "wavinput.h"
+#include "wavsum.h"
+#include "wavjson.h"
 
 int fd;
 int length;
 int verify;
 int info;
 int quiet;
+int checksum;	// -c, SUM_CRC32C or SUM_XXH64; 0 if off
+int output;	// -f, OUTPUT_JSON or OUTPUT_CSV for a record per file
+int workers;	// -w
+char *list_file;	// -F
 
-#define BLOCK_SIZE 128
+// Read (or mapped) at a time
+#define BLOCK_SIZE (1024 * 1024)
 
-int measure_size(struct wav_file_headers* h) {
+// Progress is redrawn this often, in ms
+#define PROGRESS_INTERVAL 250
 
-  // Read the rest of the file, counting bytes
+#define OUTPUT_JSON 1
+#define OUTPUT_CSV  2
 
-  int count = 0;
-  int total = 0;
-  char buffer[BLOCK_SIZE];
-  int percent;
+// Bytes read from the start of each file in batch mode; headers that go on
+// further are read chunk by chunk
+#define HEADER_READ 4096
+
+#define MAX_WORKERS 256
+
+#define FILEN_LENGTH 1024
+
+// What batch mode finds out about one file
+struct info_record {
+
+  const char *path;
+  const char *error;        // NULL if the headers were read
+  struct wav_file_headers h;
+  unsigned long long data_offset;
+  long long file_size;
+  unsigned long long sum;
+  int done;
+
+};
+
+struct info_batch {
+
+  char **paths;
+  int count;
+  struct info_record *records;
+
+  pthread_mutex_t lock;
+  int next;                 // Next file to look at
+  int printed;              // Records are printed in order
+  int failed;
+
+};
+
+long long now_ms() {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+long long measure_size(int in_fd, struct ws_header_buffer* rest,
+		       struct wav_file_headers* h, struct ws_sum* sum,
+		       int quiet) {
+
+  // Read the rest of the file, counting bytes, from what was read with the
+  // headers on.  The first data_size of them are the data chunk, which is
+  // what gets checksummed.
+
+  ssize_t count;
+  long long total = 0;
+  long long last = 0, t;
+  unsigned char *block;
+  struct ws_input input;
+
+  if(!input_open(&input, in_fd, BLOCK_SIZE, INPUT_MAP,
+		 rest ? rest->data + rest->start : NULL,
+		 rest ? rest->end - rest->start : 0))
+    return -1;
+
+  for(;;) {
+    count = input_next(&input, BLOCK_SIZE, &block);
+    if(count <= 0)
+      break;
+
+    if(sum && (total < h->data_size))
+      sum_update(sum, block, (total + count <= h->data_size) ?
+		 count : h->data_size - total);
 
-  do {
-    count = read(fd, buffer, BLOCK_SIZE);
     total += count;
-    if(!quiet)
-      printf("Processing file: %.0f%% (%i KB)\r", 
-	     (total / (double)h->data.size) * 100,
+
+    if(!quiet && ((t = now_ms()) - last >= PROGRESS_INTERVAL)) {
+      printf("Processing file: %.0f%% (%lli KB)\r",
+	     (total / (double)h->data_size) * 100,
 	     total / 1024);
-  } while(count == BLOCK_SIZE);
+      fflush(stdout);
+      last = t;
+    }
+  }
+
+  input_close(&input);
+
+  if(count == -1)
+    return -1;
 
-  printf("                                           \r");
+  if(!quiet)
+    printf("                                           \r");
 
   return total;
 
@@ -74,10 +161,10 @@ int measure_size(struct wav_file_headers* h) {
 
 double calc_length(struct wav_file_headers* h) {
 
-  int data_size;
-  int num_samples;
+  long long data_size;
+  long long num_samples;
 
-  data_size = h->data.size;
+  data_size = h->data_size;
   num_samples = data_size / ((h->fmt.NumChannels) * (h->fmt.BitsPerSample / 8));
  
   return (double)num_samples / h->fmt.SampleRate;
@@ -85,14 +172,281 @@ double calc_length(struct wav_file_headers* h) {
 
 }
 
+// Where a file whose samples start at data_offset should end: with its
+// RIFF chunk, which may hold more chunks (LIST, id3) after the data.  If
+// the RIFF size can't be right, or it isn't known, right after the data
+// and its pad byte.
+unsigned long long expected_end(struct wav_file_headers* h,
+				unsigned long long data_offset) {
+
+  unsigned long long data_end, riff_end = 0;
+
+  data_end = data_offset + h->data_size + h->data_size % 2;
+
+  if(h->riff.header.id != RF64_CHUNK_ID)
+    riff_end = 8ULL + h->riff.header.size;
+  else if(h->ds64.header.id == DS64_CHUNK_ID)
+    riff_end = 8ULL + h->ds64.riff_size;
+
+  return (riff_end < data_end) ? data_end : riff_end;
+}
+
+// Names with a comma or a quote in them are quoted
+static void csv_string(FILE *fp, const char *str) {
+
+  if(!strpbrk(str, ",\"\n")) {
+    fputs(str, fp);
+    return;
+  }
+
+  fputc('"', fp);
+  for(; *str; str++) {
+    if(*str == '"')
+      fputc('"', fp);
+    fputc(*str, fp);
+  }
+  fputc('"', fp);
+
+}
+
+// Reads the headers of one file with a single pread() of its start (or, if
+// they are longer than that, as a single file is read), and fstat()s it
+void info_file(struct info_record *r) {
+
+  unsigned char buffer[HEADER_READ];
+  struct stat st;
+  struct ws_sum sum;
+  ssize_t got;
+  int in_fd, ret;
+
+  in_fd = open(r->path, O_RDONLY);
+  if(in_fd == -1) {
+    r->error = strerror(errno);
+    return;
+  }
+
+  if(fstat(in_fd, &st) == 0)
+    r->file_size = st.st_size;
+
+  got = pread(in_fd, buffer, sizeof(buffer), 0);
+  if(got == -1) {
+    r->error = strerror(errno);
+    close(in_fd);
+    return;
+  }
+
+  ret = parse_headers(buffer, got, &r->h, &r->data_offset);
+
+  // Long chunks before the data: walk them from the file
+  if((ret == HEADERS_SHORT) && (got == sizeof(buffer))) {
+    if(process_headers(in_fd, &r->h)) {
+      ret = HEADERS_OK;
+      r->data_offset = lseek(in_fd, 0, SEEK_CUR);
+    }
+  }
+
+  if(ret != HEADERS_OK)
+    r->error = headers_error(ret);
+  else if((r->h.fmt.NumChannels <= 0) || (r->h.fmt.BitsPerSample < 8) ||
+	  (r->h.fmt.SampleRate == 0))
+    r->error = "bad format chunk";
+  else if(checksum) {
+    sum_init(&sum, checksum);
+    if((lseek(in_fd, r->data_offset, SEEK_SET) == -1) ||
+       (measure_size(in_fd, NULL, &r->h, &sum, 1) == -1))
+      r->error = "read error";
+    else
+      r->sum = sum_final(&sum);
+  }
+
+  close(in_fd);
+
+}
+
+void print_record(struct info_record *r) {
+
+  unsigned long long end;
+  const char *status;
+
+  if(r->error)
+    status = "error";
+  else {
+    end = expected_end(&r->h, r->data_offset);
+    status = (r->file_size < end) ? "truncated" :
+      (r->file_size > end) ? "too_long" : "ok";
+  }
+
+  if(output == OUTPUT_JSON) {
+    printf("{\"file\": ");
+    json_string(stdout, r->path);
+    printf(", \"status\": \"%s\"", status);
+    if(r->error) {
+      printf(", \"error\": ");
+      json_string(stdout, r->error);
+      printf("}\n");
+      return;
+    }
+    printf(", \"format\": %i, \"channels\": %i, \"sample_rate\": %u, "
+	   "\"bits\": %i, \"rf64\": %s, \"data_offset\": %llu, "
+	   "\"data_bytes\": %llu, \"file_bytes\": %lld, \"seconds\": %.6f",
+	   r->h.fmt.AudioFormat, r->h.fmt.NumChannels, r->h.fmt.SampleRate,
+	   r->h.fmt.BitsPerSample,
+	   (r->h.riff.header.id == RF64_CHUNK_ID) ? "true" : "false",
+	   r->data_offset, r->h.data_size, r->file_size, calc_length(&r->h));
+    if(checksum)
+      printf(", \"%s\": \"%0*llx\"", (checksum == SUM_CRC32C) ? "crc32c"
+	     : "xxh64", (checksum == SUM_CRC32C) ? 8 : 16, r->sum);
+    printf("}\n");
+    return;
+  }
+
+  csv_string(stdout, r->path);
+  printf(",%s", status);
+  if(r->error)
+    printf(",,,,,,,,,%s", checksum ? "," : "");
+  else {
+    printf(",%i,%i,%u,%i,%i,%llu,%llu,%lld,%.6f",
+	   r->h.fmt.AudioFormat, r->h.fmt.NumChannels, r->h.fmt.SampleRate,
+	   r->h.fmt.BitsPerSample, r->h.riff.header.id == RF64_CHUNK_ID,
+	   r->data_offset, r->h.data_size, r->file_size, calc_length(&r->h));
+    if(checksum)
+      printf(",%0*llx", (checksum == SUM_CRC32C) ? 8 : 16, r->sum);
+  }
+  printf(",");
+  if(r->error)
+    csv_string(stdout, r->error);
+  printf("\n");
+
+}
+
+void *info_worker(void *arg) {
+
+  struct info_batch *b = arg;
+  int n;
+
+  for(;;) {
+    pthread_mutex_lock(&b->lock);
+    n = b->next++;
+    pthread_mutex_unlock(&b->lock);
+
+    if(n >= b->count)
+      return NULL;
+
+    b->records[n].path = b->paths[n];
+    info_file(&b->records[n]);
+
+    // Whoever finishes the next record to print prints all that are done
+    pthread_mutex_lock(&b->lock);
+    b->records[n].done = 1;
+    if(b->records[n].error)
+      b->failed++;
+    while((b->printed < b->count) && b->records[b->printed].done)
+      print_record(&b->records[b->printed++]);
+    pthread_mutex_unlock(&b->lock);
+  }
+}
+
+// Reads the file names from -F, one per line
+int read_list(const char* list, char*** paths, int* count) {
+
+  char line[FILEN_LENGTH];
+  char **names;
+  int size = *count;
+  FILE *fp;
+  int len;
+
+  fp = strcmp(list, "-") ? fopen(list, "r") : stdin;
+  if(fp == NULL) {
+    perror(list);
+    return 0;
+  }
+
+  while(fgets(line, sizeof(line), fp)) {
+    len = strlen(line);
+    while((len > 0) && ((line[len-1] == '\n') || (line[len-1] == '\r')))
+      line[--len] = '\0';
+    if(len == 0)
+      continue;
+
+    if(*count == size) {
+      size = size ? size * 2 : 64;
+      names = realloc(*paths, size * sizeof(*names));
+      if(names == NULL) {
+	fprintf(stderr, "Could not allocate the file list\n");
+	return 0;
+      }
+      *paths = names;
+    }
+    (*paths)[(*count)++] = strdup(line);
+  }
+
+  if(fp != stdin)
+    fclose(fp);
+
+  return 1;
+}
+
+// A record for every file, looked at by a pool of threads
+int run_batch(char** args, int nargs) {
+
+  struct info_batch b;
+  pthread_t threads[MAX_WORKERS];
+  int n, i;
+
+  memset(&b, 0, sizeof(b));
+  pthread_mutex_init(&b.lock, NULL);
+
+  b.paths = malloc((nargs ? nargs : 1) * sizeof(*b.paths));
+  for(i = 0; i < nargs; i++)
+    b.paths[b.count++] = args[i];
+
+  if(list_file && !read_list(list_file, &b.paths, &b.count))
+    return 1;
+
+  b.records = calloc(b.count ? b.count : 1, sizeof(*b.records));
+  if((b.paths == NULL) || (b.records == NULL)) {
+    fprintf(stderr, "Could not allocate %i records\n", b.count);
+    return 1;
+  }
+
+  if(output == OUTPUT_CSV)
+    printf("file,status,format,channels,sample_rate,bits,rf64,data_offset,"
+	   "data_bytes,file_bytes,seconds%s,error\n",
+	   !checksum ? "" : (checksum == SUM_CRC32C) ? ",crc32c" : ",xxh64");
+
+  n = (workers < b.count) ? workers : b.count;
+  for(i = 0; i < n; i++)
+    if(pthread_create(&threads[i], NULL, info_worker, &b) != 0) {
+      fprintf(stderr, "Could not start worker %i\n", i);
+      n = i;
+      break;
+    }
+
+  // With no worker at all, do it here
+  if(n == 0)
+    info_worker(&b);
+
+  for(i = 0; i < n; i++)
+    pthread_join(threads[i], NULL);
+
+  return b.failed ? 1 : 0;
+}
+
 void print_usage() {
 
   printf("usage: wavinfo <options> file\n");
+  printf("       wavinfo -f json|csv <options> file ...\n");
   printf("Options:\n");
   printf("  -v     Verify File\n");
   printf("  -q     Do not show verification progress\n");
+  printf("  -c <sum> Verify, and checksum the data chunk in the same pass\n");
+  printf("         (crc32c or xxh64)\n");
   printf("  -i     Show file info\n");
   printf("  -l     Display file length (in seconds)\n");
+  printf("  -f <fmt> Print a json or csv record for each file (the default\n");
+  printf("         with several files)\n");
+  printf("  -F <file> Also look at every file listed in <file> ('-' for stdin)\n");
+  printf("  -w <num> Look at <num> files at once (default: one per CPU)\n");
   printf("  -h     Show this message\n");
 
   printf("\n");
@@ -102,7 +456,7 @@ void process_args(int argc, char**argv) {
 
   int c;
 
-  while((c = getopt(argc, argv, "Vhlviq")) != -1) {
+  while((c = getopt(argc, argv, "Vhlviqc:f:F:w:")) != -1) {
     switch(c) {
     case 'h':
       print_usage();
@@ -123,6 +477,34 @@ void process_args(int argc, char**argv) {
     case 'q':
       quiet = 1;
       break;
+    case 'c':
+      checksum = sum_type(optarg);
+      if(!checksum) {
+	printf("Invalid checksum (crc32c or xxh64)!\n");
+	exit(1);
+      }
+      verify = 1;
+      break;
+    case 'f':
+      if(!strcmp(optarg, "json"))
+	output = OUTPUT_JSON;
+      else if(!strcmp(optarg, "csv"))
+	output = OUTPUT_CSV;
+      else {
+	printf("Invalid record format (json or csv)!\n");
+	exit(1);
+      }
+      break;
+    case 'F':
+      list_file = optarg;
+      break;
+    case 'w':
+      workers = atoi(optarg);
+      if((workers < 1) || (workers > MAX_WORKERS)) {
+	printf("Invalid number of workers!\n");
+	exit(1);
+      }
+      break;
 
     default:
       exit(1);
@@ -136,10 +518,16 @@ void process_args(int argc, char**argv) {
 int main(int argc, char**argv) {
 
   struct wav_file_headers h;
+  static struct ws_header_buffer header_buffer;
+  struct ws_sum sum;
   int c;
-  int size;
+  long long size, expected;
 
-  length = info = verify = quiet = 0;
+  length = info = verify = quiet = checksum = output = 0;
+  list_file = NULL;
+  workers = sysconf(_SC_NPROCESSORS_ONLN);
+  if((workers < 1) || (workers > MAX_WORKERS))
+    workers = (workers < 1) ? 1 : MAX_WORKERS;
 
   if (argc < 2) {
      print_usage();
@@ -148,6 +536,18 @@ int main(int argc, char**argv) {
 
   process_args(argc, argv);
 
+  // Several files: a record for each
+  if((argc - optind > 1) || list_file || output) {
+    if(!output)
+      output = OUTPUT_JSON;
+    return run_batch(argv + optind, argc - optind);
+  }
+
+  if (optind >= argc) {
+     print_usage();
+     return 1;
+  }
+
   fd = open(argv[argc-1], O_RDONLY);
 
   if (fd==-1) {
@@ -155,13 +555,15 @@ int main(int argc, char**argv) {
      return 1;
   }
 
-  if (!process_headers(fd, &h)) {
+  if (!read_headers(fd, &h, &header_buffer)) {
      close(fd);
      return 1;
   }
 
   if(info) {
     print_riff_info(&h.riff);
+    if(h.riff.header.id == RF64_CHUNK_ID)
+      print_ds64_info(&h.ds64);
     print_format_info(&h.fmt);
     print_data_info(&h.data);
     printf("\nTotal Length: %.2f seconds\n", calc_length(&h));
@@ -171,13 +573,23 @@ int main(int argc, char**argv) {
   }
 
   if(verify) {
-    size = measure_size(&h);
-    if(size < h.data.size)
-      printf("File is truncated (%i / %i bytes)\n", size, h.data.size);
-    else if (size > h.data.size)
-      printf("File is too long (%i / %i bytes)\n", size, h.data.size);
+    if(checksum)
+      sum_init(&sum, checksum);
+    size = measure_size(fd, &header_buffer, &h, checksum ? &sum : NULL,
+			quiet);
+    if(size == -1)
+      return 1;
+    // What follows the first sample: the data, and any chunks after it
+    expected = expected_end(&h, header_buffer.pos) - header_buffer.pos;
+    if(size < expected)
+      printf("File is truncated (%lli / %lli bytes)\n", size, expected);
+    else if (size > expected)
+      printf("File is too long (%lli / %lli bytes)\n", size, expected);
     else
-      printf("File is OK (%i bytes)\n", size);
+      printf("File is OK (%lli bytes)\n", size);
+    if(checksum)
+      printf("Data %s: %0*llx\n", sum.name,
+	     (checksum == SUM_CRC32C) ? 8 : 16, sum_final(&sum));
   }
 
   if((length == 0) && (info == 0) && (verify == 0)) {
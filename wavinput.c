@@ -0,0 +1,357 @@
+/*  wavinput.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Input for process_data().
+
+    Blocks are handed out as pointers.  For a regular file the pointer is
+    into a read-only mapping of the file, so the detector looks at the page
+    cache directly and pieces are written from it without a copy.  Only one
+    window of the file is mapped at a time; when a block runs past the end of
+    the window, the window is unmapped and the next one mapped at the block,
+    so files larger than the address space (or 4 GB) work too.
+
+    Anything else (stdin, pipes, or a file that won't map) is read() into a
+    buffer, a full block at a time.  When wavsilence is built with io_uring
+    and the kernel allows it, that input is instead read ahead in big chunks
+    of whole blocks, several at once for a seekable file, while the detector
+    works through the chunk before.
+
+    Samples that were read along with the headers (from a pipe, which can't
+    seek back to them) are handed to input_open() and come out first.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "wavinput.h"
+
+static int map_window(struct ws_input *in, size_t size) {
+
+  long page = sysconf(_SC_PAGESIZE);
+  void *map;
+
+  if(in->map)
+    munmap(in->map, in->map_len);
+  in->map = NULL;
+
+  in->map_start = in->pos - (in->pos % page);
+  in->map_len = in->window;
+  if(in->map_start + (off_t)in->map_len > in->end)
+    in->map_len = in->end - in->map_start;
+
+  map = mmap(NULL, in->map_len, PROT_READ, MAP_SHARED, in->fd, in->map_start);
+
+  if(map == MAP_FAILED) {
+    fprintf(stderr,
+            "input: Could not map %lu bytes at offset %lld. Error = %d.\n",
+            (unsigned long)in->map_len,
+            (long long)in->map_start,
+            errno);
+    return 0;
+  }
+
+  madvise(map, in->map_len, MADV_SEQUENTIAL);
+
+  in->map = map;
+
+  return 1;
+}
+
+static int queue_read(struct ws_input *in, int i) {
+
+  off_t offset = in->seekable ? in->offsets[i] + in->got[i] : -1;
+
+  in->reading[i] = 1;
+
+  return uring_queue(in->ring, URING_READ, in->fd, in->chunks[i] + in->got[i],
+                     in->chunk_size - in->got[i], offset, i, 0);
+}
+
+// Starts reading the next chunk of the input into chunks[i]
+static void start_chunk(struct ws_input *in, int i) {
+
+  in->got[i] = 0;
+
+  if(in->eof) {
+    in->reading[i] = 0;
+    return;
+  }
+
+  // The prefix goes at the front of the first chunk
+  if(in->prefix_size > 0) {
+    memcpy(in->chunks[i], in->prefix, in->prefix_size);
+    in->got[i] = in->prefix_size;
+    in->prefix_size = 0;
+  }
+
+  in->offsets[i] = in->next - in->got[i];
+  in->next += in->chunk_size - in->got[i];
+
+  // Never more than URING_BUFFERS reads in flight, so this can't fail
+  queue_read(in, i);
+
+}
+
+static int uring_open(struct ws_input *in, size_t block_size) {
+
+  struct stat st;
+  int i;
+
+  in->chunk_size = (URING_BUFFER_SIZE / block_size) * block_size;
+  if(in->chunk_size == 0)
+    in->chunk_size = block_size;
+
+  if(in->prefix_size >= in->chunk_size)
+    return 0;
+
+  in->ring = malloc(sizeof(*in->ring));
+  if((in->ring == NULL) || !uring_init(in->ring, URING_ENTRIES)) {
+    free(in->ring);
+    in->ring = NULL;
+    return 0;
+  }
+
+  in->next = lseek(in->fd, 0, SEEK_CUR);
+  in->seekable = (in->next != -1) && (fstat(in->fd, &st) == 0) &&
+                 S_ISREG(st.st_mode);
+
+  // Reads from a pipe have to complete in order, so keep one in flight
+  in->depth = in->seekable ? URING_BUFFERS : 1;
+
+  for(i = 0; i < in->depth; i++) {
+    in->chunks[i] = malloc(in->chunk_size);
+    if(in->chunks[i] == NULL) {
+      input_close(in);
+      return 0;
+    }
+  }
+
+  for(i = 0; i < in->depth; i++)
+    start_chunk(in, i);
+
+  return uring_submit(in->ring);
+}
+
+static ssize_t uring_next(struct ws_input *in, size_t size,
+                          unsigned char **block) {
+
+  unsigned long long data;
+  int res, i;
+
+  for(;;) {
+
+    while(in->reading[in->cur]) {
+
+      if(!uring_submit(in->ring) || !uring_reap(in->ring, &data, &res, 1))
+        return -1;
+
+      i = data;
+
+      if((res == -EINTR) || (res == -EAGAIN)) {
+        queue_read(in, i);
+        continue;
+      }
+
+      if(res < 0) {
+        fprintf(stderr, "input: Read error. Error = %d.\n", -res);
+        return -1;
+      }
+
+      in->got[i] += res;
+
+      if(res == 0)
+        in->eof = 1;
+
+      // Pipes hand out whatever is there, so keep reading until it's full
+      if((res == 0) || (in->got[i] == in->chunk_size))
+        in->reading[i] = 0;
+      else
+        queue_read(in, i);
+    }
+
+    i = in->cur;
+
+    if(in->cur_pos < in->got[i]) {
+      if(size > in->got[i] - in->cur_pos)
+        size = in->got[i] - in->cur_pos;
+      *block = in->chunks[i] + in->cur_pos;
+      in->cur_pos += size;
+      return size;
+    }
+
+    // Only the last chunk is short
+    if(in->got[i] < in->chunk_size)
+      return 0;
+
+    start_chunk(in, i);
+    in->cur = (i + 1) % in->depth;
+    in->cur_pos = 0;
+  }
+}
+
+// Sets up in to read blocks of up to block_size bytes from the current
+// position of fd, after the prefix_size bytes at prefix (which must stay
+// valid until they're read).  With INPUT_MAP, a regular file is mapped;
+// otherwise it is read() into a buffer, or read ahead with io_uring unless
+// INPUT_NO_AHEAD asks for nothing to be read before it is needed.
+int input_open(struct ws_input *in, int fd, size_t block_size, int flags,
+               const unsigned char *prefix, size_t prefix_size) {
+
+  struct stat st;
+  long page = sysconf(_SC_PAGESIZE);
+
+  memset(in, 0, sizeof(*in));
+  in->fd = fd;
+  in->prefix = prefix;
+  in->prefix_size = prefix_size;
+
+  if((flags & INPUT_MAP) && (prefix_size == 0) && (fstat(fd, &st) == 0) && S_ISREG(st.st_mode)) {
+
+    in->pos = lseek(fd, 0, SEEK_CUR);
+    in->end = st.st_size;
+
+    // A window always has room for a whole block, wherever it starts
+    in->window = MAP_WINDOW;
+    if(in->window < block_size + page)
+      in->window = (block_size / page + 2) * page;
+
+    if(in->pos != -1) {
+      in->mapped = 1;
+      return 1;
+    }
+  }
+
+  if(!(flags & INPUT_NO_AHEAD) && uring_open(in, block_size))
+    return 1;
+
+  in->buffer_size = block_size;
+  in->buffer = malloc(block_size);
+
+  if(in->buffer == NULL) {
+    fprintf(stderr, "input: Could not allocate %lu bytes\n",
+            (unsigned long)block_size);
+    return 0;
+  }
+
+  return 1;
+}
+
+// Points *block at the next size bytes of input.  Returns the number of bytes
+// available, which is less than size only at the end of the input (0 at the
+// end), or -1 on error.  The block stays valid until the next call.
+ssize_t input_next(struct ws_input *in, size_t size, unsigned char **block) {
+
+  ssize_t count, total;
+
+  if(in->mapped) {
+
+    if(in->pos >= in->end)
+      return 0;
+
+    if((off_t)size > in->end - in->pos)
+      size = in->end - in->pos;
+
+    if((in->map == NULL) ||
+       (in->pos + (off_t)size > in->map_start + (off_t)in->map_len))
+      if(!map_window(in, size))
+        return -1;
+
+    *block = in->map + (in->pos - in->map_start);
+    in->pos += size;
+
+    return size;
+  }
+
+  if(in->ring)
+    return uring_next(in, size, block);
+
+  if(size > in->buffer_size)
+    size = in->buffer_size;
+
+  total = 0;
+
+  if(in->prefix_size > 0) {
+    total = size < in->prefix_size ? size : in->prefix_size;
+    memcpy(in->buffer, in->prefix, total);
+    in->prefix += total;
+    in->prefix_size -= total;
+  }
+
+  // Pipes hand out whatever is there, so keep reading until the block is full
+  while(total < (ssize_t)size) {
+    count = read(in->fd, in->buffer + total, size - total);
+    if(count == -1) {
+      if(errno == EINTR)
+        continue;
+      fprintf(stderr, "input: Read error. Error = %d.\n", errno);
+      return -1;
+    }
+    if(count == 0)
+      break;
+    total += count;
+  }
+
+  *block = in->buffer;
+
+  return total;
+}
+
+void input_close(struct ws_input *in) {
+
+  unsigned long long data;
+  int res, i;
+
+  if(in->ring) {
+    // Reads past the end may still be in flight
+    uring_submit(in->ring);
+    while(uring_reap(in->ring, &data, &res, 1))
+      ;
+    uring_exit(in->ring);
+    free(in->ring);
+    in->ring = NULL;
+  }
+
+  for(i = 0; i < URING_BUFFERS; i++) {
+    free(in->chunks[i]);
+    in->chunks[i] = NULL;
+  }
+
+  if(in->map)
+    munmap(in->map, in->map_len);
+  in->map = NULL;
+
+  free(in->buffer);
+  in->buffer = NULL;
+
+}
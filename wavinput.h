@@ -0,0 +1,87 @@
+/*  wavinput.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_INPUT_H
+#define WAV_INPUT_H
+
+#include <sys/types.h>
+
+#include "wavuring.h"
+
+// Size of the part of the input that is mapped at any one time
+#define MAP_WINDOW      (64 * 1024 * 1024)
+
+// input_open() flags
+#define INPUT_MAP       1   // Map a regular file
+#define INPUT_NO_AHEAD  2   // Read each block only when it is asked for
+
+struct ws_input {
+
+  int fd;
+  int mapped;              // Non-zero if blocks come straight from a mapping
+
+  const unsigned char *prefix;  // Input read before we were opened
+  size_t prefix_size;
+
+  // mmap() mode
+  off_t pos;               // File offset of the next block
+  off_t end;               // File size
+  unsigned char *map;      // Current window
+  off_t map_start;         // File offset of the window
+  size_t map_len;
+  size_t window;           // Largest window we map
+
+  // read() mode
+  unsigned char *buffer;
+  size_t buffer_size;
+
+  // io_uring mode: URING_BUFFERS chunks of whole blocks are read ahead
+  struct ws_uring *ring;
+  unsigned char *chunks[URING_BUFFERS];
+  size_t chunk_size;
+  off_t offsets[URING_BUFFERS];
+  size_t got[URING_BUFFERS];
+  int reading[URING_BUFFERS];
+  int depth;               // Chunks in use; 1 for pipes
+  int seekable;
+  off_t next;              // File offset of the next chunk to read
+  int eof;
+  int cur;
+  size_t cur_pos;
+
+};
+
+// Functions
+
+int input_open(struct ws_input *in, int fd, size_t block_size, int flags,
+               const unsigned char *prefix, size_t prefix_size);
+
+ssize_t input_next(struct ws_input *in, size_t size, unsigned char **block);
+
+void input_close(struct ws_input *in);
+
+#endif
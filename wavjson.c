@@ -0,0 +1,53 @@
+/*  wavjson.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    What the JSON writers (-T, -A, -Z and wavinfo -f json) have in common.
+*/
+
+
+#include <stdio.h>
+
+#include "wavjson.h"
+
+// Writes str as a quoted JSON string
+void json_string(FILE *fp, const char *str) {
+
+  fputc('"', fp);
+
+  for(; *str; str++) {
+    if((*str == '"') || (*str == '\\'))
+      fprintf(fp, "\\%c", *str);
+    else if((unsigned char)*str < 0x20)
+      fprintf(fp, "\\u%04x", *str);
+    else
+      fputc(*str, fp);
+  }
+
+  fputc('"', fp);
+
+}
@@ -0,0 +1,136 @@
+/*  wavlive.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    Live mode (-Z).
+
+    For a capture that doesn't end, such as a radio stream piped in from
+    arecord: each piece is announced as it starts, and again once it is
+    closed, complete with its header, as a line of JSON on stdout or in a
+    file (a FIFO, usually).  The stream is line buffered, so a program
+    reading it hears of a piece as soon as wavsilence knows of it:
+
+      {"event":"start","piece":3,"file":"piece-003.wav","time":61.250}
+      {"event":"end","piece":3,"file":"piece-003.wav","time":61.250,
+       "length":240.000,"bytes":42336000,"cut":"max_length"}
+
+    (each on one line).  The times are in seconds of input; a piece ends at
+    a gap ("silence"), when -H cuts it ("max_length"), or with the input
+    ("end").
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavlive.h"
+#include "wavjson.h"
+
+static const char *cuts[] = { "silence", "max_length", "end" };
+
+// Events go to path, or to stdout if it is "-".  Opening a FIFO waits for
+// its reader.
+int live_open(struct ws_live *l, const char *path, unsigned int rate) {
+
+  memset(l, 0, sizeof(*l));
+  l->rate = rate;
+  l->piece = -1;
+
+  if(strcmp(path, "-") == 0)
+    l->fp = stdout;
+  else {
+    l->fp = fopen(path, "w");
+    if(l->fp == NULL) {
+      perror(path);
+      return 0;
+    }
+    l->own = 1;
+  }
+
+  setvbuf(l->fp, NULL, _IOLBF, 0);
+
+  return 1;
+}
+
+static void event(struct ws_live *l, const char *type) {
+
+  fprintf(l->fp, "{\"event\":\"%s\",\"piece\":%i,\"file\":", type, l->piece);
+  json_string(l->fp, l->name);
+  fprintf(l->fp, ",\"time\":%.3f", (double)l->start / l->rate);
+
+}
+
+void live_start(struct ws_live *l, int piece, const char *name,
+                long long start) {
+
+  free(l->name);
+  l->name = strdup(name ? name : "");
+  l->piece = piece;
+  l->start = start;
+  l->frames = 0;
+  l->bytes = 0;
+  l->cut = LIVE_SILENCE;
+
+  event(l, "start");
+  fprintf(l->fp, "}\n");
+
+}
+
+// What is known of the open piece once it has ended; live_end() reports
+// it when it is closed
+void live_done(struct ws_live *l, long long frames, unsigned long long bytes) {
+
+  l->frames = frames;
+  l->bytes = bytes;
+
+}
+
+void live_end(struct ws_live *l) {
+
+  if(l->piece < 0)
+    return;
+
+  event(l, "end");
+  fprintf(l->fp, ",\"length\":%.3f,\"bytes\":%llu,\"cut\":\"%s\"}\n",
+          (double)l->frames / l->rate, l->bytes, cuts[l->cut]);
+
+  l->piece = -1;
+
+}
+
+void live_close(struct ws_live *l) {
+
+  if(l->own)
+    fclose(l->fp);
+  else
+    fflush(l->fp);
+
+  free(l->name);
+  l->name = NULL;
+
+}
@@ -0,0 +1,63 @@
+/*  wavlive.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_LIVE_H
+#define WAV_LIVE_H
+
+#include <stdio.h>
+
+// Why a piece ended
+#define LIVE_SILENCE    0   // A gap
+#define LIVE_MAX_LENGTH 1   // -H
+#define LIVE_END        2   // The end of the input
+
+struct ws_live {
+
+  FILE *fp;
+  int own;                  // fp was opened here (not stdout)
+  unsigned int rate;
+
+  // The open piece
+  int piece;
+  char *name;
+  long long start;          // First frame
+  long long frames;         // Set once it has ended
+  unsigned long long bytes;
+  int cut;
+
+};
+
+// Functions
+
+int live_open(struct ws_live *l, const char *path, unsigned int rate);
+void live_start(struct ws_live *l, int piece, const char *name,
+                long long start);
+void live_done(struct ws_live *l, long long frames, unsigned long long bytes);
+void live_end(struct ws_live *l);
+void live_close(struct ws_live *l);
+
+#endif
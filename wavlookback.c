@@ -0,0 +1,119 @@
+/*  wavlookback.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Lookback ring for pre-roll (-a).  The ring never grows: it is sized
+    once for the pre-roll and the gap, and the caller makes room by
+    writing or dropping the oldest frames before it pushes more.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavlookback.h"
+
+int lookback_init(struct ws_lookback *lb, long long frames, int frame_size) {
+
+  memset(lb, 0, sizeof(*lb));
+
+  lb->frame_size = frame_size;
+  lb->size = frames * frame_size;
+  lb->buffer = malloc(lb->size);
+
+  if(lb->buffer == NULL) {
+    fprintf(stderr, "lookback: Could not allocate %lli frames\n", frames);
+    return 0;
+  }
+
+  return 1;
+}
+
+void lookback_free(struct ws_lookback *lb) {
+
+  free(lb->buffer);
+  lb->buffer = NULL;
+
+}
+
+long long lookback_frames(struct ws_lookback *lb) {
+
+  return lb->used / lb->frame_size;
+}
+
+long long lookback_room(struct ws_lookback *lb) {
+
+  return (lb->size - lb->used) / lb->frame_size;
+}
+
+// The oldest frames, which may wrap around the end of the ring.  Returns the
+// number of parts (0, 1 or 2).
+int lookback_peek(struct ws_lookback *lb, long long frames,
+                  unsigned char **first, size_t *first_size,
+                  unsigned char **second, size_t *second_size) {
+
+  size_t bytes = frames * lb->frame_size;
+
+  if(bytes > lb->used)
+    bytes = lb->used;
+
+  *first = lb->buffer + lb->start;
+  *first_size = (lb->start + bytes <= lb->size) ? bytes : lb->size - lb->start;
+  *second = lb->buffer;
+  *second_size = bytes - *first_size;
+
+  return (*first_size > 0) + (*second_size > 0);
+}
+
+void lookback_drop(struct ws_lookback *lb, long long frames) {
+
+  size_t bytes = frames * lb->frame_size;
+
+  if(bytes > lb->used)
+    bytes = lb->used;
+
+  lb->start = (lb->start + bytes) % lb->size;
+  lb->used -= bytes;
+
+  if(lb->used == 0)
+    lb->start = 0;
+
+}
+
+// There must be room for frames
+void lookback_push(struct ws_lookback *lb, const unsigned char *data,
+                   long long frames) {
+
+  size_t bytes = frames * lb->frame_size;
+  size_t end = (lb->start + lb->used) % lb->size;
+  size_t part = (end + bytes <= lb->size) ? bytes : lb->size - end;
+
+  memcpy(lb->buffer + end, data, part);
+  memcpy(lb->buffer, data + part, bytes - part);
+  lb->used += bytes;
+
+}
@@ -0,0 +1,60 @@
+/*  wavlookback.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_LOOKBACK_H
+#define WAV_LOOKBACK_H
+
+#include <stddef.h>
+
+// The last frames of the input that haven't been written or dropped yet,
+// in a fixed ring
+struct ws_lookback {
+
+  unsigned char *buffer;
+  size_t size;              // Bytes, a whole number of frames
+  size_t start;             // Offset of the oldest frame
+  size_t used;
+  int frame_size;
+
+};
+
+// Functions
+
+int lookback_init(struct ws_lookback *lb, long long frames, int frame_size);
+void lookback_free(struct ws_lookback *lb);
+
+long long lookback_frames(struct ws_lookback *lb);
+long long lookback_room(struct ws_lookback *lb);
+
+int lookback_peek(struct ws_lookback *lb, long long frames,
+                  unsigned char **first, size_t *first_size,
+                  unsigned char **second, size_t *second_size);
+void lookback_drop(struct ws_lookback *lb, long long frames);
+void lookback_push(struct ws_lookback *lb, const unsigned char *data,
+                   long long frames);
+
+#endif
@@ -0,0 +1,256 @@
+/*  wavmanifest.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    Segment manifests (-A).
+
+    Instead of writing the pieces, the split points are collected here and
+    written as JSON, CSV or a CUE sheet, picked by the file's extension.
+    Offsets are in bytes from the first sample of the data chunk; add
+    data_offset (the file offset of that sample, when the input could be
+    seeked) to read a piece straight out of the input.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "wavmanifest.h"
+#include "wavjson.h"
+
+// Returns MANIFEST_JSON, MANIFEST_CSV or MANIFEST_CUE, or 0 if the
+// extension is none of them
+int manifest_format(const char *path) {
+
+  const char *dot = strrchr(path, '.');
+
+  if(dot == NULL)
+    return 0;
+
+  if(!strcasecmp(dot, ".json"))
+    return MANIFEST_JSON;
+  if(!strcasecmp(dot, ".csv"))
+    return MANIFEST_CSV;
+  if(!strcasecmp(dot, ".cue"))
+    return MANIFEST_CUE;
+
+  return 0;
+}
+
+void manifest_init(struct ws_manifest *m, unsigned int rate, int channels,
+                   int bits, long long data_offset) {
+
+  memset(m, 0, sizeof(*m));
+
+  m->rate = rate;
+  m->channels = channels;
+  m->bits = bits;
+  m->frame_size = channels * (bits / 8);
+  m->data_offset = data_offset;
+
+}
+
+struct ws_segment *manifest_add(struct ws_manifest *m, const char *name) {
+
+  struct ws_segment *s;
+
+  if(m->count == m->size) {
+    m->size = m->size ? m->size * 2 : 64;
+    s = realloc(m->segments, m->size * sizeof(*s));
+    if(s == NULL) {
+      fprintf(stderr, "manifest: Out of memory (%i pieces)\n", m->count);
+      exit(1);
+    }
+    m->segments = s;
+  }
+
+  s = &m->segments[m->count++];
+  memset(s, 0, sizeof(*s));
+  s->name = strdup(name);
+  s->start = -1;
+  s->silence = -1;
+
+  return s;
+}
+
+void manifest_free(struct ws_manifest *m) {
+
+  int i;
+
+  for(i = 0; i < m->count; i++)
+    free(m->segments[i].name);
+
+  free(m->segments);
+  m->segments = NULL;
+  m->count = m->size = 0;
+
+}
+
+static double seconds(struct ws_manifest *m, long long frames) {
+
+  return m->rate ? (double)frames / m->rate : 0;
+
+}
+
+static void write_json(struct ws_manifest *m, FILE *fp, const char *input) {
+
+  struct ws_segment *s;
+  int i;
+
+  fprintf(fp, "{\n  \"input\": ");
+  json_string(fp, input);
+  fprintf(fp, ",\n  \"sample_rate\": %u,\n  \"channels\": %i,\n"
+          "  \"bits\": %i,\n", m->rate, m->channels, m->bits);
+  if(m->data_offset >= 0)
+    fprintf(fp, "  \"data_offset\": %lld,\n", m->data_offset);
+  else
+    fprintf(fp, "  \"data_offset\": null,\n");
+
+  fprintf(fp, "  \"pieces\": [");
+  for(i = 0; i < m->count; i++) {
+    s = &m->segments[i];
+    fprintf(fp, "%s\n    {\"name\": ", i ? "," : "");
+    json_string(fp, s->name);
+    fprintf(fp, ", \"start_frame\": %lld, \"end_frame\": %lld, "
+            "\"offset\": %llu, \"bytes\": %llu, \"start\": %.6f, "
+            "\"duration\": %.6f, \"silence_before\": %.6f}",
+            s->start, s->start + s->frames,
+            (unsigned long long)s->start * m->frame_size, s->bytes,
+            seconds(m, s->start), seconds(m, s->frames),
+            seconds(m, s->silence));
+  }
+  fprintf(fp, "%s]\n}\n", m->count ? "\n  " : "");
+
+}
+
+// Names with a comma or a quote in them are quoted
+static void csv_string(FILE *fp, const char *str) {
+
+  if(!strpbrk(str, ",\"\n")) {
+    fputs(str, fp);
+    return;
+  }
+
+  fputc('"', fp);
+  for(; *str; str++) {
+    if(*str == '"')
+      fputc('"', fp);
+    fputc(*str, fp);
+  }
+  fputc('"', fp);
+
+}
+
+static void write_csv(struct ws_manifest *m, FILE *fp) {
+
+  struct ws_segment *s;
+  int i;
+
+  fprintf(fp, "name,start_frame,end_frame,offset,bytes,start,duration,"
+          "silence_before\n");
+
+  for(i = 0; i < m->count; i++) {
+    s = &m->segments[i];
+    csv_string(fp, s->name);
+    fprintf(fp, ",%lld,%lld,%llu,%llu,%.6f,%.6f,%.6f\n", s->start,
+            s->start + s->frames,
+            (unsigned long long)s->start * m->frame_size, s->bytes,
+            seconds(m, s->start), seconds(m, s->frames),
+            seconds(m, s->silence));
+  }
+
+}
+
+// CUE times are minutes, seconds and 1/75 s frames
+static void cue_time(struct ws_manifest *m, FILE *fp, long long frames) {
+
+  long long cd = m->rate ? frames * 75 / m->rate : 0;
+
+  fprintf(fp, "%02lld:%02lld:%02lld", cd / (75 * 60), (cd / 75) % 60,
+          cd % 75);
+
+}
+
+// A track starts at its piece; skipped silence before it (-s) is its
+// pregap, INDEX 00
+static void write_cue(struct ws_manifest *m, FILE *fp, const char *input) {
+
+  struct ws_segment *s;
+  long long end = 0;
+  int i;
+
+  fprintf(fp, "FILE \"%s\" WAVE\n", input);
+
+  for(i = 0; i < m->count; i++) {
+    s = &m->segments[i];
+    fprintf(fp, "  TRACK %02i AUDIO\n", i + 1);
+    fprintf(fp, "    TITLE \"%s\"\n", s->name);
+    if(s->start > end) {
+      fprintf(fp, "    INDEX 00 ");
+      cue_time(m, fp, end);
+      fprintf(fp, "\n");
+    }
+    fprintf(fp, "    INDEX 01 ");
+    cue_time(m, fp, s->start);
+    fprintf(fp, "\n");
+    end = s->start + s->frames;
+  }
+
+}
+
+int manifest_write(struct ws_manifest *m, const char *path,
+                   const char *input) {
+
+  FILE *fp;
+
+  fp = fopen(path, "w");
+  if(fp == NULL) {
+    perror(path);
+    return 0;
+  }
+
+  switch(manifest_format(path)) {
+  case MANIFEST_JSON:
+    write_json(m, fp, input);
+    break;
+  case MANIFEST_CSV:
+    write_csv(m, fp);
+    break;
+  default:
+    write_cue(m, fp, input);
+    break;
+  }
+
+  if(fclose(fp) != 0) {
+    perror(path);
+    return 0;
+  }
+
+  return 1;
+}
@@ -0,0 +1,73 @@
+/*  wavmanifest.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_MANIFEST_H
+#define WAV_MANIFEST_H
+
+#define MANIFEST_JSON   1
+#define MANIFEST_CSV    2
+#define MANIFEST_CUE    3
+
+#define MAX_MANIFESTS   3
+
+// Where one piece is in the input
+struct ws_segment {
+
+  char *name;               // The name the piece would have been given
+  long long start;          // First frame, -1 until something is in it
+  long long frames;
+  unsigned long long bytes;
+  long long silence;        // Silent frames before it, -1 until known
+
+};
+
+struct ws_manifest {
+
+  struct ws_segment *segments;
+  int count;
+  int size;
+
+  unsigned int rate;
+  int channels;
+  int bits;
+  int frame_size;
+  long long data_offset;    // Of the samples in the input, -1 if unknown
+
+};
+
+// Functions
+
+int manifest_format(const char *path);
+
+void manifest_init(struct ws_manifest *m, unsigned int rate, int channels,
+                   int bits, long long data_offset);
+struct ws_segment *manifest_add(struct ws_manifest *m, const char *name);
+int manifest_write(struct ws_manifest *m, const char *path,
+                   const char *input);
+void manifest_free(struct ws_manifest *m);
+
+#endif
@@ -0,0 +1,157 @@
+/*  wavring.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Lock-free single-producer/single-consumer rings for the pipelined mode.
+
+    head and tail only ever increase; the slot is the counter modulo size.
+    The producer publishes an item with a release store of head after copying
+    it in, and the consumer frees the slot with a release store of tail after
+    copying it out, so no locks are needed.  A side that has to wait spins
+    for a moment and then sleeps with a growing back-off, and counts the wait
+    as a stall.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#include "wavring.h"
+
+#define SPIN_TRIES      256
+#define MAX_NAP_NS      1000000         // 1ms
+
+int ring_init(struct ws_ring *r, unsigned int slots, size_t item_size) {
+
+  unsigned int size = 1;
+
+  while(size < slots)
+    size <<= 1;
+
+  memset(r, 0, sizeof(*r));
+  r->size = size;
+  r->item_size = item_size;
+  r->slots = malloc(size * item_size);
+
+  if(r->slots == NULL) {
+    fprintf(stderr, "ring: Could not allocate %u slots\n", size);
+    return 0;
+  }
+
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+
+  return 1;
+}
+
+void ring_free(struct ws_ring *r) {
+
+  free(r->slots);
+  r->slots = NULL;
+
+}
+
+// Returns 0 if the ring is full
+int ring_push(struct ws_ring *r, const void *item) {
+
+  unsigned int head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  unsigned int tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+  if(head - tail == r->size)
+    return 0;
+
+  memcpy(r->slots + (head & (r->size - 1)) * r->item_size, item,
+         r->item_size);
+  atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+  return 1;
+}
+
+// Returns 0 if the ring is empty
+int ring_pop(struct ws_ring *r, void *item) {
+
+  unsigned int tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  unsigned int head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+  if(head == tail)
+    return 0;
+
+  memcpy(item, r->slots + (tail & (r->size - 1)) * r->item_size,
+         r->item_size);
+  atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+
+  return 1;
+}
+
+static void back_off(int tries) {
+
+  struct timespec nap;
+  long ns;
+
+  if(tries < SPIN_TRIES) {
+    sched_yield();
+    return;
+  }
+
+  ns = 1000L << ((tries - SPIN_TRIES) < 10 ? (tries - SPIN_TRIES) : 10);
+  if(ns > MAX_NAP_NS)
+    ns = MAX_NAP_NS;
+
+  nap.tv_sec = 0;
+  nap.tv_nsec = ns;
+  nanosleep(&nap, NULL);
+
+}
+
+// Blocking versions of ring_push() and ring_pop()
+void ring_put(struct ws_ring *r, const void *item) {
+
+  int tries = 0;
+
+  if(ring_push(r, item))
+    return;
+
+  r->full_stalls++;
+  while(!ring_push(r, item))
+    back_off(tries++);
+
+}
+
+void ring_get(struct ws_ring *r, void *item) {
+
+  int tries = 0;
+
+  if(ring_pop(r, item))
+    return;
+
+  r->empty_stalls++;
+  while(!ring_pop(r, item))
+    back_off(tries++);
+
+}
@@ -0,0 +1,64 @@
+/*  wavring.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_RING_H
+#define WAV_RING_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define CACHE_LINE      64
+
+// Bounded single-producer/single-consumer queue of fixed-size items
+struct ws_ring {
+
+  unsigned int size;                // Slots, a power of two
+  size_t item_size;
+  unsigned char *slots;
+
+  // Written by the producer
+  _Alignas(CACHE_LINE) atomic_uint head;
+  long long full_stalls;            // Times the producer found it full
+
+  // Written by the consumer
+  _Alignas(CACHE_LINE) atomic_uint tail;
+  long long empty_stalls;           // Times the consumer found it empty
+
+};
+
+// Functions
+
+int ring_init(struct ws_ring *r, unsigned int slots, size_t item_size);
+void ring_free(struct ws_ring *r);
+
+int ring_push(struct ws_ring *r, const void *item);
+int ring_pop(struct ws_ring *r, void *item);
+
+void ring_put(struct ws_ring *r, const void *item);
+void ring_get(struct ws_ring *r, void *item);
+
+#endif
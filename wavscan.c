@@ -0,0 +1,273 @@
+/*  wavscan.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Parallel scan of a seekable data chunk (-j).
+
+    The data chunk is cut into one range of whole -b blocks per thread.  A
+    worker can't know the silence counter it starts with, so it counts the
+    silent blocks before its first loud one (the lead) and from there on
+    works the counter out on its own.  All it keeps are the places the
+    splitter cares about: stretches where the counter is above GAP, with the
+    counter at their start, and the first block after each of them (and the
+    first in the range) that ends on a loud sample, which is what clears the
+    splitter's silence flag.
+
+    The merge then replays every block into the splitter in order, carrying
+    the counter from one range into the lead of the next, so GAP, OVERRIDE,
+    min_track_length and skip_silence are applied exactly as process_data()
+    applies them.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "wavscan.h"
+
+// Bytes each worker reads at a time
+#define SCAN_BUFFER     (1024 * 1024)
+
+static int add_event(struct scan_part *p, int type, long long block,
+                     long long counter) {
+
+  struct scan_event *e;
+
+  if(p->count == p->size) {
+    p->size = p->size ? p->size * 2 : 64;
+    e = realloc(p->events, p->size * sizeof(*e));
+    if(e == NULL)
+      return 0;
+    p->events = e;
+  }
+
+  e = &p->events[p->count++];
+  e->type = type;
+  e->block = block;
+  e->count = 1;
+  e->counter = counter;
+
+  return 1;
+}
+
+static void *scan_worker(void *arg) {
+
+  struct scan_part *p = arg;
+  struct ws_syscalls calls;
+  unsigned char *buffer;
+  size_t buffer_size;
+  ssize_t size, got;
+  off_t offset, pos;
+  long long block;
+  int seen_loud = 0, in_gap = 0, want_reset = 1;
+  long long c = 0;
+  int block_bytes, count, tail, any_loud;
+
+  if(p->stats)
+    stats_syscalls(&calls);
+
+  buffer_size = (SCAN_BUFFER / p->block_size) * p->block_size;
+  if(buffer_size == 0)
+    buffer_size = p->block_size;
+
+  buffer = malloc(buffer_size);
+  if(buffer == NULL) {
+    p->error = 1;
+    return NULL;
+  }
+
+  block = p->start / p->block_size;
+
+  for(offset = p->start; offset < p->end; offset += size) {
+
+    size = (p->end - offset < (off_t)buffer_size) ? p->end - offset
+                                                  : (off_t)buffer_size;
+
+    for(got = 0; got < size; got += pos) {
+      pos = pread(p->fd, buffer + got, size - got,
+                  p->data_offset + offset + got);
+      if(pos <= 0) {
+        if((pos == -1) && (errno == EINTR)) {
+          pos = 0;
+          continue;
+        }
+        fprintf(stderr, "scan: Error reading input at offset %lld.\n",
+                (long long)(p->data_offset + offset + got));
+        p->error = 1;
+        free(buffer);
+        return NULL;
+      }
+    }
+
+    for(pos = 0; pos < size; pos += block_bytes, block++) {
+
+      block_bytes = (size - pos < p->block_size) ? size - pos : p->block_size;
+      count = block_bytes / p->sample_size;
+
+      any_loud = detect_block(p->detector, buffer + pos, count, &tail);
+
+      if(!seen_loud) {
+        if(!any_loud) {
+          p->lead++;
+          continue;
+        }
+        seen_loud = 1;
+      }
+
+      c = any_loud ? tail : c + count;
+
+      if(c == 0) {
+        if(want_reset && !add_event(p, SCAN_RESET, block, 0))
+          p->error = 1;
+        want_reset = 0;
+        in_gap = 0;
+      } else if(c > p->gap) {
+        if(in_gap && !any_loud)
+          p->events[p->count - 1].count++;
+        else if(!add_event(p, SCAN_GAP, block, c))
+          p->error = 1;
+        in_gap = 1;
+        want_reset = 1;
+      } else
+        in_gap = 0;
+    }
+  }
+
+  p->counter = c;
+
+  if(p->stats)
+    stats_add_syscalls(p->stats, &calls);
+
+  free(buffer);
+  return NULL;
+}
+
+// Scans the data chunk of fd with jobs threads and plans the pieces, feeding
+// sp exactly as process_data() would.  The workers' reads go to stats.
+int scan_parallel(int fd, off_t data_offset, off_t data_size, int jobs,
+                  int block_size, int sample_size, int channels,
+                  const struct ws_detector *d, struct ws_splitter *sp,
+                  struct ws_plan *plan, struct ws_stats *stats) {
+
+  struct scan_part parts[MAX_JOBS];
+  pthread_t threads[MAX_JOBS];
+  struct scan_part *p;
+  struct scan_event *e;
+  long long blocks, per_part, block, first;
+  off_t offset;
+  int low = (sp->gap > 0) ? 1 : 0;   // Any counter in (0, GAP]
+  long long c = 0;
+  int i, k, size, count, result, ok = 1;
+
+  blocks = (data_size + block_size - 1) / block_size;
+
+  if(jobs > MAX_JOBS)
+    jobs = MAX_JOBS;
+  if(jobs > blocks)
+    jobs = blocks;
+  if(jobs < 1)
+    jobs = 1;
+
+  per_part = (blocks + jobs - 1) / jobs;
+
+  memset(parts, 0, sizeof(parts));
+
+  for(k = 0; k < jobs; k++) {
+    p = &parts[k];
+    p->fd = fd;
+    p->data_offset = data_offset;
+    p->start = k * per_part * block_size;
+    p->end = (k + 1) * per_part * block_size;
+    if(p->end > data_size)
+      p->end = data_size;
+    p->block_size = block_size;
+    p->sample_size = sample_size;
+    p->gap = sp->gap;
+    p->detector = d;
+    p->stats = stats;
+
+    if(pthread_create(&threads[k], NULL, scan_worker, p) != 0) {
+      fprintf(stderr, "scan: Could not start thread %i\n", k);
+      jobs = k;
+      ok = 0;
+      break;
+    }
+  }
+
+  for(k = 0; k < jobs; k++) {
+    pthread_join(threads[k], NULL);
+    if(parts[k].error)
+      ok = 0;
+  }
+
+  for(k = 0; ok && (k < jobs); k++) {
+
+    p = &parts[k];
+    first = p->start / block_size;
+    i = 0;
+
+    for(offset = p->start, block = first; offset < p->end;
+        offset += block_size, block++) {
+
+      size = (p->end - offset < block_size) ? p->end - offset : block_size;
+      count = size / sample_size;
+
+      e = (i < p->count) ? &p->events[i] : NULL;
+
+      if(block - first < p->lead)
+        c += count;
+      else if(e && (block >= e->block)) {
+        if(e->type == SCAN_RESET)
+          c = 0;
+        else
+          c = (block == e->block) ? e->counter : c + count;
+        if(block == e->block + e->count - 1)
+          i++;
+      } else
+        c = low;
+
+      result = split_feed(sp, c, count / channels);
+      if(!plan_add(plan, result, offset, size, count / channels))
+        ok = 0;
+    }
+
+    // Whatever the counter really was at the end of the range
+    if(p->lead < block - first)
+      c = p->counter;
+  }
+
+  for(k = 0; k < MAX_JOBS; k++)
+    free(parts[k].events);
+
+  if(ok)
+    plan_finish(plan);
+
+  return ok;
+}
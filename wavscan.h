@@ -0,0 +1,83 @@
+/*  wavscan.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_SCAN_H
+#define WAV_SCAN_H
+
+#include <sys/types.h>
+
+#include "wavdetect.h"
+#include "wavsplit.h"
+#include "wavstats.h"
+
+#define MAX_JOBS        64
+
+// Something a worker saw that the splitter has to know about
+#define SCAN_RESET      0   // The block ended on a loud sample
+#define SCAN_GAP        1   // Blocks where the silence counter is above GAP
+
+struct scan_event {
+
+  int type;
+  long long block;          // First block
+  long long count;          // Blocks (SCAN_GAP)
+  long long counter;        // Silence counter after the first block (SCAN_GAP)
+
+};
+
+struct scan_part {
+
+  // Work
+  int fd;
+  off_t data_offset;
+  off_t start;              // Byte range of the data chunk
+  off_t end;
+  int block_size;
+  int sample_size;
+  long long gap;
+  const struct ws_detector *detector;
+  struct ws_stats *stats;   // For the reads, or NULL
+
+  // Results
+  long long lead;           // Blocks before the first loud one
+  long long counter;        // Silence counter after the last block, if any
+                            // block was loud
+  struct scan_event *events;
+  int count;
+  int size;
+  int error;
+
+};
+
+// Functions
+
+int scan_parallel(int fd, off_t data_offset, off_t data_size, int jobs,
+                  int block_size, int sample_size, int channels,
+                  const struct ws_detector *d, struct ws_splitter *sp,
+                  struct ws_plan *plan, struct ws_stats *stats);
+
+#endif
@@ -46,15 +46,27 @@
 #include <unistd.h>
 #include <time.h>
 #include <string.h>   /* strncpy() */
+#include <errno.h>
+#include <pthread.h>
 #include <unistd.h>
 #include "wavheader.h"
+#include "wavdetect.h"
+#include "wavinput.h"
+#include "wavsplit.h"
+#include "wavindex.h"
+#include "wavscan.h"
+#include "wavring.h"
+#include "wavuring.h"
+#include "wavspool.h"
+#include "wavhook.h"
+#include "wavstats.h"
+#include "wavlookback.h"
+#include "wavstream.h"
 #include "wavsilence.h"
 
 // GLOBALS
-int counter;
-FILE* fd;
-FILE* logfp;
 int debug_level;
+struct ws_hooks hooks;	// -e commands of every job
 
 void clear_line() {
 
@@ -62,548 +74,2506 @@ void clear_line() {
 
 }
 
-void build_output_filename(int count, char* buffer){  /* tblough 5.25.04 */
-  sprintf(buffer, opts.piece_name, (opts.natural ? count + 1 : count));
+void build_output_filename(struct ws_job* job, int count,
+			   char* buffer){  /* tblough 5.25.04 */
+  sprintf(buffer, job->opts.piece_name,
+	  (job->opts.natural ? count + 1 : count));
 }
 
-void exec_cmd() {
-
-  int pid;
-  int ret;
-  char command[FILEN_LENGTH];
+// Queues the -e command for the piece just closed
+void exec_cmd(struct ws_job* job) {
 
   char fname[FILEN_LENGTH];
-  build_output_filename(counter-1, fname);
+  build_output_filename(job, job->counter-1, fname);
 
-  pid = fork();
-
-  if(pid == 0) {
-    pid = getpid();
-    // Child
-    if(debug_level >= VERYVERBOSE)
-      printf("--> [%i] Asyncronously running %s\n", pid, opts.pipe_cmd);
-    snprintf(command, FILEN_LENGTH, "%s %s 2>&1 > /dev/null",
-	     opts.exec_cmd, fname);
-    ret = system(command);
-    if(debug_level >= VERYVERBOSE)
-      printf("--> [%i] Command exited with status %i\n", pid, ret);
+  if(debug_level >= VERYVERBOSE)
+    printf("--> Queued %s for %s\n", job->opts.exec_cmd, fname);
 
-    if(opts.remove_after_exec) {
-      unlink( fname);
-    }
-    exit(0);
-  } else
-    return;
+  hook_run(job->hooks, &job->hook_list, job->opts.exec_cmd, fname,
+	   job->opts.remove_after_exec);
 
 }
 
-void start_log_file(struct wav_file_headers* wav_headers) {
+void start_log_file(struct ws_job* job, struct wav_file_headers* wav_headers) {
 
-  FILE* datefp;
   char date[DATE_LENGTH];
+  time_t now;
+  struct tm tm;
 
-  logfp = fopen(opts.log_file, "w");
+  job->logfp = fopen(job->opts.log_file, "w");
 
-  if (logfp == NULL) {
+  if (job->logfp == NULL) {
     perror("log file");
     exit(1);
   }
 
-  datefp = popen("date", "r");
-  fgets(date, DATE_LENGTH, datefp);
-  pclose(datefp);
+  // What date(1) would say, without running it for every input
+  now = time(NULL);
+  localtime_r(&now, &tm);
+  strftime(date, DATE_LENGTH, "%a %b %e %H:%M:%S %Z %Y\n", &tm);
 
-  fprintf(logfp, "# Log file created by " WAVSILENCE_VERSION "\n");
-  fprintf(logfp, "# Copyright Dan Smith (2003) - http://www.danplanet.com\n");
-  fprintf(logfp, "# Summary generated %s\n", date);
+  fprintf(job->logfp, "# Log file created by " WAVSILENCE_VERSION "\n");
+  fprintf(job->logfp,
+	  "# Copyright Dan Smith (2003) - http://www.danplanet.com\n");
+  fprintf(job->logfp, "# Summary generated %s\n", date);
 
-  fprintf(logfp, "# Data read from ");
-  if(opts.read_from_file)
-    fprintf(logfp, "file: %s\n", opts.input_file);
+  fprintf(job->logfp, "# Data read from ");
+  if(job->opts.read_from_file)
+    fprintf(job->logfp, "file: %s\n", job->opts.input_file);
   else
-    fprintf(logfp, "stdin\n");
+    fprintf(job->logfp, "stdin\n");
 
-  fprintf(logfp, "# %i Channels, %i Bit, %i Hz\n\n", 
+  fprintf(job->logfp, "# %i Channels, %i Bit, %i Hz\n\n", 
 	  wav_headers->fmt.NumChannels, 
 	  wav_headers->fmt.BitsPerSample,
 	  wav_headers->fmt.SampleRate);
 
-  fflush(logfp);
+  fflush(job->logfp);
 
 }
 
-void finish_log_file(struct wav_file_headers* wav_headers,
-		     unsigned int start_time, unsigned int bytecount) {
+void finish_log_file(struct ws_job* job, struct wav_file_headers* wav_headers,
+		     unsigned int start_time, unsigned long long bytecount) {
 
   unsigned int current_time;
 
   current_time = time(NULL);
 
-  fprintf(logfp, "\n");
-  fprintf(logfp, "# === Totals ===\n");
-  fprintf(logfp, "# Elapsed time: %i seconds\n", current_time - start_time);
-  fprintf(logfp, "# Data processed: %i KB\n", bytecount / 1024);
-  fprintf(logfp, "# Average throughput: %7.1f KB/s\n", 
+  fprintf(job->logfp, "\n");
+  fprintf(job->logfp, "# === Totals ===\n");
+  fprintf(job->logfp, "# Elapsed time: %i seconds\n",
+	  current_time - start_time);
+  fprintf(job->logfp, "# Data processed: %llu KB\n", bytecount / 1024);
+  fprintf(job->logfp, "# Average throughput: %7.1f KB/s\n", 
 	  (bytecount / 1024) / (float)(current_time - start_time));
 
 }
 
-int is_silence(short sample) {
+double calc_real_time(long long sample_num, struct wav_file_headers* h) {
 
-  int boundary;
-  
-  // For now, just assume 16-bit 2's compliment
+  return (double)sample_num / h->fmt.SampleRate;
+
+}
 
-  boundary = (opts.threshold * 65536) / 2;
+// Rewrites the header of the open piece for length bytes of data
+void fix_file(struct ws_job* job, unsigned long long length) {
 
-  if((sample < boundary) && (sample > (-1 * boundary)))
-    return 1;
-  else
-    return 0;
+  unsigned char header[MAX_HEADER_SIZE];
+  int size;
+  long long t = stats_start(job->stats);
+
+  if(!set_data_size(&job->piece_headers, length))
+    fprintf(stderr, "Warning: piece %i is over 4 GB, its header is wrong\n",
+	    job->counter - 1);
+
+  size = pack_headers(&job->piece_headers, header);
+
+  if(job->writer)
+    writer_patch(job->writer, 0, header, size);
+  else {
+    fseek(job->fd, 0, SEEK_SET);
+    fwrite(header, size, 1, job->fd);
+  }
+
+  stats_stop(job->stats, STAGE_FIX, t, 0);
 
 }
 
-double calc_real_time(int sample_num, struct wav_file_headers* h) {
+// Writes to the open piece; returns the number of bytes written
+unsigned int piece_write(struct ws_job* job, const void* data,
+			 unsigned int size) {
 
-  return (double)sample_num / h->fmt.SampleRate;
+  long long t = stats_start(job->stats);
+  unsigned int written = size;
+
+  if(job->writer)
+    writer_write(job->writer, data, size);
+  else if(job->spool) {
+    if(!spool_write(job->spool, data, size))
+      exit(1);
+  } else
+    written = fwrite(data, size, 1, job->fd) * size;
+
+  // Live, each block goes out as soon as it is in
+  if(job->live)
+    fflush(job->fd);
 
+  stats_stop(job->stats, STAGE_WRITE, t, written);
+
+  return written;
 }
 
-void fix_file(int length) {
+// Pipes the held piece to -P, now that its length is known
+void send_spooled_piece(struct ws_job* job) {
 
-  int chunksize;
+  struct wav_file_headers* h = &job->piece_headers;
+  unsigned long long length = job->spool->used + job->spool->spilled;
+  unsigned char header[MAX_HEADER_SIZE];
+  int size;
 
-  // Position ourselves at the RIFF Header ChunkSize
-  fseek(fd, CHUNK0_OFFSET, SEEK_SET);
-  
-  chunksize = 36 + length;
+  set_data_size(h, length);
+  size = pack_headers(h, header);
 
-  // Write new ChunkSize
-  fwrite(&chunksize, sizeof(chunksize), 1, fd);
-  
-  // Position ourselves at the FMT Header SubchunkSize
-  fseek(fd, CHUNK1_OFFSET, SEEK_SET);
+  job->fd = popen(job->opts.pipe_cmd, "w");
+  if(job->fd == NULL) {
+    fprintf(stderr, "Could not run %s\n", job->opts.pipe_cmd);
+    exit(1);
+  }
 
-  chunksize = 16;
+  if((fwrite(header, size, 1, job->fd) != 1) ||
+     !spool_drain(job->spool, job->fd))
+    fprintf(stderr, "Error piping a piece to %s\n", job->opts.pipe_cmd);
 
-  // Write new SubchunkSize
-  fwrite(&chunksize, sizeof(chunksize), 1, fd);
+  pclose(job->fd);
 
-  // Position ourselves at the DATA Header SubchunkSize
-  fseek(fd, CHUNK2_OFFSET, SEEK_SET);
-  
-  chunksize = length;
+}
+
+void close_piece(struct ws_job* job) {
+
+  long long t = stats_start(job->stats);
+
+  job->piece_opened = 0;
 
-  // Write new SubchunkSize
-  fwrite(&chunksize, sizeof(chunksize), 1, fd);
+  if(job->spool)
+    send_spooled_piece(job);
+  else if(job->writer)
+    writer_close(job->writer, job->opts.exec_enabled); // -e needs it on disk
+  else
+    fclose(job->fd);
+
+  job->fd = NULL;
+
+  stats_stop(job->stats, STAGE_CLOSE, t, 0);
 
 }
 
-void write_log_entry(unsigned int bytecounter, unsigned int sample_c, 
+void write_log_entry(struct ws_job* job, unsigned long long bytecounter,
+		     long long sample_c,
 		     struct wav_file_headers* wav_headers) {
   char fname[FILEN_LENGTH];
-  build_output_filename(counter-1, fname); // Potential buffer overflow
+  build_output_filename(job, job->counter-1, fname); // Potential buffer overflow
 
 
-  fprintf(logfp, "%20s: %9i bytes  %9.2f seconds\n",
+  fprintf(job->logfp, "%20s: %9llu bytes  %9.2f seconds\n",
 	      fname, bytecounter, calc_real_time(sample_c, wav_headers));
 }
 
-void start_new_file(struct wav_file_headers* wav_headers, 
-		    unsigned int bytecounter, int sample_c) {
+// The open piece has ended: log it, and count it for -T
+void piece_done(struct ws_job* job, unsigned long long bytecounter,
+		long long sample_c, struct wav_file_headers* wav_headers) {
+
+  if(job->opts.log_enabled)
+    write_log_entry(job, bytecounter, sample_c, wav_headers);
+
+  if(job->stats)
+    stats_piece(job->stats, bytecounter, sample_c);
+
+  if(job->live)
+    live_done(job->live, sample_c, bytecounter);
+
+}
+
+void start_new_file(struct ws_job* job, struct wav_file_headers* wav_headers, 
+		    unsigned long long bytecounter, long long sample_c) {
 
   char fname[FILEN_LENGTH];
+  unsigned char header[MAX_HEADER_SIZE];
+  long long t;
 
-  if(fd != NULL) {
+  if(job->piece_opened) {
 
     if(debug_level >= VERYVERBOSE)
-      printf("Wrote %i bytes\n", bytecounter);
+      printf("Wrote %llu bytes\n", bytecounter);
+
+    if(! job->opts.pipe_enabled) // Don't seek if we're piping
+      fix_file(job, bytecounter); 
 
-    if(! opts.pipe_enabled) // Don't seek if we're piping
-      fix_file(bytecounter); 
+    close_piece(job);
 
-    fclose(fd);
+    if(job->live)
+      live_end(job->live);
 
-    if(opts.exec_enabled)
-      exec_cmd();
+    if(job->opts.exec_enabled)
+      exec_cmd(job);
 
   }
 
-  build_output_filename(counter++, fname); // Potential buffer overflow
+  build_output_filename(job, job->counter++, fname); // Potential buffer overflow
+
+  if(job->live)
+    live_start(job->live, job->counter - 1, fname, sample_c);
 
   if(debug_level >= VERBOSE) {
-    if(opts.show_progress) clear_line();
+    if(job->opts.show_progress) clear_line();
     printf("New File: %s\n", fname);
   }
 
-  if(opts.pipe_enabled)
-    fd = popen(opts.pipe_cmd, "w");
+  job->piece_opened = 1;
+
+  t = stats_start(job->stats);
+
+  // fix_file() works on this copy
+  job->piece_headers = *wav_headers;
+
+  if(job->spool)
+    return;
+
+  if(job->writer) {
+    if(!writer_open(job->writer, fname)) {
+      fprintf(stderr, "Could not create %s\n", fname);
+      exit(1);
+    }
+    piece_write(job, header, pack_headers(wav_headers, header));
+    stats_stop(job->stats, STAGE_OPEN, t, 0);
+    return;
+  }
+
+  if(job->opts.pipe_enabled)
+    job->fd = popen(job->opts.pipe_cmd, "w");
   else
-    fd = fopen(fname, "w");
+    job->fd = fopen(fname, "w");
 
-  fp_write_headers(fd, wav_headers);
+  fp_write_headers(job->fd, wav_headers);
 
+  stats_stop(job->stats, STAGE_OPEN, t, 0);
 
 }
 
-void display_stats(int sample_c, int bytecount, unsigned int start_time,
+void display_stats(long long sample_c, unsigned long long bytecount,
+		   unsigned int start_time,
 		   struct wav_file_headers* wav_headers) {
 
   float wavtime;
-  int total;
   char human[SIZE_LENGTH];
-  int orig_byte_count;
   unsigned int current_time;
   float kbps;
 
   current_time = time(NULL);
 
   wavtime = calc_real_time(sample_c, wav_headers);
-  orig_byte_count = bytecount;
-
-  if((bytecount % 1024) == bytecount) {
-    // Less than 1K
-    sprintf(human, "%5i b ", bytecount);
-    bytecount = -1;
-  } else {
-    bytecount = total = bytecount / 1024;
-  }
-  if((total % 1024) == bytecount) {
-    // Less than 1M
-    sprintf(human, "%5i KB", total);
-    bytecount = -1;
-  } else {
-    total = total / 1024;
-  }
 
-  if(bytecount != -1)
-    sprintf(human, "%5i MB", total);
+  if(bytecount < 1024)
+    sprintf(human, "%5llu b ", bytecount);
+  else if(bytecount < 1024 * 1024)
+    sprintf(human, "%5llu KB", bytecount / 1024);
+  else
+    sprintf(human, "%5llu MB", bytecount / (1024 * 1024));
 
-  kbps = (float)(orig_byte_count / 1024) / (float)(current_time - start_time);
+  kbps = (float)(bytecount / 1024) / (float)(current_time - start_time);
 
   printf("\rProcessed %.2f s - %s total - %.1f KB/s throughput\r", 
 	 wavtime, human, kbps);
 
 }
 
-void process_data(struct wav_file_headers* wav_headers, int in_fd) {
-  
-  int sample_size;
-  int sample_c,i;
-  short *sample;
-  int size, wsize;
-  int silence_counter = 0;
-  int silence_flag = 0;
-  int min_length_flag = 1; /* Default is always split */
-  int override_flag = 0;	/* tblough 5/23/04 */
-  unsigned int bytecounter = 0;
-  unsigned int file_bytecounter = 0;
-  unsigned int start_time;
-  unsigned int file_sample_c = 0;
+// Once the last piece is closed: flush the output, wait for the -e
+// commands and finish the log
+void finish_output(struct ws_job* job, struct wav_file_headers* wav_headers,
+		   unsigned int start_time, unsigned long long bytecounter) {
 
-  start_time = time(NULL);
+  long long t;
 
-  // Array of samples (NumChannels of them)
-  sample = calloc(wav_headers->fmt.NumChannels * opts.buffer_amt, sizeof(short));
+  if(job->spool) {
+    if(debug_level >= VERBOSE)
+      printf("Lookahead: at most %llu KB of a piece went to disk\n",
+	     job->spool->peak_spilled / 1024);
+    spool_free(job->spool);
+  }
 
-  sample_size = wav_headers->fmt.BitsPerSample / 8;
+  if(job->writer) {
+    if(debug_level >= VERYVERBOSE)
+      printf("io_uring: %lli submits\n", job->writer->ring.enters);
+    if(job->stats)
+      job->stats->uring_enters += job->writer->ring.enters;
+    writer_finish(job->writer);
+    if(job->writer->error)
+      exit(1);
+  }
 
-  if(debug_level >= VERYVERBOSE)
-    printf("sample size: %i\n", sample_size);
+  // The log is only complete once every command has finished
+  if(job->opts.exec_enabled) {
+    t = stats_start(job->stats);
+    hooks_wait(job->hooks, &job->hook_list);
+    stats_stop(job->stats, STAGE_HOOKS, t, 0);
+    if(job->stats)
+      stats_hooks(job->stats, &job->hook_list);
+    if(job->opts.log_enabled)
+      hooks_log(&job->hook_list, job->logfp);
+    hooks_free(&job->hook_list);
+  }
 
-  sample_c = 0;
-  do {
+  if(job->opts.log_enabled)
+    finish_log_file(job, wav_headers, start_time, bytecounter);
 
-    size = read(in_fd, sample, sample_size * wav_headers->fmt.NumChannels * opts.buffer_amt);
-    for(i=0; i<wav_headers->fmt.NumChannels * opts.buffer_amt; i++) {
+}
 
-      if((size == 0) && (debug_level >= VERYVERBOSE))
-	printf("End of Data\n");
+// Fix final file and close FD
+void finish_pieces(struct ws_job* job, struct wav_file_headers* wav_headers,
+		   unsigned long long file_bytecounter, long long file_sample_c,
+		   unsigned int start_time, unsigned long long bytecounter) {
 
-      if(debug_level >= INSANELYVERBOSE)
-	printf("[%i,%i] 0x%hx (%hi)  %i\n", sample_c, i, sample[i], sample[i], size);
+  if(! job->opts.pipe_enabled) // Don't seek if we're piping
+    fix_file(job, file_bytecounter);
 
-      if(is_silence(sample[i]))
-	silence_counter++;
-      else {
-	silence_counter = 0;
-      }
-    }
+  if(job->live)
+    job->live->cut = LIVE_END;
 
-    if(silence_counter == 0)
-      silence_flag=0;
+  piece_done(job, file_bytecounter, file_sample_c, wav_headers);
 
-    if(debug_level >= VERYVERBOSE) {
-      printf("min_track_length: %f cur_track_length: %f\n", opts.min_track_length, 
-	     file_sample_c / (float)wav_headers->fmt.SampleRate);
-    }
+  close_piece(job);
 
-    if(opts.min_track_length > 0) {
-      /* Check to make sure we've seen enough samples before splitting */
-      if( opts.min_track_length <= (file_sample_c / wav_headers->fmt.SampleRate) )
-	min_length_flag = 1;
-      else
-	min_length_flag = 0;
-    }
+  if(job->live)
+    live_end(job->live);
 
-    // tblough 5/23/04 - modified to provide minimum track length override
-	if((opts.override > opts.gap) && (silence_counter > OVERRIDE)) {
-	   if(debug_level >= VERYVERBOSE) {
-          printf("Override GAP: %i  Counter: %i\n", OVERRIDE, silence_counter);
-          printf("Silence Detected @ %.2fs\n", calc_real_time(sample_c, wav_headers));
-       }
-       override_flag = 1;
-	}
-	else
-	   override_flag = 0;
+  if(job->opts.exec_enabled)
+    exec_cmd(job);
 
-	if((silence_counter > GAP) && (! silence_flag) && (min_length_flag || override_flag)) {
+  finish_output(job, wav_headers, start_time, bytecounter);
 
-      if(debug_level >= VERYVERBOSE) {
-	printf("Silence GAP: %i  Counter: %i\n", GAP, silence_counter);
-	printf("Silence Detected @ %.2fs\n", calc_real_time(sample_c, wav_headers));
-      }
+}
 
-      silence_flag=1;
-      if(opts.log_enabled)
-	write_log_entry(file_bytecounter, file_sample_c, wav_headers);
-      start_new_file(wav_headers, file_bytecounter, sample_c);
-      file_bytecounter = 0;
-      file_sample_c = 0;
-    }
+void split_params(struct ws_job* job, struct ws_splitter* sp,
+		  struct wav_file_headers* wav_headers) {
 
-	// Only write if we should not skip the silence and there is silence
-	// loescher 06/06/04
-	if (! (opts.skip_silence && silence_flag) ) {
-	  wsize = fwrite(sample, sample_size * wav_headers->fmt.NumChannels * opts.buffer_amt, 1, fd);
+  split_init(sp, GAP, (job->opts.override > job->opts.gap) ? OVERRIDE : -1,
+	     job->opts.min_track_length, wav_headers->fmt.SampleRate,
+	     job->opts.skip_silence);
+  sp->max_frames = job->opts.max_length * wav_headers->fmt.SampleRate;
 
-	  file_bytecounter += wsize * sample_size * wav_headers->fmt.NumChannels * opts.buffer_amt;
-	  bytecounter += wsize * sample_size * wav_headers->fmt.NumChannels * opts.buffer_amt;
-	}
+}
 
-    sample_c += opts.buffer_amt;
-    file_sample_c += opts.buffer_amt;
+void detect_params(struct ws_job* job, struct ws_detector* d,
+		   struct wav_file_headers* wav_headers) {
 
-    // Display stats
-    if((opts.show_progress) && ((sample_c % 1000) == 0))
-      display_stats(sample_c, bytecounter, start_time, wav_headers);
+  if(!detect_init(d, job->opts.threshold, wav_headers->format,
+		  wav_headers->fmt.BitsPerSample)) {
+    printf("Can't detect silence in %i-bit samples of format %i\n",
+	   wav_headers->fmt.BitsPerSample, wav_headers->format);
+    exit(1);
+  }
+
+}
 
-  } while(size > 0);
+// The per-block debug output, once the splitter has seen the block
+void debug_block(struct ws_job* job, const struct ws_detector* detector,
+		 const struct ws_splitter* splitter, const void* block,
+		 int count, int result, long long sample_c,
+		 struct wav_file_headers* wav_headers) {
 
-  // Fix final file and close FD
-  if(! opts.pipe_enabled) // Don't seek if we're piping
-    fix_file(file_bytecounter);
+  const short *sample = block;
+  int i;
 
-  if(opts.log_enabled)
-    write_log_entry(file_bytecounter, file_sample_c, wav_headers);
+  if(debug_level >= INSANELYVERBOSE)
+    for(i=0; i<count; i++) {
+      if(detector->bits == 16)
+	printf("[%lli,%i] 0x%hx (%hi)\n", sample_c, i, sample[i], sample[i]);
+      else
+	printf("[%lli,%i] %g\n", sample_c, i, detect_value(detector, block, i));
+    }
 
-  fclose(fd);
+  if(debug_level >= VERYVERBOSE) {
+    printf("min_track_length: %f cur_track_length: %f\n", job->opts.min_track_length, 
+	   splitter->file_sample_c / (float)wav_headers->fmt.SampleRate);
+  }
 
-  if(opts.exec_enabled)
-    exec_cmd();
+  // tblough 5/23/04 - modified to provide minimum track length override
+  if(splitter->override_flag && (debug_level >= VERYVERBOSE)) {
+    printf("Override GAP: %lli  Counter: %lli\n", OVERRIDE, splitter->silence_counter);
+    printf("Silence Detected @ %.2fs\n", calc_real_time(sample_c, wav_headers));
+  }
 
-  if(opts.log_enabled)
-    finish_log_file(wav_headers, start_time, bytecounter);
+  if((result & SPLIT_NEW_PIECE) && (debug_level >= VERYVERBOSE)) {
+    printf("Silence GAP: %lli  Counter: %lli\n", GAP, splitter->silence_counter);
+    printf("Silence Detected @ %.2fs\n", calc_real_time(sample_c, wav_headers));
+  }
 
 }
 
-void print_usage() {
+// Runs one block through the detector and the splitter (and the index, if
+// one is being built), and says what to do with it
+int check_block(struct ws_job* job, struct ws_detector* detector,
+		struct ws_splitter* splitter,
+		struct ws_index** ix, unsigned char* block, int count,
+		long long sample_c, struct wav_file_headers* wav_headers) {
 
-  printf(WAVSILENCE_VERSION " - Dan Smith (dsmith@danplanet.com)\n");
-  printf("Usage: wavsilence <options>\n");
-  printf("Options:\n");
-  printf("  -g <gap>       Minimum gap (in seconds) to be considered silence\n");
-  printf("  -t <threshold> Volume (in %% of Max) to be considered silence\n");
-  printf("  -v             Verbose mode (specify multiple times to increase verbosity)\n");
-  printf("  -I             Print input WAV information\n");
-  printf("  -e <cmd>       Execute <cmd> when each piece is finished, with the filename\n");
-  printf("                 as the last argument\n");
-  printf("  -r             Remove the WAV file after <cmd> (only valid with -e)\n");
-  printf("  -p             Display progress and statistics during operation\n");
-  printf("  -i <file>      Read from <file> instead of stdin\n");
-  printf("  -n <name>      Name output files <name>.  '%%n' can be used to locate the\n");
-  printf("                 the segment number where 'n' is the number of digits\n");
-  printf("                 (i.e. '-n piece-%%3' would produce piece-000, piece 001, ...)\n");
-  printf("  -N             Use 1,2,3,... vs 0,1,2,... for segment numbering\n");
-  printf("  -l <file>      Log summary information in <file>\n");
-  printf("  -b <num>       Buffer input by <num> samples (1 is default; try 16)\n");
-  printf("  -P <cmd>       Pipe output of each segment to <cmd>\n");
-  printf("  -m <seconds>   Minimum track length (seconds)\n");
-  printf("  -M <minutes>   Minimum track length (minutes)\n");
-  printf("  -o <override>  Minimum gap (in seconds) to override minimum track length\n");
-  printf("                 Longer gaps will begin a new track regardless of track length\n");
-  printf("  -s             Skip silence (remove the silence between pieces)\n");
-  printf("  -c <num>       Counter-start. With this option you can set the initial\n                 value of the file-number-counter.\n");
-  printf("  -h             Display this message\n");
-  printf("Operation:\n");
-  printf("  WAV file is read via stdin, split at points of silence into files\n");
-  printf("  named \"piece-N.wav\" (unless user specified)\n");
-  printf("  The initial value of N defaults to 0 but can be specified by -c.\n");
-  printf("Examples:\n");
-  printf("  wavsilence -g 1.1 -o 3.5 -t 4 -b 64 -l log.txt -p -M 3 -i test.wav\n");
-  printf("  wavsilence -v -s -b 64 -n '%%2' -c 26 -i recording_of_song_26_to_31.wav\n");
+  int tail, any_loud, result;
+  long long t;
 
-  exit(1);
+  // The index is only kept for 16-bit input
+  if(*ix && !index_add(*ix, (short *)block, count)) {
+    index_abort(*ix);
+    *ix = NULL;
+  }
+
+  t = stats_start(job->stats);
+  if(job->channels)
+    result = split_feed(splitter,
+			channels_block(detector, job->channels, block, count),
+			count / wav_headers->fmt.NumChannels);
+  else {
+    if(job->envelope)
+      any_loud = envelope_block(job->envelope, block, count, &tail);
+    else
+      any_loud = detect_block(detector, block, count, &tail);
+    result = split_block(splitter, any_loud, tail, count,
+			 count / wav_headers->fmt.NumChannels);
+  }
+  stats_stop(job->stats, STAGE_DETECT, t, count * (detector->bits / 8));
+
+  debug_block(job, detector, splitter, block, count, result, sample_c,
+	      wav_headers);
+
+  return result;
 }
 
-void set_name( char *optarg)  /* tblough 5.25.04 */
-{
-	char *p;
-	char tmp[FILEN_LENGTH - 6];
-	int width;
+// Opens the samples of a job's input for reading, starting with any that
+// were read along with the headers.  Live input (-Z) is read a block at a
+// time as it comes.
+int open_job_input(struct ws_job* job, struct ws_input* input, int in_fd,
+		   size_t block_size) {
 
-    /* leave enough room for the '0' and 'i' and the '.wav' we will add */
-	strncpy(tmp, optarg, FILEN_LENGTH - 6);
-	/* make sure there is one and only one occurance of the flag */
-	if( ((p = strchr( tmp, '%')) != '\0') && (strrchr( tmp, '%') == p))
-	{
-		width = tmp[p - tmp + 1] - '0';  /* grab the next character, convert to int */
-		if( width >= 1 && width <= 9)
-		{
-			strncpy( opts.piece_name, tmp, p - tmp + 1);	/* copy prepended info */
-			opts.piece_name[p - tmp + 1] = '\0';
-			sprintf( opts.piece_name, "%s0%ii%s.wav", opts.piece_name, width, p+2);
-			return;
-		}
-	}
-	/* more than one field marked, or not a vaild field width, so append the segment */
-	strncpy( opts.piece_name, optarg, FILEN_LENGTH - 9);
-	sprintf( opts.piece_name, "%s-%%03i.wav", opts.piece_name);
+  struct ws_header_buffer *b = job->header_buffer;
+  int flags = job->live ? INPUT_NO_AHEAD
+			: (job->opts.read_from_file ? INPUT_MAP : 0);
+
+  return input_open(input, in_fd, block_size, flags,
+		    b->data + b->start, b->end - b->start);
 }
 
-void process_args(int argc, char**argv) {
-  int c;
+// process_data() runs the input through a libwavsilence stream, which calls
+// these to write the pieces
+struct ws_feed {
+  struct ws_job *job;
+  struct wav_file_headers *wav_headers;
+  struct ws_detector *detector;		// For the debug output
+  struct ws_stream *stream;
+  int result;				// What the splitter made of the last block
+  int finishing;			// The last piece is left to finish_pieces()
+  long long last_sample_c;		// Its length
+  unsigned long long file_bytecounter;
+  unsigned long long bytecounter;
+  long long callback_ns;		// Spent in here rather than detecting
+};
 
-  while((c = getopt(argc, argv, "re:n:P:b:i:Vl:psIvht:g:o:m:M:Nc:")) != -1) {
-    switch (c) {
-    case 't':
-      opts.threshold = atof(optarg) / 100.0;
-      if(opts.threshold <= 0) {
-	printf("Invalid threshold value!\n");
-	exit(1);
-      }
-      break;
-    case 'g':
-      opts.gap = atof(optarg);
-      if(opts.gap <= 0) {
-	printf("Invalid gap length!\n");
-	exit(1);
-      }
-      break;
-    case 'o':
-      opts.override = atof(optarg);
-      if(opts.override <= 0) {
-	printf("Invalid override length!\n");
-	exit(1);
-      }
-      break;
-    case 'v':
-      debug_level++;
-      break;
-    case 'I':
-      opts.show_file_info = 1;
-      break;
-    case 'p':
-      opts.show_progress = 1;
-      break;
-    case 'l':
-      opts.log_enabled = 1;
-      strncpy(opts.log_file, optarg, FILEN_LENGTH);
-      break;
-    case 'V':
-      printf(WAVSILENCE_VERSION "\n");
-      exit(1);
-      break;
-    case 'i':
-      opts.read_from_file = 1;
-      strncpy(opts.input_file, optarg, FILEN_LENGTH);
-      break;
-    case 'b':
-      opts.buffer_amt = atoi(optarg);
-      if(opts.buffer_amt <= 0) {
-	printf("Invalid Buffer amount!\n");
-	exit(1);
-      }
+int feed_block(void *user, const struct ws_splitter *sp, const void *samples,
+	       int count, int result) {
 
-      break;
-    case 'P':
-      opts.pipe_enabled = 1;
-      strncpy(opts.pipe_cmd, optarg, FILEN_LENGTH);
-      break;
-    case 'n':
-      set_name(optarg);
-      break;
-    case 'e':
-      opts.exec_enabled = 1;
-      strncpy(opts.exec_cmd, optarg, FILEN_LENGTH);
-      break;
-    case 'r':
-      opts.remove_after_exec = 1;
-      break;
-    case 'm':
-      opts.min_track_length += atof(optarg);
-      break;
-    case 'M':
-      opts.min_track_length += (60 * atof(optarg));
-      break;
-    case 'N':
-      opts.natural = 1;
-      break;
-    case 's':
-      opts.skip_silence = 1;
-      break;
-    case 'c':
-      opts.counter_start = atoi(optarg);
-      break;
+  struct ws_feed *f = user;
 
-      // DEFAULT
-    default:
-    case 'h':
-      print_usage();
-      break;
-    }
-  }
+  f->result = result;
 
-    return;    
+  debug_block(f->job, f->detector, sp, samples, count, result,
+	      ws_stream_frames(f->stream), f->wav_headers);
 
+  return 1;
 }
 
-void print_params() {
+int feed_start(void *user, int segment, long long sample_c) {
 
-  printf("Minimum Gap: %.2f s\n", opts.gap);
-  printf("Minimum Track Length: %.2f s\n", opts.min_track_length);
-  printf("Override Gap: %.2f s\n", opts.override);
+  struct ws_feed *f = user;
+  long long t = stats_start(f->job->stats);
+
+  // run_job() opened the first piece
+  if(segment > 0) {
+    start_new_file(f->job, f->wav_headers, f->file_bytecounter, sample_c);
+    f->file_bytecounter = 0;
+  }
+
+  f->callback_ns += stats_start(f->job->stats) - t;
+
+  return 1;
+}
+
+int feed_data(void *user, int segment, const void *data, size_t size) {
+
+  struct ws_feed *f = user;
+  long long t = stats_start(f->job->stats);
+  unsigned int wsize;
+
+  wsize = piece_write(f->job, data, size);
+
+  f->file_bytecounter += wsize;
+  f->bytecounter += wsize;
+  f->callback_ns += stats_start(f->job->stats) - t;
+
+  return 1;
+}
+
+int feed_end(void *user, int segment, long long sample_c,
+	     unsigned long long bytes) {
+
+  struct ws_feed *f = user;
+  struct ws_job *job = f->job;
+  long long t = stats_start(job->stats);
+
+  if(f->finishing) {
+    f->last_sample_c = sample_c;
+    return 1;
+  }
+
+  if(job->live)
+    job->live->cut = (f->result & SPLIT_FORCED) ? LIVE_MAX_LENGTH
+						 : LIVE_SILENCE;
+  piece_done(job, f->file_bytecounter, sample_c, f->wav_headers);
+
+  f->callback_ns += stats_start(job->stats) - t;
+
+  return 1;
+}
+
+void process_data(struct ws_job* job, struct wav_file_headers* wav_headers,
+		  int in_fd,
+		  struct ws_index* ix) {
+  
+  int sample_size;
+  unsigned char *span;
+  size_t span_size;
+  int span_got;
+  struct ws_input input;
+  struct ws_detector detector;
+  struct ws_stream_params params;
+  struct ws_stream_events events;
+  struct ws_feed feed;
+  unsigned int start_time;
+  long long spans = 0, coarse, cells, blocks;
+  long long sample_c, shown = 0;
+  long long t;
+
+  start_time = time(NULL);
+
+  sample_size = wav_headers->fmt.BitsPerSample / 8;
+
+  detect_params(job, &detector, wav_headers);
+
+  ws_stream_defaults(&params);
+  params.format = wav_headers->format;
+  params.bits = wav_headers->fmt.BitsPerSample;
+  params.channels = wav_headers->fmt.NumChannels;
+  params.rate = wav_headers->fmt.SampleRate;
+  params.threshold = job->opts.threshold;
+  params.gap = job->opts.gap;
+  params.override = job->opts.override;
+  params.min_length = job->opts.min_track_length;
+  params.skip_silence = job->opts.skip_silence;
+  params.block_frames = job->opts.buffer_amt;
+  params.max_length = job->opts.max_length;
+  params.detector = job->opts.envelope;
+  params.window = job->opts.window;
+  params.loud_threshold = job->opts.loud_threshold;
+  params.channel_policy = job->opts.channel_policy;
+
+  // The stream passes over a span with a loud sample in every cell of half
+  // of GAP in one go.  The windowed and the per-channel detectors, and the
+  // per-block debug output, need every block, and so does live input (-Z),
+  // which can't wait for a span to fill.
+  params.exhaustive = job->opts.exhaustive || job->envelope ||
+    job->channels || job->live || (debug_level >= VERYVERBOSE);
+
+  memset(&feed, 0, sizeof(feed));
+  feed.job = job;
+  feed.wav_headers = wav_headers;
+  feed.detector = &detector;
+
+  memset(&events, 0, sizeof(events));
+  events.user = &feed;
+  events.segment_start = feed_start;
+  events.segment_data = feed_data;
+  events.segment_end = feed_end;
+  events.block = feed_block;
+
+  feed.stream = ws_stream_open(&params, &events);
+  if(feed.stream == NULL) {
+    fprintf(stderr, "Could not set up the splitter\n");
+    exit(1);
+  }
+
+  // Spans are read whole, so the stream cuts them as it would a file
+  span_size = ws_stream_span(feed.stream);
+
+  // Only regular files named with -i are mapped; stdin is always read()
+  if(!open_job_input(job, &input, in_fd, span_size))
+    exit(1);
+
+  if(debug_level >= VERYVERBOSE) {
+    printf("sample size: %i\n", sample_size);
+    printf("input: %s\n", input.mapped ? "mmap" : (input.ring ? "io_uring"
+								 : "read"));
+    printf("detection kernel: %s\n", detector.name);
+  }
+
+  for(;;) {
+
+    t = stats_start(job->stats);
+    span_got = input_next(&input, span_size, &span);
+    stats_stop(job->stats, STAGE_READ, t, span_got > 0 ? span_got : 0);
+
+    if(span_got <= 0)
+      break;
+
+    spans++;
+
+    // The index is only kept for 16-bit input
+    if(ix && !index_add(ix, (short *)span, span_got / sample_size)) {
+      index_abort(ix);
+      ix = NULL;
+    }
+
+    // The pieces are written from the callbacks, which time themselves
+    t = stats_start(job->stats);
+    feed.callback_ns = 0;
+    if(!ws_stream_feed(feed.stream, span, span_got))
+      exit(1);
+    stats_stop(job->stats, STAGE_DETECT, t + feed.callback_ns, span_got);
+
+    // Display stats
+    sample_c = ws_stream_frames(feed.stream);
+    if(job->opts.show_progress && (sample_c - shown >= 1000)) {
+      display_stats(sample_c, feed.bytecounter, start_time, wav_headers);
+      shown = sample_c;
+    }
+
+  }
+
+  if(span_got == -1)
+    exit(1);
+
+  // The input may end in a short block
+  t = stats_start(job->stats);
+  feed.callback_ns = 0;
+  if(!ws_stream_drain(feed.stream))
+    exit(1);
+  stats_stop(job->stats, STAGE_DETECT, t + feed.callback_ns, 0);
+
+  if(debug_level >= VERYVERBOSE)
+    printf("End of Data\n");
+
+  ws_stream_scan(feed.stream, &coarse, &cells, &blocks);
+
+  if(!params.exhaustive && (debug_level >= VERBOSE)) {
+    if(job->opts.show_progress) clear_line();
+    printf("Coarse scan: %lli of %lli spans (%.1f%%) cleared, %lli cells "
+	   "looked at\n", coarse, spans, spans ? 100.0 * coarse / spans : 0.0,
+	   cells);
+    printf("Fine scan: %lli blocks\n", blocks);
+  }
+
+  if(job->stats) {
+    job->stats->scan_spans += spans;
+    job->stats->scan_coarse += coarse;
+    job->stats->scan_cells += cells;
+    job->stats->scan_blocks += blocks;
+  }
+
+  if(input.ring && job->stats)
+    job->stats->uring_enters += input.ring->enters;
+
+  input_close(&input);
+
+  if(ix && index_finish(ix) && (debug_level >= VERBOSE))
+    printf("Wrote index %s\n", ix->path);
+
+  feed.finishing = 1;
+  if(!ws_stream_finish(feed.stream))
+    exit(1);
+  ws_stream_close(feed.stream);
+
+  finish_pieces(job, wav_headers, feed.file_bytecounter, feed.last_sample_c,
+		start_time, feed.bytecounter);
+
+}
+
+// Finds the pieces like process_data(), but only writes the -A manifests.
+// data_offset is where the samples are in the input, -1 if unknown.
+void process_analyze(struct ws_job* job, struct wav_file_headers* wav_headers,
+		     int in_fd, long long data_offset) {
+
+  struct ws_manifest manifest;
+  struct ws_segment *seg;
+  char fname[FILEN_LENGTH];
+  int channels = wav_headers->fmt.NumChannels;
+  int sample_size, block_size, size, count, frames, result, i;
+  long long sample_c = 0, before;
+  unsigned char *block;
+  struct ws_input input;
+  struct ws_detector detector;
+  struct ws_splitter splitter;
+  struct ws_index *ix = NULL;
+  unsigned long long bytecounter = 0;
+  unsigned int start_time;
+  long long t;
+
+  start_time = time(NULL);
+
+  sample_size = wav_headers->fmt.BitsPerSample / 8;
+  block_size = sample_size * channels * job->opts.buffer_amt;
+
+  if(!open_job_input(job, &input, in_fd, block_size))
+    exit(1);
+
+  detect_params(job, &detector, wav_headers);
+  split_params(job, &splitter, wav_headers);
+
+  manifest_init(&manifest, wav_headers->fmt.SampleRate, channels,
+		wav_headers->fmt.BitsPerSample, data_offset);
+
+  build_output_filename(job, job->counter++, fname);
+  seg = manifest_add(&manifest, fname);
+
+  for(;;) {
+
+    t = stats_start(job->stats);
+    size = input_next(&input, block_size, &block);
+    stats_stop(job->stats, STAGE_READ, t, size > 0 ? size : 0);
+
+    if(size <= 0)
+      break;
+
+    count = size / sample_size;
+    frames = count / channels;
+
+    before = splitter.silence_counter;
+    result = check_block(job, &detector, &splitter, &ix, block, count,
+			 sample_c, wav_headers);
+
+    // The silence before a piece is the whole run it was cut in, so it is
+    // only known once the sound comes back
+    if((splitter.silence_counter < before + count) && (seg->silence < 0))
+      seg->silence = before / channels;
+
+    if(result & SPLIT_NEW_PIECE) {
+      if(seg->silence < 0)
+	seg->silence = before / channels;
+      piece_done(job, seg->bytes, splitter.piece_sample_c, wav_headers);
+      build_output_filename(job, job->counter++, fname);
+      seg = manifest_add(&manifest, fname);
+    }
+
+    if(result & SPLIT_WRITE) {
+      if(seg->start < 0)
+	seg->start = sample_c;
+      seg->frames += frames;
+      seg->bytes += size;
+      bytecounter += size;
+    }
+
+    sample_c += frames;
+
+    if((job->opts.show_progress) && ((sample_c % 1000) == 0))
+      display_stats(sample_c, bytecounter, start_time, wav_headers);
+
+  }
+
+  if(size == -1)
+    exit(1);
+
+  if(input.ring && job->stats)
+    job->stats->uring_enters += input.ring->enters;
+
+  input_close(&input);
+
+  if(seg->silence < 0)
+    seg->silence = splitter.silence_counter / channels;
+
+  piece_done(job, seg->bytes, splitter.file_sample_c, wav_headers);
+
+  // A piece that was all skipped silence is empty, at the end of the last
+  for(i = 0; i < manifest.count; i++)
+    if(manifest.segments[i].start < 0)
+      manifest.segments[i].start = i ? manifest.segments[i-1].start +
+	manifest.segments[i-1].frames : 0;
+
+  for(i = 0; i < job->opts.manifests; i++)
+    if(!manifest_write(&manifest, job->opts.manifest_file[i],
+		       job->opts.read_from_file ? job->opts.input_file
+						: "stdin"))
+      job->failed = 1;
+
+  if(debug_level >= VERBOSE)
+    printf("%i pieces found\n", manifest.count);
+
+  manifest_free(&manifest);
+
+  if(job->opts.log_enabled)
+    finish_log_file(job, wav_headers, start_time, bytecounter);
+
+}
+
+// Tries every -S combination in one read of the input and prints what
+// each would have done; nothing is written.
+void process_sweep(struct ws_job* job, struct wav_file_headers* wav_headers,
+		   int in_fd) {
+
+  struct ws_sweep sweep;
+  int channels = wav_headers->fmt.NumChannels;
+  int sample_size, block_size, size, count;
+  long long sample_c = 0;
+  unsigned char *block;
+  struct ws_input input;
+  unsigned int start_time;
+  long long t;
+
+  start_time = time(NULL);
+
+  sample_size = wav_headers->fmt.BitsPerSample / 8;
+  block_size = sample_size * channels * job->opts.buffer_amt;
+
+  if(!open_job_input(job, &input, in_fd, block_size))
+    exit(1);
+
+  if(!sweep_init(&sweep, &job->opts.sweep, job->opts.threshold,
+		 job->opts.gap, job->opts.min_track_length,
+		 job->opts.override, wav_headers->format,
+		 wav_headers->fmt.BitsPerSample, wav_headers->fmt.SampleRate,
+		 channels)) {
+    printf("Can't detect silence in %i-bit samples of format %i\n",
+	   wav_headers->fmt.BitsPerSample, wav_headers->format);
+    exit(1);
+  }
+
+  if(debug_level >= VERBOSE)
+    printf("Sweeping %i combinations\n", sweep.combo_count);
+
+  for(;;) {
+
+    t = stats_start(job->stats);
+    size = input_next(&input, block_size, &block);
+    stats_stop(job->stats, STAGE_READ, t, size > 0 ? size : 0);
+
+    if(size <= 0)
+      break;
+
+    count = size / sample_size;
+
+    t = stats_start(job->stats);
+    if(!sweep_block(&sweep, block, count))
+      exit(1);
+    stats_stop(job->stats, STAGE_DETECT, t, size);
+
+    sample_c += count / channels;
+
+    if((job->opts.show_progress) && ((sample_c % 1000) == 0))
+      display_stats(sample_c, 0, start_time, wav_headers);
+
+  }
+
+  if(size == -1)
+    exit(1);
+
+  if(input.ring && job->stats)
+    job->stats->uring_enters += input.ring->enters;
+
+  input_close(&input);
+
+  sweep_finish(&sweep);
+
+  if(job->opts.show_progress)
+    clear_line();
+
+  // Batch workers print whole tables
+  flockfile(stdout);
+  sweep_print(&sweep, stdout,
+	      job->opts.read_from_file ? job->opts.input_file : "stdin");
+  funlockfile(stdout);
+
+  sweep_free(&sweep);
+
+  if(job->opts.log_enabled)
+    finish_log_file(job, wav_headers, start_time, 0);
+
+}
+
+/*
+    Pipelined mode (-R).  A reader thread fills big buffers from the input,
+    the detector works through them, and a job->writer thread does all the
+    output, so a slow disk or -P command no longer holds up reading.  The
+    stages pass buffers and commands through lock-free rings; a buffer goes
+    back to the reader once the job->writer is done with it.
+*/
+
+#define CMD_WRITE       0
+#define CMD_NEW_PIECE   1
+#define CMD_RELEASE     2
+#define CMD_FINISH      3
+
+struct pipe_item {
+  int buffer;
+  int size;
+};
+
+struct pipe_cmd {
+  int type;
+  int buffer;
+  int offset;
+  int size;
+  long long sample_c;           // CMD_NEW_PIECE, CMD_FINISH
+  long long piece_sample_c;
+};
+
+struct ws_pipeline {
+  int in_fd;
+  const unsigned char *prefix;  // Samples read with the headers
+  size_t prefix_size;
+  int buffer_size;
+  unsigned char **buffers;
+  struct ws_ring free;          // writer -> reader
+  struct ws_ring full;          // reader -> detector
+  struct ws_ring commands;      // detector -> writer
+  struct ws_job *job;
+  struct wav_file_headers *wav_headers;
+  unsigned int start_time;
+};
+
+void *pipeline_reader(void *arg) {
+
+  struct ws_pipeline *pl = arg;
+  struct ws_stats *stats = pl->job->stats;
+  struct ws_syscalls calls;
+  struct pipe_item item;
+  ssize_t count;
+  long long t;
+
+  if(stats)
+    stats_syscalls(&calls);
+
+  do {
+    ring_get(&pl->free, &item.buffer);
+
+    item.size = 0;
+    if(pl->prefix_size > 0) {
+      item.size = (pl->prefix_size < (size_t)pl->buffer_size) ?
+		  pl->prefix_size : pl->buffer_size;
+      memcpy(pl->buffers[item.buffer], pl->prefix, item.size);
+      pl->prefix += item.size;
+      pl->prefix_size -= item.size;
+    }
+
+    while(item.size < pl->buffer_size) {
+      t = stats_start(stats);
+      count = read(pl->in_fd, pl->buffers[item.buffer] + item.size,
+		   pl->buffer_size - item.size);
+      stats_stop(stats, STAGE_READ, t, count > 0 ? count : 0);
+      if(count == -1) {
+	if(errno == EINTR)
+	  continue;
+	perror("input");
+	item.size = -1;
+	break;
+      }
+      if(count == 0)
+	break;
+      item.size += count;
+    }
+
+    ring_put(&pl->full, &item);
+
+  } while(item.size == pl->buffer_size);
+
+  if(stats)
+    stats_add_syscalls(stats, &calls);
+
+  return NULL;
+}
+
+void *pipeline_writer(void *arg) {
+
+  struct ws_pipeline *pl = arg;
+  struct ws_job *job = pl->job;
+  struct ws_syscalls calls;
+  struct pipe_cmd cmd;
+  unsigned long long bytecounter = 0;
+  unsigned long long file_bytecounter = 0;
+  int wsize;
+
+  if(job->stats)
+    stats_syscalls(&calls);
+
+  for(;;) {
+    ring_get(&pl->commands, &cmd);
+
+    switch(cmd.type) {
+    case CMD_WRITE:
+      wsize = piece_write(job, pl->buffers[cmd.buffer] + cmd.offset, cmd.size);
+      file_bytecounter += wsize;
+      bytecounter += wsize;
+      break;
+    case CMD_NEW_PIECE:
+      piece_done(job, file_bytecounter, cmd.piece_sample_c, pl->wav_headers);
+      start_new_file(job, pl->wav_headers, file_bytecounter, cmd.sample_c);
+      file_bytecounter = 0;
+      break;
+    case CMD_RELEASE:
+      ring_put(&pl->free, &cmd.buffer);
+      break;
+    case CMD_FINISH:
+      finish_pieces(job, pl->wav_headers, file_bytecounter, cmd.piece_sample_c,
+		    pl->start_time, bytecounter);
+      if(job->stats)
+	stats_add_syscalls(job->stats, &calls);
+      return NULL;
+    }
+  }
+}
+
+void process_pipeline(struct ws_job* job,
+		      struct wav_file_headers* wav_headers, int in_fd,
+		      struct ws_index* ix) {
+
+  struct ws_pipeline pl;
+  struct ws_detector detector;
+  struct ws_splitter splitter;
+  struct pipe_item item;
+  struct pipe_cmd cmd;
+  pthread_t reader, writer_thread;
+  unsigned long long bytecounter = 0;
+  int sample_size, block_size, size, offset, count, result, i;
+  long long sample_c = 0;
+
+  memset(&pl, 0, sizeof(pl));
+  pl.in_fd = in_fd;
+  pl.prefix = job->header_buffer->data + job->header_buffer->start;
+  pl.prefix_size = job->header_buffer->end - job->header_buffer->start;
+  pl.job = job;
+  pl.wav_headers = wav_headers;
+  pl.start_time = time(NULL);
+
+  sample_size = wav_headers->fmt.BitsPerSample / 8;
+  block_size = sample_size * wav_headers->fmt.NumChannels *
+	       job->opts.buffer_amt;
+
+  // Buffers hold whole blocks
+  pl.buffer_size = (job->opts.ring_buffer_kb * 1024 / block_size) * block_size;
+  if(pl.buffer_size < block_size)
+    pl.buffer_size = block_size;
+
+  pl.buffers = calloc(job->opts.ring_depth, sizeof(*pl.buffers));
+  if(!ring_init(&pl.free, job->opts.ring_depth, sizeof(int)) ||
+     !ring_init(&pl.full, job->opts.ring_depth, sizeof(struct pipe_item)) ||
+     !ring_init(&pl.commands, job->opts.ring_depth * 16,
+		sizeof(struct pipe_cmd)))
+    exit(1);
+
+  for(i = 0; i < job->opts.ring_depth; i++) {
+    pl.buffers[i] = malloc(pl.buffer_size);
+    if(pl.buffers[i] == NULL) {
+      fprintf(stderr, "Could not allocate %i ring buffers of %i bytes\n",
+	      job->opts.ring_depth, pl.buffer_size);
+      exit(1);
+    }
+    ring_push(&pl.free, &i);
+  }
+
+  detect_params(job, &detector, wav_headers);
+  split_params(job, &splitter, wav_headers);
+
+  if(debug_level >= VERYVERBOSE) {
+    printf("sample size: %i\n", sample_size);
+    printf("ring: %i buffers of %i bytes\n", job->opts.ring_depth,
+	   pl.buffer_size);
+    printf("detection kernel: %s\n", detector.name);
+  }
+
+  if((pthread_create(&reader, NULL, pipeline_reader, &pl) != 0) ||
+     (pthread_create(&writer_thread, NULL, pipeline_writer, &pl) != 0)) {
+    fprintf(stderr, "Could not start the pipeline threads\n");
+    exit(1);
+  }
+
+  do {
+    ring_get(&pl.full, &item);
+
+    if(item.size == -1)
+      exit(1);
+
+    cmd.type = CMD_WRITE;
+    cmd.buffer = item.buffer;
+    cmd.size = 0;
+
+    for(offset = 0; offset < item.size; offset += size) {
+
+      // The last block may be short
+      size = (item.size - offset < block_size) ? item.size - offset
+					       : block_size;
+      count = size / sample_size;
+
+      result = check_block(job, &detector, &splitter, &ix,
+			   pl.buffers[item.buffer] + offset,
+			   count, sample_c, wav_headers);
+
+      // Consecutive blocks go to the writer as one write
+      if((cmd.size > 0) &&
+	 ((result & SPLIT_NEW_PIECE) || !(result & SPLIT_WRITE))) {
+	ring_put(&pl.commands, &cmd);
+	cmd.size = 0;
+      }
+
+      if(result & SPLIT_NEW_PIECE) {
+	struct pipe_cmd piece = { CMD_NEW_PIECE, 0, 0, 0, sample_c,
+				  splitter.piece_sample_c };
+	ring_put(&pl.commands, &piece);
+      }
+
+      if(result & SPLIT_WRITE) {
+	if(cmd.size == 0)
+	  cmd.offset = offset;
+	cmd.size += size;
+	bytecounter += size;
+      }
+
+      sample_c += count / wav_headers->fmt.NumChannels;
+
+      if((job->opts.show_progress) && ((sample_c % 1000) == 0))
+	display_stats(sample_c, bytecounter, pl.start_time, wav_headers);
+    }
+
+    if(cmd.size > 0)
+      ring_put(&pl.commands, &cmd);
+
+    cmd.type = CMD_RELEASE;
+    ring_put(&pl.commands, &cmd);
+
+  } while(item.size == pl.buffer_size);
+
+  if(debug_level >= VERYVERBOSE)
+    printf("End of Data\n");
+
+  if(ix && index_finish(ix) && (debug_level >= VERBOSE))
+    printf("Wrote index %s\n", ix->path);
+
+  cmd.type = CMD_FINISH;
+  cmd.piece_sample_c = splitter.file_sample_c;
+  ring_put(&pl.commands, &cmd);
+
+  pthread_join(reader, NULL);
+  pthread_join(writer_thread, NULL);
+
+  if(debug_level >= VERBOSE)
+    printf("Pipeline stalls: reader %lli (no free buffer), "
+	   "detector %lli (no input) %lli (writer behind), writer %lli (idle)\n",
+	   pl.free.empty_stalls, pl.full.empty_stalls,
+	   pl.commands.full_stalls, pl.commands.empty_stalls);
+
+  if(job->opts.log_enabled) {
+    fprintf(job->logfp, "# Pipeline stalls: reader %lli, detector %lli/%lli, "
+	    "writer %lli\n", pl.free.empty_stalls, pl.full.empty_stalls,
+	    pl.commands.full_stalls, pl.commands.empty_stalls);
+  }
+
+  for(i = 0; i < job->opts.ring_depth; i++)
+    free(pl.buffers[i]);
+  free(pl.buffers);
+  ring_free(&pl.free);
+  ring_free(&pl.full);
+  ring_free(&pl.commands);
+
+}
+
+/*
+    Pre-roll (-a).  A piece starts -a seconds before the sound comes back
+    instead of on the block where the gap was noticed, and with -s it ends
+    right after its last loud frame.  The input is only read forward, so
+    frames that can still go either way wait in a lookback ring: the last
+    pre-roll's worth, and with -s the quiet frames since the last loud one.
+    Anything older is written (or dropped) straight from the input block,
+    so loud stretches are never copied.
+*/
+
+struct ws_trim {
+  struct ws_job *job;
+  struct ws_lookback ring;
+  int frame_size;
+  long long preroll;            // Frames
+  int in_gap;                   // A split was found, and no sound since
+  unsigned long long piece_bytes;
+  long long piece_frames;
+  unsigned long long bytecounter;
+};
+
+// Writes (or, with write clear, drops) the oldest frames waiting: those in
+// the ring first, then those of the block from *pos on
+void trim_release(struct ws_trim* t, unsigned char* block, long long* pos,
+		  long long frames, int write) {
+
+  unsigned char *part[2];
+  size_t size[2];
+  long long n;
+  int i, parts;
+
+  n = lookback_frames(&t->ring);
+  if(n > frames)
+    n = frames;
+
+  if(n > 0) {
+    parts = lookback_peek(&t->ring, n, &part[0], &size[0], &part[1], &size[1]);
+    for(i = 0; write && (i < parts); i++)
+      piece_write(t->job, part[i], size[i]);
+    lookback_drop(&t->ring, n);
+    frames -= n;
+  }
+
+  if(frames > 0) {
+    if(write)
+      piece_write(t->job, block + *pos * t->frame_size, frames * t->frame_size);
+    *pos += frames;
+  }
+
+  if(write) {
+    t->piece_bytes += (n + frames) * t->frame_size;
+    t->piece_frames += n + frames;
+    t->bytecounter += (n + frames) * t->frame_size;
+  }
+
+}
+
+// Quiet samples at the start of a block that has a loud one
+int quiet_head(struct ws_job* job, struct ws_detector* detector,
+	       unsigned char* block, int count) {
+
+  int quiet = 0, loud = count, mid, tail;
+
+  // The envelope has already worked it out, and can't be asked twice
+  if(job->envelope)
+    return job->envelope->head;
+
+  if(job->channels)
+    return channels_head(detector, job->channels, block, count);
+
+  // The first <quiet> samples hold no loud one, the first <loud> do
+  while(loud - quiet > 1) {
+    mid = (quiet + loud) / 2;
+    if(detect_block(detector, block, mid, &tail))
+      loud = mid;
+    else
+      quiet = mid;
+  }
+
+  return quiet;
+}
+
+void process_trimmed(struct ws_job* job, struct wav_file_headers* wav_headers,
+		     int in_fd) {
+
+  struct ws_trim t;
+  struct ws_input input;
+  struct ws_detector detector;
+  struct ws_splitter splitter;
+  struct ws_index *ix = NULL;
+  unsigned char *block;
+  int channels = wav_headers->fmt.NumChannels;
+  int sample_size, block_size, size, count, result, any_loud;
+  long long frames, pending, cut, quiet = 0, pos, sample_c = 0;
+  unsigned int start_time;
+  int skip = job->opts.skip_silence;
+  long long t0;
+
+  start_time = time(NULL);
+
+  sample_size = wav_headers->fmt.BitsPerSample / 8;
+  block_size = sample_size * channels * job->opts.buffer_amt;
+
+  memset(&t, 0, sizeof(t));
+  t.job = job;
+  t.frame_size = sample_size * channels;
+  t.preroll = job->opts.preroll * wav_headers->fmt.SampleRate;
+
+  if(!open_job_input(job, &input, in_fd, block_size))
+    exit(1);
+
+  detect_params(job, &detector, wav_headers);
+  split_params(job, &splitter, wav_headers);
+
+  // Room for the pre-roll, the quiet frames before a split, and a block
+  if(!lookback_init(&t.ring, t.preroll + (skip ? GAP / channels + 1 : 0) +
+		    2 * job->opts.buffer_amt, t.frame_size))
+    exit(1);
+
+  if(debug_level >= VERYVERBOSE)
+    printf("lookback: %lli frames\n", lookback_room(&t.ring));
+
+  for(;;) {
+
+    t0 = stats_start(job->stats);
+    size = input_next(&input, block_size, &block);
+    stats_stop(job->stats, STAGE_READ, t0, size > 0 ? size : 0);
+
+    if(size <= 0)
+      break;
+
+    // A broken last frame is left out
+    frames = size / t.frame_size;
+    count = frames * channels;
+    if(frames == 0)
+      continue;
+
+    result = check_block(job, &detector, &splitter, &ix, block, count,
+			 sample_c, wav_headers);
+
+    // After a loud block the counter is its quiet tail, which is shorter
+    // than the block; after a quiet one it is at least the block
+    any_loud = splitter.silence_counter < count;
+
+    pending = lookback_frames(&t.ring) + frames;
+    pos = 0;
+
+    // The sound is back: the new piece starts -a before it
+    if(t.in_gap && any_loud) {
+      cut = pending - frames +
+	quiet_head(job, &detector, block, count) / channels - t.preroll;
+      if(cut > 0)
+	trim_release(&t, block, &pos, cut, !skip);
+      piece_done(job, t.piece_bytes, t.piece_frames, wav_headers);
+      start_new_file(job, wav_headers, t.piece_bytes, sample_c);
+      t.piece_bytes = 0;
+      t.piece_frames = 0;
+      t.in_gap = 0;
+      pending = lookback_frames(&t.ring) + frames - pos;
+    }
+
+    // Quiet frames at the end of what is waiting
+    quiet = any_loud ? splitter.silence_counter / channels : quiet + frames;
+    if(quiet > pending)
+      quiet = pending;
+
+    if(!t.in_gap) {
+
+      // Everything up to the last loud frame is in the piece for sure, and
+      // without -s so is everything before the pre-roll
+      if(skip)
+	trim_release(&t, block, &pos, pending - quiet, 1);
+      else if(pending > t.preroll)
+	trim_release(&t, block, &pos, pending - t.preroll, 1);
+
+      if(result & SPLIT_NEW_PIECE) {
+	t.in_gap = 1;
+	pending = lookback_frames(&t.ring) + frames - pos;
+	if(skip && (pending > t.preroll))
+	  trim_release(&t, block, &pos, pending - t.preroll, 0);
+      }
+
+    } else if(pending > t.preroll)
+      trim_release(&t, block, &pos, pending - t.preroll, !skip);
+
+    // Keep the rest, making room if a long quiet stretch didn't split
+    if(frames - pos > lookback_room(&t.ring))
+      trim_release(&t, block, &pos, frames - pos - lookback_room(&t.ring),
+		   !(skip && t.in_gap));
+    lookback_push(&t.ring, block + pos * t.frame_size, frames - pos);
+
+    sample_c += frames;
+
+    if((job->opts.show_progress) && ((sample_c % 1000) == 0))
+      display_stats(sample_c, t.bytecounter, start_time, wav_headers);
+  }
+
+  if(size == -1)
+    exit(1);
+
+  if(debug_level >= VERYVERBOSE)
+    printf("End of Data\n");
+
+  // Silence at the end stays in the last piece unless it was split off
+  pos = 0;
+  trim_release(&t, NULL, &pos, lookback_frames(&t.ring),
+	       !(skip && t.in_gap));
+
+  if(input.ring && job->stats)
+    job->stats->uring_enters += input.ring->enters;
+
+  input_close(&input);
+  lookback_free(&t.ring);
+
+  finish_pieces(job, wav_headers, t.piece_bytes, t.piece_frames, start_time,
+		t.bytecounter);
+
+}
+
+// Writes the planned pieces as their headers and ranges of the input
+// copied by the kernel, or cloned (-K)
+void copy_pieces(struct ws_job* job, struct wav_file_headers* wav_headers,
+		 int in_fd, off_t data_offset, struct ws_plan* plan,
+		 unsigned int start_time) {
+
+  struct ws_copier copier;
+  struct wav_file_headers h;
+  struct ws_piece *p;
+  char fname[FILEN_LENGTH];
+  unsigned char *header;
+  unsigned long long bytecounter = 0;
+  long long sample_c = 0;
+  long long t;
+  int i, out, size;
+
+  if(!copier_init(&copier, in_fd))
+    exit(1);
+
+  header = malloc(MAX_HEADER_SIZE + copier.block + 8);
+  if(header == NULL)
+    exit(1);
+
+  for(i = 0; i < plan->count; i++) {
+
+    p = &plan->pieces[i];
+
+    build_output_filename(job, job->counter++, fname);
+
+    if(debug_level >= VERBOSE) {
+      if(job->opts.show_progress) clear_line();
+      printf("New File: %s\n", fname);
+    }
+
+    t = stats_start(job->stats);
+    out = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(out == -1) {
+      perror(fname);
+      exit(1);
+    }
+    stats_stop(job->stats, STAGE_OPEN, t, 0);
+
+    // Pad the header so the samples can share blocks with the input
+    h = *wav_headers;
+    if(copier.clone && (p->length > 0))
+      align_data(&h, data_offset + p->start, copier.block);
+
+    if(!set_data_size(&h, p->length))
+      fprintf(stderr, "Warning: piece %i is over 4 GB, its header is wrong\n",
+	      job->counter - 1);
+
+    t = stats_start(job->stats);
+    size = pack_headers(&h, header);
+    if(pwrite(out, header, size, 0) != size) {
+      perror(fname);
+      exit(1);
+    }
+    if((p->length > 0) &&
+       !copier_copy(&copier, data_offset + p->start, out, size, p->length))
+      exit(1);
+    stats_stop(job->stats, STAGE_WRITE, t, p->length);
+
+    t = stats_start(job->stats);
+    close(out);
+    stats_stop(job->stats, STAGE_CLOSE, t, 0);
+
+    piece_done(job, p->length, p->sample_c, wav_headers);
+
+    if(job->opts.exec_enabled)
+      exec_cmd(job);
+
+    bytecounter += p->length;
+    sample_c += p->sample_c;
+
+    if(job->opts.show_progress)
+      display_stats(sample_c, bytecounter, start_time, wav_headers);
+  }
+
+  if(debug_level >= VERBOSE)
+    printf("Pieces: %lli KB cloned, %lli KB copied by the kernel, "
+	   "%lli KB copied\n", copier.cloned / 1024, copier.ranged / 1024,
+	   copier.copied / 1024);
+
+  free(header);
+  copier_free(&copier);
+
+  finish_output(job, wav_headers, start_time, bytecounter);
+
+}
+
+// Copies the planned pieces out of the input.  The output is the same as
+// process_data(job) would have written.
+void process_plan(struct ws_job* job, struct wav_file_headers* wav_headers,
+		  int in_fd,
+		  off_t data_offset, struct ws_plan* plan,
+		  unsigned int start_time) {
+
+  struct ws_piece *p;
+  unsigned char *buffer;
+  unsigned long long bytecounter = 0;
+  long long sample_c = 0;
+  off_t done;
+  ssize_t size;
+  long long t;
+  int i;
+
+  if(job->opts.kernel_copy) {
+    copy_pieces(job, wav_headers, in_fd, data_offset, plan, start_time);
+    return;
+  }
+
+  buffer = malloc(COPY_SIZE);
+
+  for(i = 0; i < plan->count; i++) {
+
+    p = &plan->pieces[i];
+
+    if(i > 0) {
+      piece_done(job, plan->pieces[i-1].length, plan->pieces[i-1].sample_c,
+		 wav_headers);
+      start_new_file(job, wav_headers, plan->pieces[i-1].length, sample_c);
+    }
+
+    for(done = 0; done < p->length; done += size) {
+      size = (p->length - done < COPY_SIZE) ? p->length - done : COPY_SIZE;
+      t = stats_start(job->stats);
+      size = pread(in_fd, buffer, size, data_offset + p->start + done);
+      stats_stop(job->stats, STAGE_READ, t, size > 0 ? size : 0);
+      if(size <= 0) {
+	perror("input file");
+	exit(1);
+      }
+      piece_write(job, buffer, size);
+    }
+
+    bytecounter += p->length;
+    sample_c += p->sample_c;
+
+    if(job->opts.show_progress)
+      display_stats(sample_c, bytecounter, start_time, wav_headers);
+  }
+
+  free(buffer);
+
+  p = &plan->pieces[plan->count - 1];
+  finish_pieces(job, wav_headers, p->length, p->sample_c, start_time,
+		bytecounter);
+
+}
+
+// Works out the pieces from the index, then copies them out
+void process_index(struct ws_job* job, struct wav_file_headers* wav_headers,
+		   int in_fd,
+		   struct ws_index* ix) {
+
+  struct ws_detector detector;
+  struct ws_splitter splitter;
+  struct ws_plan plan;
+  unsigned int start_time;
+  long long t;
+
+  start_time = time(NULL);
+
+  detect_params(job, &detector, wav_headers);
+  split_params(job, &splitter, wav_headers);
+  plan_init(&plan);
+
+  t = stats_start(job->stats);
+  if(!index_plan(ix, in_fd, &detector, &splitter,
+		 wav_headers->fmt.NumChannels * job->opts.buffer_amt, &plan))
+    exit(1);
+  stats_stop(job->stats, STAGE_DETECT, t, 0);
+
+  if(debug_level >= VERBOSE)
+    printf("Index %s: %i pieces, %lli reads of the input\n", ix->path,
+	   plan.count, ix->pcm_reads);
+
+  process_plan(job, wav_headers, in_fd, ix->header.data_offset, &plan,
+	       start_time);
+
+  plan_free(&plan);
+  index_close(ix);
+
+}
+
+// Scans the data chunk with opts.jobs threads, then copies the pieces out
+void process_scan(struct ws_job* job, struct wav_file_headers* wav_headers,
+		  int in_fd,
+		  off_t data_offset, off_t data_size) {
+
+  struct ws_detector detector;
+  struct ws_splitter splitter;
+  struct ws_plan plan;
+  unsigned int start_time;
+  int sample_size;
+  long long t;
+
+  start_time = time(NULL);
+
+  sample_size = wav_headers->fmt.BitsPerSample / 8;
+
+  detect_params(job, &detector, wav_headers);
+  split_params(job, &splitter, wav_headers);
+  plan_init(&plan);
+
+  t = stats_start(job->stats);
+  if(!scan_parallel(in_fd, data_offset, data_size, job->opts.jobs,
+		    sample_size * wav_headers->fmt.NumChannels * job->opts.buffer_amt,
+		    sample_size, wav_headers->fmt.NumChannels,
+		    &detector, &splitter, &plan, job->stats))
+    exit(1);
+  stats_stop(job->stats, STAGE_DETECT, t, data_size);
+
+  if(debug_level >= VERBOSE)
+    printf("Scanned with %i threads: %i pieces\n", job->opts.jobs, plan.count);
+
+  process_plan(job, wav_headers, in_fd, data_offset, &plan, start_time);
+
+  plan_free(&plan);
+
+}
+
+void print_usage() {
+
+  printf(WAVSILENCE_VERSION " - Dan Smith (dsmith@danplanet.com)\n");
+  printf("Usage: wavsilence <options> [<file> ...]\n");
+  printf("Options:\n");
+  printf("  -g <gap>       Minimum gap (in seconds) to be considered silence\n");
+  printf("  -t <threshold> Volume (in %% of Max) to be considered silence\n");
+  printf("  -Z <file>      Live: write each block out as it comes, and a JSON\n");
+  printf("                 line to <file> ('-' for stdout) as each piece\n");
+  printf("                 starts and ends\n");
+  printf("  -H <seconds>   Cut a piece that reaches <seconds> even without a gap\n");
+  printf("  -S <t>/<g>/<m> Write no pieces; try every combination of the\n");
+  printf("                 comma-separated thresholds, gaps and minimum\n");
+  printf("                 lengths in one pass and print what each finds\n");
+  printf("  -X             Check every block on its own, instead of passing\n");
+  printf("                 over stretches too loud to hold a gap\n");
+  printf("  -K             Find all the pieces first, then copy them in the\n");
+  printf("                 kernel, sharing blocks with the input where the\n");
+  printf("                 filesystem can (-i only)\n");
+  printf("  -A <file>      Write no pieces, only where they are, to <file>\n");
+  printf("                 (.json, .csv or .cue; can be given 3 times)\n");
+  printf("  -k <channel>   Which channels must be silent: all (default), any,\n");
+  printf("                 or just the given one (from 1)\n");
+  printf("  -D <detector>  sample (default): any loud sample ends the silence,\n");
+  printf("                 rms or peak: the level of a sliding window decides\n");
+  printf("  -W <ms>        Window of -D rms and peak (50 is default)\n");
+  printf("  -E <threshold> Volume (in %% of Max) the window must reach to end\n");
+  printf("                 the silence (the -t threshold is default)\n");
+  printf("  -v             Verbose mode (specify multiple times to increase verbosity)\n");
+  printf("  -I             Print input WAV information\n");
+  printf("  -e <cmd>       Execute <cmd> when each piece is finished, with the filename\n");
+  printf("                 as the last argument\n");
+  printf("  -r             Remove the WAV file after <cmd> exits with status 0 (only\n");
+  printf("                 valid with -e)\n");
+  printf("  -J <num>       Run at most <num> <cmd>s at once; the rest wait their turn\n");
+  printf("                 (default: number of CPUs)\n");
+  printf("  -p             Display progress and statistics during operation\n");
+  printf("  -i <file>      Read from <file> instead of stdin\n");
+  printf("  -n <name>      Name output files <name>.  '%%n' can be used to locate the\n");
+  printf("                 the segment number where 'n' is the number of digits\n");
+  printf("                 (i.e. '-n piece-%%3' would produce piece-000, piece 001, ...)\n");
+  printf("  -N             Use 1,2,3,... vs 0,1,2,... for segment numbering\n");
+  printf("  -l <file>      Log summary information in <file>\n");
+  printf("  -b <num>       Buffer input by <num> samples (1 is default; try 16)\n");
+  printf("  -P <cmd>       Pipe output of each segment to <cmd>\n");
+  printf("  -L <MB>        Hold each -P segment back until it ends (up to <MB>\n");
+  printf("                 in memory, the rest in a temporary file), so <cmd>\n");
+  printf("                 gets a header with the right sizes\n");
+  printf("  -m <seconds>   Minimum track length (seconds)\n");
+  printf("  -M <minutes>   Minimum track length (minutes)\n");
+  printf("  -o <override>  Minimum gap (in seconds) to override minimum track length\n");
+  printf("                 Longer gaps will begin a new track regardless of track length\n");
+  printf("  -s             Skip silence (remove the silence between pieces)\n");
+  printf("  -a <seconds>   Start each piece <seconds> before the sound comes back,\n");
+  printf("                 and with -s end it right after its last loud sample\n");
+  printf("  -c <num>       Counter-start. With this option you can set the initial\n                 value of the file-number-counter.\n");
+  printf("  -R <num>       Read, detect and write in separate threads, with <num>\n");
+  printf("                 buffers between them\n");
+  printf("  -B <KB>        Size of each -R buffer (1024 is default)\n");
+  printf("  -j <num>       Scan a seekable input with <num> threads\n");
+  printf("  -x             Keep a peak index of the input in <file>.wsidx (only with -i)\n");
+  printf("                 and split from it on later runs\n");
+  printf("  -F <file>      Split every WAV file listed in <file> ('-' for stdin)\n");
+  printf("  -w <num>       Split several files with <num> threads (default: one\n");
+  printf("                 per CPU)\n");
+  printf("  -T <file>      Write the time spent in each stage, system call counts\n");
+  printf("                 and piece sizes to <file> as JSON\n");
+  printf("  -C <file>      Write a Chrome trace (chrome://tracing) of each stage\n");
+  printf("                 to <file>\n");
+  printf("  -h             Display this message\n");
+  printf("Operation:\n");
+  printf("  WAV file is read via stdin, split at points of silence into files\n");
+  printf("  named \"piece-N.wav\" (unless user specified)\n");
+  printf("  The initial value of N defaults to 0 but can be specified by -c.\n");
+  printf("  Files named on the command line (or with -F) are split into\n");
+  printf("  \"<file>-N.wav\", and -l <log> logs to \"<file>-<log>\".\n");
+  printf("Examples:\n");
+  printf("  wavsilence -g 1.1 -o 3.5 -t 4 -b 64 -l log.txt -p -M 3 -i test.wav\n");
+  printf("  wavsilence -v -s -b 64 -n '%%2' -c 26 -i recording_of_song_26_to_31.wav\n");
+
+  exit(1);
+}
+
+void set_name( char *optarg)  /* tblough 5.25.04 */
+{
+	char *p;
+	char tmp[FILEN_LENGTH - 6];
+	int width;
+
+    /* leave enough room for the '0' and 'i' and the '.wav' we will add */
+	strncpy(tmp, optarg, FILEN_LENGTH - 6);
+	/* make sure there is one and only one occurance of the flag */
+	if( ((p = strchr( tmp, '%')) != '\0') && (strrchr( tmp, '%') == p))
+	{
+		width = tmp[p - tmp + 1] - '0';  /* grab the next character, convert to int */
+		if( width >= 1 && width <= 9)
+		{
+			strncpy( opts.piece_name, tmp, p - tmp + 1);	/* copy prepended info */
+			opts.piece_name[p - tmp + 1] = '\0';
+			sprintf( opts.piece_name, "%s0%ii%s.wav", opts.piece_name, width, p+2);
+			return;
+		}
+	}
+	/* more than one field marked, or not a vaild field width, so append the segment */
+	strncpy( opts.piece_name, optarg, FILEN_LENGTH - 9);
+	sprintf( opts.piece_name, "%s-%%03i.wav", opts.piece_name);
+}
+
+void process_args(int argc, char**argv) {
+  int c;
+
+  while((c = getopt(argc, argv, "Z:H:S:XKA:k:D:W:E:a:re:J:T:C:n:P:b:i:Vl:psIvht:g:o:m:M:Nc:xj:R:B:L:w:F:")) != -1) {
+    switch (c) {
+    case 't':
+      opts.threshold = atof(optarg) / 100.0;
+      if(opts.threshold <= 0) {
+	printf("Invalid threshold value!\n");
+	exit(1);
+      }
+      break;
+    case 'g':
+      opts.gap = atof(optarg);
+      if(opts.gap <= 0) {
+	printf("Invalid gap length!\n");
+	exit(1);
+      }
+      break;
+    case 'o':
+      opts.override = atof(optarg);
+      if(opts.override <= 0) {
+	printf("Invalid override length!\n");
+	exit(1);
+      }
+      break;
+    case 'v':
+      debug_level++;
+      break;
+    case 'I':
+      opts.show_file_info = 1;
+      break;
+    case 'p':
+      opts.show_progress = 1;
+      break;
+    case 'l':
+      opts.log_enabled = 1;
+      strncpy(opts.log_file, optarg, FILEN_LENGTH);
+      break;
+    case 'V':
+      printf(WAVSILENCE_VERSION "\n");
+      exit(1);
+      break;
+    case 'i':
+      opts.read_from_file = 1;
+      strncpy(opts.input_file, optarg, FILEN_LENGTH);
+      break;
+    case 'b':
+      opts.buffer_amt = atoi(optarg);
+      if(opts.buffer_amt <= 0) {
+	printf("Invalid Buffer amount!\n");
+	exit(1);
+      }
+
+      break;
+    case 'P':
+      opts.pipe_enabled = 1;
+      strncpy(opts.pipe_cmd, optarg, FILEN_LENGTH);
+      break;
+    case 'L':
+      opts.pipe_lookahead = atoi(optarg);
+      if(opts.pipe_lookahead < 0) {
+	printf("Invalid lookahead size!\n");
+	exit(1);
+      }
+      break;
+    case 'n':
+      set_name(optarg);
+      opts.named = 1;
+      break;
+    case 'e':
+      opts.exec_enabled = 1;
+      strncpy(opts.exec_cmd, optarg, FILEN_LENGTH);
+      break;
+    case 'r':
+      opts.remove_after_exec = 1;
+      break;
+    case 'D':
+      if(!strcmp(optarg, "rms"))
+	opts.envelope = ENV_RMS;
+      else if(!strcmp(optarg, "peak"))
+	opts.envelope = ENV_PEAK;
+      else if(!strcmp(optarg, "sample"))
+	opts.envelope = 0;
+      else {
+	printf("Invalid detector!\n");
+	exit(1);
+      }
+      break;
+    case 'W':
+      opts.window = atof(optarg);
+      if(opts.window <= 0) {
+	printf("Invalid window!\n");
+	exit(1);
+      }
+      break;
+    case 'E':
+      opts.loud_threshold = atof(optarg) / 100.0;
+      if(opts.loud_threshold <= 0) {
+	printf("Invalid threshold value!\n");
+	exit(1);
+      }
+      break;
+    case 'k':
+      if(!strcmp(optarg, "all"))
+	opts.channel_policy = CHANNELS_ALL;
+      else if(!strcmp(optarg, "any"))
+	opts.channel_policy = CHANNELS_ANY;
+      else {
+	opts.channel_policy = atoi(optarg) - 1;
+	if((opts.channel_policy < 0) || (opts.channel_policy >= MAX_CHANNELS)) {
+	  printf("Invalid channel!\n");
+	  exit(1);
+	}
+      }
+      break;
+    case 'K':
+      opts.kernel_copy = 1;
+      break;
+    case 'X':
+      opts.exhaustive = 1;
+      break;
+    case 'S':
+      if(!sweep_parse(&opts.sweep, optarg)) {
+	printf("Invalid sweep (<thresholds>/<gaps>/<min lengths>, each a\n"
+	       "list of at most %i values)!\n", MAX_SWEEP);
+	exit(1);
+      }
+      opts.sweeping = 1;
+      break;
+    case 'A':
+      if(opts.manifests == MAX_MANIFESTS) {
+	printf("At most %i manifests!\n", MAX_MANIFESTS);
+	exit(1);
+      }
+      if(!manifest_format(optarg)) {
+	printf("Invalid manifest name (.json, .csv or .cue)!\n");
+	exit(1);
+      }
+      strncpy(opts.manifest_file[opts.manifests++], optarg, FILEN_LENGTH - 1);
+      break;
+    case 'a':
+      opts.preroll = atof(optarg);
+      if(opts.preroll < 0) {
+	printf("Invalid pre-roll!\n");
+	exit(1);
+      }
+      break;
+    case 'T':
+      strncpy(opts.stats_file, optarg, FILEN_LENGTH - 1);
+      break;
+    case 'C':
+      strncpy(opts.trace_file, optarg, FILEN_LENGTH - 1);
+      break;
+    case 'J':
+      opts.max_hooks = atoi(optarg);
+      if(opts.max_hooks <= 0) {
+	printf("Invalid number of commands!\n");
+	exit(1);
+      }
+      break;
+    case 'H':
+      opts.max_length = atof(optarg);
+      if(opts.max_length <= 0) {
+	printf("Invalid maximum piece length!\n");
+	exit(1);
+      }
+      break;
+    case 'Z':
+      strncpy(opts.live_file, optarg, FILEN_LENGTH - 1);
+      break;
+    case 'm':
+      opts.min_track_length += atof(optarg);
+      break;
+    case 'M':
+      opts.min_track_length += (60 * atof(optarg));
+      break;
+    case 'N':
+      opts.natural = 1;
+      break;
+    case 's':
+      opts.skip_silence = 1;
+      break;
+    case 'c':
+      opts.counter_start = atoi(optarg);
+      break;
+    case 'x':
+      opts.use_index = 1;
+      break;
+    case 'R':
+      opts.ring_depth = atoi(optarg);
+      if(opts.ring_depth < 2) {
+	printf("Invalid number of ring buffers (at least 2)!\n");
+	exit(1);
+      }
+      break;
+    case 'B':
+      opts.ring_buffer_kb = atoi(optarg);
+      if(opts.ring_buffer_kb <= 0) {
+	printf("Invalid ring buffer size!\n");
+	exit(1);
+      }
+      break;
+    case 'w':
+      opts.workers = atoi(optarg);
+      if((opts.workers <= 0) || (opts.workers > MAX_WORKERS)) {
+	printf("Invalid number of workers (1-%i)!\n", MAX_WORKERS);
+	exit(1);
+      }
+      break;
+    case 'F':
+      strncpy(opts.list_file, optarg, FILEN_LENGTH - 1);
+      break;
+    case 'j':
+      opts.jobs = atoi(optarg);
+      if((opts.jobs <= 0) || (opts.jobs > MAX_JOBS)) {
+	printf("Invalid number of jobs (1-%i)!\n", MAX_JOBS);
+	exit(1);
+      }
+      break;
+
+      // DEFAULT
+    default:
+    case 'h':
+      print_usage();
+      break;
+    }
+  }
+
+    return;    
+
+}
+
+void print_params() {
+
+  printf("Minimum Gap: %.2f s\n", opts.gap);
+  printf("Minimum Track Length: %.2f s\n", opts.min_track_length);
+  printf("Override Gap: %.2f s\n", opts.override);
   printf("Threshold: %.0f %%\n", opts.threshold * 100);
   printf("Verbosity: %i\n", debug_level);
   printf("Buffer: %i samples\n", opts.buffer_amt);
 }
 
 
-int open_input_file() {
+int open_input_file(struct ws_job* job) {
 
   int fd;
 
   if(debug_level >=VERBOSE)
-    printf("Opened file %s for input\n", opts.input_file);
+    printf("Opened file %s for input\n", job->opts.input_file);
 
-  fd = open(opts.input_file, O_RDONLY);
+  fd = open(job->opts.input_file, O_RDONLY);
 
-  if(fd == -1) {
-    perror("input file");
-    exit(1);
-  }
+  if(fd == -1)
+    perror(job->opts.input_file);
 
   return fd;
 }
 
-int main(int argc, char**argv) {
-  
+// Splits one input.  Returns 0 on success.
+int run_job(struct ws_job* job) {
+
   struct wav_file_headers wav_headers;
+  struct ws_index index;
+  struct ws_index *ix = NULL;
+  struct ws_detector detector;
+  struct stat st;
+  off_t data_offset;
   int input_fd;
+  int ret = 0;
+
+  job->fd = NULL;
+  job->counter = job->opts.counter_start; // loescher 07/06/04
+
+  if(job->opts.read_from_file) {
+    input_fd = open_input_file(job);
+    if(input_fd == -1)
+      return 1;
+  } else
+    input_fd = 0; // STDIN
+
+  // Pipes can't seek back, so the samples read past the headers are kept
+  job->header_buffer = malloc(sizeof(*job->header_buffer));
+  if(!job->header_buffer ||
+     !read_headers(input_fd, &wav_headers, job->header_buffer)) {
+    free(job->header_buffer);
+    job->header_buffer = NULL;
+    if(job->opts.read_from_file)
+      close(input_fd);
+    return 1;
+  }
+
+  // Check these before any piece is written
+  if(!detect_init(&detector, job->opts.threshold,
+		  wav_headers.format, wav_headers.fmt.BitsPerSample)) {
+    printf("%s: Can't detect silence in %i-bit samples of format %i\n",
+	   job->opts.read_from_file ? job->opts.input_file : "stdin",
+	   wav_headers.fmt.BitsPerSample, wav_headers.format);
+    ret = 1;
+  }
+
+  if(job->opts.envelope && !ret) {
+    if(envelope_init(&job->job_envelope, job->opts.envelope,
+		     job->opts.window * wav_headers.fmt.SampleRate / 1000,
+		     job->opts.threshold, job->opts.loud_threshold,
+		     wav_headers.format, wav_headers.fmt.BitsPerSample,
+		     wav_headers.fmt.NumChannels))
+      job->envelope = &job->job_envelope;
+    else
+      ret = 1;
+  }
+
+  if((job->opts.channel_policy != CHANNELS_ALL) && !ret) {
+    if(channels_init(&job->job_channels, job->opts.channel_policy,
+		     wav_headers.fmt.NumChannels))
+      job->channels = &job->job_channels;
+    else {
+      printf("%s: Has no channel %i\n",
+	     job->opts.read_from_file ? job->opts.input_file : "stdin",
+	     job->opts.channel_policy + 1);
+      ret = 1;
+    }
+  }
+
+  if(job->opts.use_index &&
+     (!job->opts.read_from_file || (wav_headers.fmt.BitsPerSample != 16))) {
+    printf("The index needs 16-bit input from a file (-i)\n");
+    ret = 1;
+  }
+
+  if(job->opts.live_file[0] && !ret) {
+    if(live_open(&job->job_live, job->opts.live_file,
+		 wav_headers.fmt.SampleRate))
+      job->live = &job->job_live;
+    else
+      ret = 1;
+  }
+
+  if(ret) {
+    free(job->header_buffer);
+    job->header_buffer = NULL;
+    if(job->opts.read_from_file)
+      close(input_fd);
+    return ret;
+  }
+
+  if((fstat(input_fd, &st) == 0) && S_ISREG(st.st_mode))
+    job->bytes = st.st_size;
+
+  // Pieces of an input that may hold 4 GB of data get room for a ds64
+  // chunk, so they can become RF64.  That is any pipe: streaming writers
+  // put a placeholder in the data size, so its real length is unknown.
+  if((wav_headers.riff.header.id == RF64_CHUNK_ID) ||
+     (wav_headers.data_size >= RF64_SIZE - MAX_HEADER_SIZE) ||
+     !S_ISREG(st.st_mode) || (st.st_size >= RF64_SIZE - MAX_HEADER_SIZE))
+    reserve_ds64(&wav_headers);
+
+  if(job->opts.log_enabled)
+    start_log_file(job, &wav_headers);
+
+  if((job->opts.stats_file[0] || job->opts.trace_file[0]) &&
+     stats_init(&job->job_stats, job->opts.trace_file[0]))
+    job->stats = &job->job_stats;
+
+  if(job->opts.show_file_info)
+    print_format_info(&wav_headers.fmt);
+
+  if(job->opts.pipe_lookahead >= 0) {
+    spool_init(&job->piece_spool,
+	       (size_t)job->opts.pipe_lookahead * 1024 * 1024);
+    job->spool = &job->piece_spool;
+  }
+
+  // -K copies ranges of a file; anything else is split the usual way
+  if(job->opts.kernel_copy && !S_ISREG(st.st_mode)) {
+    if(debug_level >= VERBOSE)
+      printf("Input is not a file, not copying in the kernel\n");
+    job->opts.kernel_copy = 0;
+  }
+
+  // Pieces are written through io_uring when it is built in and works;
+  // live pieces go out a block at a time through stdio
+  if(!job->opts.pipe_enabled && !job->opts.kernel_copy && !job->live &&
+     writer_init(&job->out_writer))
+    job->writer = &job->out_writer;
+
+  if(debug_level >= VERYVERBOSE)
+    printf("output: %s\n", job->writer ? "io_uring" : "stdio");
+
+  if(job->opts.use_index) {
+
+    data_offset = lseek(input_fd, 0, SEEK_CUR);
+
+    if(index_open(&index, job->opts.input_file, input_fd, data_offset,
+		  &wav_headers)) {
+      if(!job->opts.kernel_copy)
+	start_new_file(job, &wav_headers, 0, 0);
+      process_index(job, &wav_headers, input_fd, &index);
+      goto done;
+    }
+
+    // -j and -K use an index, but don't build one
+    if((job->opts.jobs > 1) || job->opts.kernel_copy)
+      fprintf(stderr, "Warning: no index of %s is written with -j or -K; "
+	      "run with -x alone to make one\n", job->opts.input_file);
+    else if(index_create(&index, job->opts.input_file, input_fd, data_offset,
+			 &wav_headers))
+      ix = &index;
+  }
+
+  if((job->opts.jobs > 1) || job->opts.kernel_copy) {
+
+    data_offset = lseek(input_fd, 0, SEEK_CUR);
+
+    if((data_offset != -1) && S_ISREG(st.st_mode)) {
+      if(!job->opts.kernel_copy)
+	start_new_file(job, &wav_headers, 0, 0);
+      process_scan(job, &wav_headers, input_fd, data_offset,
+		   st.st_size - data_offset);
+      goto done;
+    }
+
+    if(debug_level >= VERBOSE)
+      printf("Input is not seekable, scanning with one thread\n");
+  }
+
+  if(job->opts.sweeping) {
+    process_sweep(job, &wav_headers, input_fd);
+    goto done;
+  }
+
+  if(job->opts.manifests) {
+    process_analyze(job, &wav_headers, input_fd,
+		    lseek(input_fd, 0, SEEK_CUR));
+    goto done;
+  }
+
+  start_new_file(job, &wav_headers, 0, 0);
+
+  if(job->opts.ring_depth)
+    process_pipeline(job, &wav_headers, input_fd, ix);
+  else if(job->opts.preroll >= 0)
+    process_trimmed(job, &wav_headers, input_fd);
+  else
+    process_data(job, &wav_headers, input_fd, ix);
+
+ done:
+  job->pieces = job->counter - job->opts.counter_start;
+
+  if(job->stats) {
+    if(job->opts.stats_file[0])
+      stats_write_json(job->stats, job->opts.stats_file,
+		       job->opts.read_from_file ? job->opts.input_file : "stdin",
+		       wav_headers.fmt.SampleRate);
+    if(job->opts.trace_file[0])
+      stats_write_trace(job->stats, job->opts.trace_file);
+    stats_free(job->stats);
+  }
+
+  if(job->envelope) {
+    envelope_free(job->envelope);
+    job->envelope = NULL;
+  }
+  job->channels = NULL;
+
+  if(job->live) {
+    live_close(job->live);
+    job->live = NULL;
+  }
+
+  if(job->logfp)
+    fclose(job->logfp);
+
+  free(job->header_buffer);
+  job->header_buffer = NULL;
+
+  if(job->opts.read_from_file)
+    close(input_fd);
+
+  return ret;
+}
+
+// Names a file of a batch job after its input; returns 0 if it won't fit
+int batch_name(char* name, const char* base, const char* file) {
+
+  return snprintf(name, FILEN_LENGTH, "%s-%s", base, file) < FILEN_LENGTH;
+
+}
+
+// Sets job up for input number n of several: the pieces and the log are
+// named after the input, so the jobs don't overwrite each other.  Returns
+// 0 if a name would be too long.
+int batch_job(struct ws_job* job, const char* input, const char* base) {
+
+  int i, ok;
+
+  memset(job, 0, sizeof(*job));
+  job->opts = opts;
+  job->hooks = &hooks;
+  job->opts.read_from_file = 1;
+  strncpy(job->opts.input_file, input, FILEN_LENGTH - 1);
+
+  ok = batch_name(job->opts.piece_name, base, "%03i.wav");
+
+  if(opts.log_enabled)
+    ok &= batch_name(job->opts.log_file, base, opts.log_file);
+  if(opts.stats_file[0])
+    ok &= batch_name(job->opts.stats_file, base, opts.stats_file);
+  if(opts.trace_file[0])
+    ok &= batch_name(job->opts.trace_file, base, opts.trace_file);
+  for(i = 0; i < opts.manifests; i++)
+    ok &= batch_name(job->opts.manifest_file[i], base, opts.manifest_file[i]);
+
+  if(!ok)
+    fprintf(stderr, "%s: The names of its pieces or files would be longer "
+	    "than %i characters\n", input, FILEN_LENGTH - 1);
+
+  return ok;
+}
+
+// The inputs of a batch, and the next one a worker should take
+struct ws_batch {
+
+  char **inputs;
+  int count;
+  int next;
+  pthread_mutex_t lock;
+
+  struct ws_job *jobs;
+  char (*bases)[FILEN_LENGTH];	// What each input's pieces are named after
+
+};
+
+// The name of the input without its directory and extension
+void input_base(const char* input, char* base) {
 
-  // Initialization
-  //  counter = 0; // loescher 07/06/04
-  fd = NULL;
+  const char *p;
+  char *dot;
+
+  p = strrchr(input, '/');
+  strncpy(base, p ? p + 1 : input, FILEN_LENGTH - 32);
+  base[FILEN_LENGTH - 32] = '\0';
+  if((dot = strrchr(base, '.')) != NULL)
+    *dot = '\0';
+
+}
+
+// Names the pieces of each input after it.  Inputs of the same name (in
+// different directories) would write the same pieces, so each of them
+// gets "_<n>" added, in the order given, skipping names already taken.
+void batch_names(struct ws_batch* batch) {
+
+  char (*names)[FILEN_LENGTH];
+  int i, j, k, dups, taken;
+
+  names = malloc(batch->count * sizeof(*names));
+  if(names == NULL) {
+    fprintf(stderr, "Could not allocate %i names\n", batch->count);
+    exit(1);
+  }
+
+  for(i = 0; i < batch->count; i++) {
+    input_base(batch->inputs[i], names[i]);
+    strcpy(batch->bases[i], names[i]);
+  }
+
+  for(i = 0; i < batch->count; i++) {
+
+    for(dups = 0, j = 0; (j < batch->count) && !dups; j++)
+      dups = (j != i) && (strcmp(names[i], names[j]) == 0);
+
+    if(!dups)
+      continue;
+
+    for(k = 1; ; k++) {
+      snprintf(batch->bases[i], FILEN_LENGTH, "%s_%i", names[i], k);
+      for(taken = 0, j = 0; (j < batch->count) && !taken; j++)
+	taken = (j != i) && (strcmp(batch->bases[i], batch->bases[j]) == 0);
+      if(!taken)
+	break;
+    }
+
+    printf("%s: pieces named %s-N.wav, as another input is named %s too\n",
+	   batch->inputs[i], batch->bases[i], names[i]);
+  }
+
+  free(names);
+
+}
+
+void *batch_worker(void *arg) {
+
+  struct ws_batch *batch = arg;
+  struct ws_job *job;
+  int n;
+
+  for(;;) {
+    pthread_mutex_lock(&batch->lock);
+    n = batch->next++;
+    pthread_mutex_unlock(&batch->lock);
+
+    if(n >= batch->count)
+      return NULL;
+
+    job = &batch->jobs[n];
+    if(!batch_job(job, batch->inputs[n], batch->bases[n])) {
+      job->failed = 1;
+      continue;
+    }
+
+    if(debug_level >= VERBOSE)
+      printf("Splitting %s\n", job->opts.input_file);
+
+    job->failed = run_job(job);
+  }
+}
+
+// Reads the input names from -F, one per line
+int read_list(const char* list, char*** inputs, int* count) {
+
+  char line[FILEN_LENGTH];
+  char **names = NULL;
+  int size = 0;
+  FILE *fp;
+  int len;
+
+  fp = strcmp(list, "-") ? fopen(list, "r") : stdin;
+  if(fp == NULL) {
+    perror(list);
+    return 0;
+  }
+
+  while(fgets(line, sizeof(line), fp)) {
+    len = strlen(line);
+    while((len > 0) && ((line[len-1] == '\n') || (line[len-1] == '\r')))
+      line[--len] = '\0';
+    if(len == 0)
+      continue;
+
+    if(*count == size) {
+      size = size ? size * 2 : 64;
+      names = realloc(*inputs, size * sizeof(*names));
+      if(names == NULL) {
+	fprintf(stderr, "Could not allocate the input list\n");
+	return 0;
+      }
+      *inputs = names;
+    }
+    (*inputs)[(*count)++] = strdup(line);
+  }
+
+  if(fp != stdin)
+    fclose(fp);
+
+  return 1;
+}
+
+// Splits every input on a pool of opts.workers threads
+int run_batch(char** args, int nargs) {
+
+  struct ws_batch batch;
+  pthread_t threads[MAX_WORKERS];
+  struct timespec start, end;
+  unsigned long long bytes = 0;
+  unsigned int pieces = 0;
+  int workers, failed = 0, i;
+  double elapsed;
+
+  memset(&batch, 0, sizeof(batch));
+  pthread_mutex_init(&batch.lock, NULL);
+
+  if(opts.list_file[0]) {
+    if(!read_list(opts.list_file, &batch.inputs, &batch.count))
+      return 1;
+  }
+
+  if(nargs > 0) {
+    batch.inputs = realloc(batch.inputs,
+			   (batch.count + nargs) * sizeof(*batch.inputs));
+    for(i = 0; i < nargs; i++)
+      batch.inputs[batch.count++] = args[i];
+  }
+
+  if(batch.count == 0) {
+    printf("No input files\n");
+    return 1;
+  }
+
+  batch.jobs = calloc(batch.count, sizeof(*batch.jobs));
+  batch.bases = calloc(batch.count, sizeof(*batch.bases));
+  if((batch.jobs == NULL) || (batch.bases == NULL)) {
+    fprintf(stderr, "Could not allocate %i jobs\n", batch.count);
+    return 1;
+  }
+
+  batch_names(&batch);
+
+  workers = opts.workers;
+  if(workers > batch.count)
+    workers = batch.count;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for(i = 0; i < workers; i++)
+    if(pthread_create(&threads[i], NULL, batch_worker, &batch) != 0) {
+      fprintf(stderr, "Could not start worker %i\n", i);
+      workers = i;
+      break;
+    }
+
+  // With no worker at all, do it here
+  if(workers == 0)
+    batch_worker(&batch);
+
+  for(i = 0; i < workers; i++)
+    pthread_join(threads[i], NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  for(i = 0; i < batch.count; i++) {
+    if(batch.jobs[i].failed) {
+      failed++;
+      continue;
+    }
+    bytes += batch.jobs[i].bytes;
+    pieces += batch.jobs[i].pieces;
+  }
+
+  printf("Split %i of %i files into %u pieces with %i workers: "
+	 "%.1f MB in %.2f s (%.1f MB/s)\n",
+	 batch.count - failed, batch.count, pieces, workers,
+	 bytes / 1048576.0, elapsed,
+	 elapsed > 0 ? bytes / 1048576.0 / elapsed : 0);
+
+  free(batch.jobs);
+  free(batch.bases);
+
+  return failed ? 1 : 0;
+}
+
+// Before any other thread starts, so none of them takes SIGCHLD
+void start_hooks() {
+
+  if(!opts.exec_enabled)
+    return;
+
+  hooks_block_sigchld();
+  if(!hooks_init(&hooks, opts.max_hooks))
+    exit(1);
+
+}
+
+int main(int argc, char**argv) {
+  
+  struct ws_job job;
+  int ret;
 
   // Defaults
   opts.threshold = 0.03;
@@ -615,40 +2585,141 @@ int main(int argc, char**argv) {
   opts.read_from_file = 0;
   opts.buffer_amt = 1;
   opts.pipe_enabled = 0;
+  opts.pipe_lookahead = -1;
   opts.exec_enabled = 0;
   opts.remove_after_exec = 0;
+  opts.max_hooks = sysconf(_SC_NPROCESSORS_ONLN);
+  if(opts.max_hooks < 1)
+    opts.max_hooks = 1;
   strncpy(opts.piece_name, DEFAULT_NAME, FILEN_LENGTH);
   debug_level = 0;
   opts.min_track_length = 0;
   opts.natural = 0;
   opts.skip_silence = 0; // loescher 06/06/04
   opts.counter_start = 0; // loescher 07/06/04
+  opts.use_index = 0;
+  opts.jobs = 1;
+  opts.ring_depth = 0;
+  opts.ring_buffer_kb = 1024;
+  opts.workers = sysconf(_SC_NPROCESSORS_ONLN);
+  if((opts.workers < 1) || (opts.workers > MAX_WORKERS))
+    opts.workers = (opts.workers < 1) ? 1 : MAX_WORKERS;
+  opts.list_file[0] = '\0';
+  opts.stats_file[0] = '\0';
+  opts.preroll = -1;
+  opts.channel_policy = CHANNELS_ALL;
+  opts.window = 50;
+  opts.loud_threshold = -1;
+  opts.trace_file[0] = '\0';
+  opts.named = 0;
+  opts.max_length = 0;
+  opts.live_file[0] = '\0';
 
   process_args(argc, argv);
 
-  // loescher 07/06/04
-  counter = opts.counter_start;
-
   if(debug_level >= VERBOSE)
     print_params();
 
-  if(opts.read_from_file)
-    input_fd = open_input_file();
-  else
-    input_fd = 0; // STDIN
+  if((opts.pipe_lookahead >= 0) && !opts.pipe_enabled) {
+    printf("-L only works with -P\n");
+    exit(1);
+  }
 
-   if (!process_headers(input_fd, &wav_headers))
-      return 1;
+  if(opts.loud_threshold < 0)
+    opts.loud_threshold = opts.threshold;
 
-  if(opts.log_enabled)
-    start_log_file(&wav_headers);
+  if(opts.loud_threshold < opts.threshold) {
+    printf("-E can't be below -t\n");
+    exit(1);
+  }
 
-  if(opts.show_file_info)
-    print_format_info(&wav_headers.fmt);
+  if(opts.envelope && (opts.use_index || (opts.jobs > 1))) {
+    printf("-D %s can't be used with -x or -j\n",
+	   (opts.envelope == ENV_RMS) ? "rms" : "peak");
+    exit(1);
+  }
+
+  if((opts.channel_policy != CHANNELS_ALL) &&
+     (opts.use_index || (opts.jobs > 1) || opts.envelope)) {
+    printf("-k can't be used with -x, -j or -D rms/peak\n");
+    exit(1);
+  }
+
+  if(opts.kernel_copy &&
+     (opts.pipe_enabled || opts.ring_depth || (opts.preroll >= 0) ||
+      opts.manifests || opts.envelope ||
+      (opts.channel_policy != CHANNELS_ALL))) {
+    printf("-K can't be used with -P, -R, -a, -A, -D rms/peak or -k\n");
+    exit(1);
+  }
+
+  if(opts.sweeping &&
+     (opts.use_index || (opts.jobs > 1) || opts.ring_depth ||
+      (opts.preroll >= 0) || opts.pipe_enabled || opts.exec_enabled ||
+      opts.manifests || opts.kernel_copy || opts.envelope ||
+      (opts.channel_policy != CHANNELS_ALL))) {
+    printf("-S can't be used with -x, -j, -R, -a, -P, -e, -A, -K, -D rms/peak\n"
+	   "or -k\n");
+    exit(1);
+  }
+
+  if(opts.manifests &&
+     (opts.use_index || (opts.jobs > 1) || opts.ring_depth ||
+      (opts.preroll >= 0) || opts.pipe_enabled || opts.exec_enabled)) {
+    printf("-A can't be used with -x, -j, -R, -a, -P or -e\n");
+    exit(1);
+  }
+
+  if((opts.preroll >= 0) &&
+     (opts.use_index || (opts.jobs > 1) || opts.ring_depth)) {
+    printf("-a can't be used with -x, -j or -R\n");
+    exit(1);
+  }
+
+  if(opts.max_length && ((opts.preroll >= 0) || opts.sweeping)) {
+    printf("-H can't be used with -a or -S\n");
+    exit(1);
+  }
+
+  if(opts.live_file[0] &&
+     (opts.use_index || (opts.jobs > 1) || opts.ring_depth ||
+      (opts.preroll >= 0) || (opts.pipe_lookahead >= 0) || opts.manifests ||
+      opts.sweeping || opts.kernel_copy)) {
+    printf("-Z can't be used with -x, -j, -R, -a, -L, -A, -S or -K\n");
+    exit(1);
+  }
+
+  if((strcmp(opts.live_file, "-") == 0) && opts.show_progress) {
+    printf("-Z - can't be used with -p\n");
+    exit(1);
+  }
+
+  // Several inputs
+  if((optind < argc) || opts.list_file[0]) {
+    if(opts.live_file[0]) {
+      printf("-Z can't be used with several inputs\n");
+      exit(1);
+    }
+    if(opts.read_from_file || opts.named) {
+      printf("-i and -n can't be used with several inputs; the pieces of\n"
+	     "each input are named after it\n");
+      exit(1);
+    }
+    start_hooks();
+    ret = run_batch(argv + optind, argc - optind);
+    hooks_stop(&hooks);
+    return ret;
+  }
+
+  start_hooks();
+
+  memset(&job, 0, sizeof(job));
+  job.opts = opts;
+  job.hooks = &hooks;
 
-  start_new_file(&wav_headers, 0, 0);
+  ret = run_job(&job);
 
-  process_data(&wav_headers, input_fd);
+  hooks_stop(&hooks);
 
-  return 0;
+  return ret;
 }
@@ -41,15 +41,24 @@
 #ifndef _WAVSILENCE_H
 #define _WAVSILENCE_H
 
+#include <stdio.h>
+
+#include "wavheader.h"
+#include "wavuring.h"
+#include "wavspool.h"
+#include "wavhook.h"
+#include "wavstats.h"
+#include "wavlookback.h"
+#include "wavenvelope.h"
+#include "wavmanifest.h"
+#include "wavcopy.h"
+#include "wavsweep.h"
+#include "wavlive.h"
+
 #define VERBOSE         1
 #define VERYVERBOSE     2
 #define INSANELYVERBOSE 3
 
-// These should be fine for all WAV files
-#define CHUNK0_OFFSET   4
-#define CHUNK1_OFFSET   16
-#define CHUNK2_OFFSET   40
-
 #define FILEN_LENGTH    256
 #define SIZE_LENGTH     256
 #define DATE_LENGTH     256
@@ -57,15 +66,23 @@
 
 #define PROG_MULT       700
 
+#define COPY_SIZE       (1024 * 1024)
+
 #define DEFAULT_NAME	"piece-%03i.wav"
 
+#define MAX_WORKERS     64
+
 /* GAP is the calculated number of samples for opts.gap seconds */
-#define GAP ((int)(wav_headers->fmt.SampleRate * opts.gap * wav_headers->fmt.NumChannels))
-#define OVERRIDE ((int)(wav_headers->fmt.SampleRate * opts.override * wav_headers->fmt.NumChannels))
+#define GAP ((long long)(wav_headers->fmt.SampleRate * job->opts.gap * wav_headers->fmt.NumChannels))
+#define OVERRIDE ((long long)(wav_headers->fmt.SampleRate * job->opts.override * wav_headers->fmt.NumChannels))
 
 struct ws_opts {
 
   float threshold;
+  int envelope;		// -D, ENV_RMS or ENV_PEAK; 0 for single samples
+  double window;	// -W, in ms
+  float loud_threshold;	// -E
+  int channel_policy;	// -k, CHANNELS_ALL, CHANNELS_ANY or a channel
   double gap;
   double override;	/* tblough 5/23/04 */
   int sample_width;
@@ -76,18 +93,71 @@ struct ws_opts {
   int exec_enabled;
   char exec_cmd[FILEN_LENGTH];
   int remove_after_exec;
+  int max_hooks;		// -J, -e commands run at once
   int show_progress;
   int log_enabled;
   char log_file[FILEN_LENGTH];
   int buffer_amt;
   char pipe_cmd[FILEN_LENGTH];
   int pipe_enabled;
+  int pipe_lookahead;	// -L, in MB; -1 if off
   char piece_name[FILEN_LENGTH];
+  int named;		// -n was given
   float min_track_length;
   int natural;	/* tblough 5/25/04 */
   int skip_silence; // loescher 06/06/04
+  double preroll;	// -a, in seconds; -1 if off
   int counter_start; // loescher 07/06/04
+  int use_index;
+  int jobs;
+  int ring_depth;	// -R, 0 if not pipelined
+  int ring_buffer_kb;
+  int workers;		// -w, for several inputs
+  char list_file[FILEN_LENGTH];	// -F
+  char stats_file[FILEN_LENGTH];	// -T, empty if off
+  char trace_file[FILEN_LENGTH];	// -C, empty if off
+  char manifest_file[MAX_MANIFESTS][FILEN_LENGTH];	// -A
+  int manifests;
+  int kernel_copy;	// -K
+  int exhaustive;	// -X, no coarse scan
+  struct ws_sweep_lists sweep;	// -S
+  int sweeping;
+  double max_length;	// -H, 0 if off
+  char live_file[FILEN_LENGTH];	// -Z, empty if off
 
 } opts;
 
+// Everything one input needs while it is split.  With several inputs,
+// each worker thread has its own.
+struct ws_job {
+
+  struct ws_opts opts;	// The command line, with this input's names
+  int counter;
+  FILE* fd;
+  FILE* logfp;
+  struct ws_writer out_writer;
+  struct ws_writer* writer;	// Pieces go through io_uring if set
+  struct ws_spool piece_spool;
+  struct ws_spool* spool;	// -P pieces are held back here if set (-L)
+  struct wav_file_headers piece_headers;
+  int piece_opened;
+  struct ws_hooks* hooks;	// Shared by all jobs
+  struct ws_hook_list hook_list;	// This job's -e commands
+  struct ws_stats job_stats;
+  struct ws_stats* stats;	// Stage timers (-T, -C) if set
+  struct ws_envelope job_envelope;
+  struct ws_envelope* envelope;	// Windowed detector (-D) if set
+  struct ws_channels job_channels;
+  struct ws_channels* channels;	// Silence for each channel (-k) if set
+  struct ws_header_buffer* header_buffer;	// Input read with the headers
+  struct ws_live job_live;
+  struct ws_live* live;	// Piece events (-Z) if set
+
+  // Totals, for the batch summary
+  unsigned long long bytes;
+  unsigned int pieces;
+  int failed;
+
+};
+
 #endif
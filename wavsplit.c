@@ -0,0 +1,185 @@
+/*  wavsplit.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    The rules for where pieces start, moved out of process_data() so that
+    every way of finding the silence (scanning the data, or reading a saved
+    index) splits in exactly the same places.
+
+    The splitter is fed one block at a time, with the silence counter as it
+    stands after the block, and says whether the block starts a new piece and
+    whether it gets written.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavsplit.h"
+
+void split_init(struct ws_splitter *sp, long long gap, long long override,
+                float min_track_length, unsigned int sample_rate,
+                int skip_silence) {
+
+  memset(sp, 0, sizeof(*sp));
+
+  sp->gap = gap;
+  sp->override = override;
+  sp->min_track_length = min_track_length;
+  sp->sample_rate = sample_rate;
+  sp->skip_silence = skip_silence;
+
+  sp->min_length_flag = 1; /* Default is always split */
+
+}
+
+int split_feed(struct ws_splitter *sp, long long silence_counter,
+               int frames) {
+
+  int result = 0;
+
+  sp->silence_counter = silence_counter;
+
+  if(silence_counter == 0)
+    sp->silence_flag = 0;
+
+  if(sp->min_track_length > 0) {
+    /* Check to make sure we've seen enough samples before splitting */
+    if(sp->min_track_length <= (sp->file_sample_c / sp->sample_rate))
+      sp->min_length_flag = 1;
+    else
+      sp->min_length_flag = 0;
+  }
+
+  // tblough 5/23/04 - minimum track length override
+  sp->override_flag = (sp->override >= 0) && (silence_counter > sp->override);
+
+  if((silence_counter > sp->gap) && (! sp->silence_flag) &&
+     (sp->min_length_flag || sp->override_flag)) {
+    sp->silence_flag = 1;
+    sp->piece_sample_c = sp->file_sample_c;
+    sp->file_sample_c = 0;
+    result |= SPLIT_NEW_PIECE;
+  } else if((sp->max_frames > 0) && (sp->file_sample_c > 0) &&
+            (sp->file_sample_c + frames > sp->max_frames) &&
+            !(sp->skip_silence && sp->silence_flag)) {
+    // No gap came in time: cut anyway, unless the silence is being skipped
+    sp->piece_sample_c = sp->file_sample_c;
+    sp->file_sample_c = 0;
+    result |= SPLIT_NEW_PIECE | SPLIT_FORCED;
+  }
+
+  // Only write if we should not skip the silence and there is silence
+  // loescher 06/06/04
+  if(! (sp->skip_silence && sp->silence_flag))
+    result |= SPLIT_WRITE;
+
+  sp->file_sample_c += frames;
+
+  return result;
+}
+
+// Feeds a block as the detector saw it: the silence run continues through a
+// quiet block, and restarts after the last loud sample otherwise.
+int split_block(struct ws_splitter *sp, int any_loud, int tail, int count,
+                int frames) {
+
+  if(any_loud)
+    return split_feed(sp, tail, frames);
+  else
+    return split_feed(sp, sp->silence_counter + count, frames);
+
+}
+
+void plan_init(struct ws_plan *plan) {
+
+  plan->size = 16;
+  plan->pieces = malloc(plan->size * sizeof(*plan->pieces));
+  plan->count = 1;
+
+  memset(plan->pieces, 0, sizeof(*plan->pieces));
+  plan->pieces[0].start = -1;
+
+}
+
+// Records what split_feed() decided for the size bytes at offset.  Skipped
+// silence only ever comes straight after a split, so the bytes written to a
+// piece are always one contiguous range.
+int plan_add(struct ws_plan *plan, int result, off_t offset, int size,
+             int frames) {
+
+  struct ws_piece *p;
+
+  if(result & SPLIT_NEW_PIECE) {
+
+    if(plan->count == plan->size) {
+      plan->size *= 2;
+      p = realloc(plan->pieces, plan->size * sizeof(*plan->pieces));
+      if(p == NULL) {
+        fprintf(stderr, "plan: Out of memory (%i pieces)\n", plan->count);
+        return 0;
+      }
+      plan->pieces = p;
+    }
+
+    p = &plan->pieces[plan->count++];
+    memset(p, 0, sizeof(*p));
+    p->start = -1;
+  }
+
+  p = &plan->pieces[plan->count - 1];
+
+  if(result & SPLIT_WRITE) {
+    if(p->start == -1)
+      p->start = offset;
+    p->length += size;
+  }
+
+  p->sample_c += frames;
+
+  return 1;
+}
+
+void plan_finish(struct ws_plan *plan) {
+
+  int i;
+
+  // Pieces that were never written to start where they would have
+  for(i = 0; i < plan->count; i++)
+    if(plan->pieces[i].start == -1)
+      plan->pieces[i].start = (i > 0) ?
+        plan->pieces[i-1].start + plan->pieces[i-1].length : 0;
+
+}
+
+void plan_free(struct ws_plan *plan) {
+
+  free(plan->pieces);
+  plan->pieces = NULL;
+  plan->count = plan->size = 0;
+
+}
@@ -0,0 +1,94 @@
+/*  wavsplit.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_SPLIT_H
+#define WAV_SPLIT_H
+
+#include <sys/types.h>
+
+// split_feed() results
+#define SPLIT_NEW_PIECE 1     // Start a new piece with this block
+#define SPLIT_WRITE     2     // Write this block to the current piece
+#define SPLIT_FORCED    4     // The new piece is for max_frames, not silence
+
+struct ws_splitter {
+
+  // Parameters
+  long long gap;              // GAP, in samples
+  long long override;         // OVERRIDE, in samples; -1 if not enabled
+  float min_track_length;     // Seconds
+  unsigned int sample_rate;
+  int skip_silence;
+  long long max_frames;       // Longest piece; 0 for no limit (after init)
+
+  // State
+  long long silence_counter;
+  int silence_flag;
+  int min_length_flag;
+  int override_flag;
+  long long file_sample_c;    // Frames in the current piece
+  long long piece_sample_c;   // Frames in the piece that was just closed
+
+};
+
+// A piece of the data chunk, as planned from an index (or a scan) before
+// anything is written
+struct ws_piece {
+
+  off_t start;                // Offset of the first written byte in the data
+  off_t length;               // Bytes written
+  long long sample_c;         // Frames covered, including skipped silence
+
+};
+
+struct ws_plan {
+
+  struct ws_piece *pieces;
+  int count;
+  int size;
+
+};
+
+// Functions
+
+void split_init(struct ws_splitter *sp, long long gap, long long override,
+                float min_track_length, unsigned int sample_rate,
+                int skip_silence);
+
+int split_feed(struct ws_splitter *sp, long long silence_counter,
+               int frames);
+
+int split_block(struct ws_splitter *sp, int any_loud, int tail, int count,
+                int frames);
+
+void plan_init(struct ws_plan *plan);
+int plan_add(struct ws_plan *plan, int result, off_t offset, int size,
+             int frames);
+void plan_finish(struct ws_plan *plan);
+void plan_free(struct ws_plan *plan);
+
+#endif
@@ -0,0 +1,166 @@
+/*  wavspool.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Lookahead for -P (see -L).  A piped piece can't be seeked back to, so
+    its header has to be right before the first byte goes out.  The piece is
+    kept here until it ends; the memory part grows as needed up to the limit
+    and anything past that goes to a tmpfile(), so a long piece costs disk
+    space rather than RAM.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wavspool.h"
+
+#define SPOOL_COPY      (1024 * 1024)
+
+void spool_init(struct ws_spool *sp, size_t limit) {
+
+  memset(sp, 0, sizeof(*sp));
+  sp->limit = limit;
+
+}
+
+// Returns 0 on error
+int spool_write(struct ws_spool *sp, const void *data, size_t size) {
+
+  size_t count, want;
+  unsigned char *buffer;
+
+  // Whatever fits in memory
+  if(sp->spilled == 0) {
+    count = sp->limit - sp->used;
+    if(count > size)
+      count = size;
+
+    if(sp->used + count > sp->allocated) {
+      want = sp->allocated ? sp->allocated : 64 * 1024;
+      while(want < sp->used + count)
+        want *= 2;
+      if(want > sp->limit)
+        want = sp->limit;
+      buffer = realloc(sp->buffer, want);
+      if(buffer == NULL) {
+        fprintf(stderr, "spool: Could not allocate %lu bytes\n",
+                (unsigned long)want);
+        return 0;
+      }
+      sp->buffer = buffer;
+      sp->allocated = want;
+    }
+
+    memcpy(sp->buffer + sp->used, data, count);
+    sp->used += count;
+    data = (const unsigned char *)data + count;
+    size -= count;
+  }
+
+  if(size == 0)
+    return 1;
+
+  // The rest goes to disk
+  if(sp->spill == NULL) {
+    sp->spill = tmpfile();
+    if(sp->spill == NULL) {
+      fprintf(stderr, "spool: Could not create a temporary file. "
+              "Error = %d.\n", errno);
+      return 0;
+    }
+  }
+
+  if(fwrite(data, size, 1, sp->spill) != 1) {
+    fprintf(stderr, "spool: Error writing the temporary file. Error = %d.\n",
+            errno);
+    return 0;
+  }
+
+  sp->spilled += size;
+  if(sp->spilled > sp->peak_spilled)
+    sp->peak_spilled = sp->spilled;
+
+  return 1;
+}
+
+// Writes the held piece to out and empties the spool.  Returns 0 on error.
+int spool_drain(struct ws_spool *sp, FILE *out) {
+
+  unsigned char *copy;
+  size_t count;
+  int ok = 1;
+
+  if(sp->used && (fwrite(sp->buffer, sp->used, 1, out) != 1))
+    ok = 0;
+
+  sp->used = 0;
+
+  if(sp->spill == NULL)
+    return ok;
+
+  // Reuse the memory part as the copy buffer if there is one
+  copy = sp->buffer;
+  count = sp->allocated;
+  if(copy == NULL) {
+    copy = malloc(SPOOL_COPY);
+    count = SPOOL_COPY;
+  }
+
+  rewind(sp->spill);
+
+  while(ok && (copy != NULL) && sp->spilled) {
+    if(count > sp->spilled)
+      count = sp->spilled;
+    if((fread(copy, count, 1, sp->spill) != 1) ||
+       (fwrite(copy, count, 1, out) != 1))
+      ok = 0;
+    sp->spilled -= count;
+  }
+
+  if(copy == NULL)
+    ok = 0;
+  if(copy != sp->buffer)
+    free(copy);
+
+  // Keep the file for the next piece
+  rewind(sp->spill);
+  sp->spilled = 0;
+
+  return ok;
+}
+
+void spool_free(struct ws_spool *sp) {
+
+  free(sp->buffer);
+  if(sp->spill)
+    fclose(sp->spill);
+
+  memset(sp, 0, sizeof(*sp));
+
+}
@@ -0,0 +1,57 @@
+/*  wavspool.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_SPOOL_H
+#define WAV_SPOOL_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Holds one piece until its length is known: in memory up to limit bytes,
+// and in an unnamed temporary file after that
+struct ws_spool {
+
+  unsigned char *buffer;
+  size_t used;
+  size_t allocated;
+  size_t limit;
+
+  FILE *spill;              // NULL until a piece first outgrows limit
+  unsigned long long spilled;
+
+  unsigned long long peak_spilled;
+
+};
+
+// Functions
+
+void spool_init(struct ws_spool *sp, size_t limit);
+int spool_write(struct ws_spool *sp, const void *data, size_t size);
+int spool_drain(struct ws_spool *sp, FILE *out);
+void spool_free(struct ws_spool *sp);
+
+#endif
@@ -0,0 +1,327 @@
+/*  wavstats.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    Stage timers and counters (-T), and an optional Chrome trace (-C).
+
+    Every timed call adds to its stage's calls, time and bytes with relaxed
+    atomics, since the -R threads time different stages of the same job.
+    With a trace, each call is also an event in a fixed array; a slot is
+    claimed with one atomic add, so no thread waits for another.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavheader.h"
+#include "wavstats.h"
+#include "wavjson.h"
+
+static const char *stage_names[STAGES] = {
+  "read", "detect", "write", "fix_file", "open", "close", "hooks"
+};
+
+static atomic_int thread_count;
+static __thread int thread_id;
+
+long long stats_now(void) {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int stats_init(struct ws_stats *s, int trace) {
+
+  int i;
+
+  memset(s, 0, sizeof(*s));
+
+  for(i = 0; i < STAGES; i++) {
+    atomic_init(&s->stages[i].calls, 0);
+    atomic_init(&s->stages[i].ns, 0);
+    atomic_init(&s->stages[i].bytes, 0);
+  }
+  atomic_init(&s->event_count, 0);
+
+  if(trace) {
+    s->events = malloc(TRACE_EVENTS * sizeof(*s->events));
+    if(s->events == NULL) {
+      fprintf(stderr, "stats: Could not allocate the trace\n");
+      return 0;
+    }
+  }
+
+  atomic_init(&s->helper_reads, 0);
+  atomic_init(&s->helper_writes, 0);
+  stats_syscalls(&s->syscalls_start);
+
+  s->start = stats_now();
+
+  return 1;
+}
+
+void stats_free(struct ws_stats *s) {
+
+  free(s->pieces);
+  free(s->events);
+  s->pieces = NULL;
+  s->events = NULL;
+
+}
+
+static void add_event(struct ws_stats *s, int stage, long long start,
+                      long long length) {
+
+  struct ws_trace_event *e;
+  int n;
+
+  if(thread_id == 0)
+    thread_id = atomic_fetch_add(&thread_count, 1) + 1;
+
+  n = atomic_fetch_add_explicit(&s->event_count, 1, memory_order_relaxed);
+  if(n >= TRACE_EVENTS)
+    return;
+
+  e = &s->events[n];
+  e->start = start - s->start;
+  e->length = length;
+  e->stage = stage;
+  e->thread = thread_id;
+
+}
+
+void stats_add(struct ws_stats *s, int stage, long long start,
+               long long bytes) {
+
+  struct ws_stage *st = &s->stages[stage];
+  long long ns = stats_now() - start;
+
+  atomic_fetch_add_explicit(&st->calls, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&st->ns, ns, memory_order_relaxed);
+  atomic_fetch_add_explicit(&st->bytes, bytes, memory_order_relaxed);
+
+  if(s->events)
+    add_event(s, stage, start, ns);
+
+}
+
+// A piece is done; only ever called by one thread at a time
+void stats_piece(struct ws_stats *s, long long bytes, long long frames) {
+
+  struct ws_piece_stats *p;
+
+  if(s->piece_count == s->piece_size) {
+    s->piece_size = s->piece_size ? s->piece_size * 2 : 64;
+    p = realloc(s->pieces, s->piece_size * sizeof(*p));
+    if(p == NULL) {
+      s->piece_size = s->piece_count;
+      return;
+    }
+    s->pieces = p;
+  }
+
+  p = &s->pieces[s->piece_count++];
+  p->bytes = bytes;
+  p->frames = frames;
+
+}
+
+// The -e commands' run times go in the trace, one line for each
+void stats_hooks(struct ws_stats *s, struct ws_hook_list *list) {
+
+  struct ws_hook *hook;
+  struct ws_trace_event *e;
+  int n, line = 0;
+
+  if(s->events == NULL)
+    return;
+
+  for(hook = list->first; hook; hook = hook->next, line++) {
+
+    if(hook->pid == 0)
+      continue;
+
+    n = atomic_fetch_add(&s->event_count, 1);
+    if(n >= TRACE_EVENTS)
+      return;
+
+    e = &s->events[n];
+    e->start = hook->started.tv_sec * 1000000000LL + hook->started.tv_nsec -
+      s->start;
+    e->length = (hook->finished.tv_sec - hook->started.tv_sec) * 1000000000LL +
+      (hook->finished.tv_nsec - hook->started.tv_nsec);
+    e->stage = STAGES;
+    e->thread = 1000 + line;
+  }
+
+}
+
+// Counts from /proc/thread-self/io, so the jobs of a -w batch don't see
+// each other's calls
+void stats_syscalls(struct ws_syscalls *c) {
+
+  FILE *fp;
+  char line[128];
+
+  c->reads = c->writes = -1;
+
+  fp = fopen("/proc/thread-self/io", "r");
+  if(fp == NULL)
+    return;
+
+  while(fgets(line, sizeof(line), fp)) {
+    sscanf(line, "syscr: %lld", &c->reads);
+    sscanf(line, "syscw: %lld", &c->writes);
+  }
+
+  fclose(fp);
+
+}
+
+// A helper thread of the job adds what it did since *since as it ends
+void stats_add_syscalls(struct ws_stats *s, const struct ws_syscalls *since) {
+
+  struct ws_syscalls now;
+
+  if((s == NULL) || (since->reads < 0))
+    return;
+
+  stats_syscalls(&now);
+  if(now.reads < 0)
+    return;
+
+  atomic_fetch_add(&s->helper_reads, now.reads - since->reads);
+  atomic_fetch_add(&s->helper_writes, now.writes - since->writes);
+
+}
+
+int stats_write_json(struct ws_stats *s, const char *path, const char *input,
+                     int rate) {
+
+  FILE *fp;
+  struct ws_stage *st;
+  struct ws_syscalls now;
+  long long elapsed = stats_now() - s->start;
+  long long reads, writes, ns, bytes;
+  int i, events;
+
+  fp = fopen(path, "w");
+  if(fp == NULL) {
+    perror(path);
+    return 0;
+  }
+
+  stats_syscalls(&now);
+  if((now.reads < 0) || (s->syscalls_start.reads < 0))
+    reads = writes = -1;
+  else {
+    reads = now.reads - s->syscalls_start.reads +
+      atomic_load(&s->helper_reads);
+    writes = now.writes - s->syscalls_start.writes +
+      atomic_load(&s->helper_writes);
+  }
+  events = atomic_load(&s->event_count);
+
+  fprintf(fp, "{\n  \"version\": \"%s\",\n", WAVSILENCE_VERSION);
+  fprintf(fp, "  \"input\": ");
+  json_string(fp, input);
+  fprintf(fp, ",\n");
+  fprintf(fp, "  \"elapsed_seconds\": %.6f,\n", elapsed / 1e9);
+
+  fprintf(fp, "  \"stages\": {\n");
+  for(i = 0; i < STAGES; i++) {
+    st = &s->stages[i];
+    ns = atomic_load(&st->ns);
+    bytes = atomic_load(&st->bytes);
+    fprintf(fp, "    \"%s\": {\"calls\": %lld, \"seconds\": %.6f, "
+	    "\"bytes\": %lld, \"mb_per_s\": %.1f}%s\n", stage_names[i],
+	    atomic_load(&st->calls), ns / 1e9, bytes,
+	    ns ? bytes / 1048576.0 / (ns / 1e9) : 0.0,
+	    (i < STAGES - 1) ? "," : "");
+  }
+  fprintf(fp, "  },\n");
+
+  fprintf(fp, "  \"syscalls\": {\"read\": %lld, \"write\": %lld, "
+	  "\"io_uring_enter\": %lld},\n", reads, writes, s->uring_enters);
+
+  fprintf(fp, "  \"scan\": {\"spans\": %lld, \"coarse\": %lld, "
+	  "\"coarse_hit_rate\": %.3f, \"cells\": %lld, \"fine_blocks\": %lld},\n",
+	  s->scan_spans, s->scan_coarse,
+	  s->scan_spans ? (double)s->scan_coarse / s->scan_spans : 0.0,
+	  s->scan_cells, s->scan_blocks);
+
+  fprintf(fp, "  \"pieces\": [");
+  for(i = 0; i < s->piece_count; i++)
+    fprintf(fp, "%s\n    {\"bytes\": %lld, \"seconds\": %.3f}",
+	    i ? "," : "", s->pieces[i].bytes,
+	    rate ? (double)s->pieces[i].frames / rate : 0.0);
+  fprintf(fp, "%s],\n", s->piece_count ? "\n  " : "");
+
+  fprintf(fp, "  \"trace_events_dropped\": %i\n}\n",
+	  (s->events && events > TRACE_EVENTS) ? events - TRACE_EVENTS : 0);
+
+  fclose(fp);
+
+  return 1;
+}
+
+// Chrome's trace event format (chrome://tracing, Perfetto)
+int stats_write_trace(struct ws_stats *s, const char *path) {
+
+  FILE *fp;
+  struct ws_trace_event *e;
+  int i, n;
+
+  fp = fopen(path, "w");
+  if(fp == NULL) {
+    perror(path);
+    return 0;
+  }
+
+  n = atomic_load(&s->event_count);
+  if(n > TRACE_EVENTS)
+    n = TRACE_EVENTS;
+
+  fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+  for(i = 0; i < n; i++) {
+    e = &s->events[i];
+    fprintf(fp, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+	    "\"dur\": %.3f, \"pid\": 1, \"tid\": %i}", i ? "," : "",
+	    (e->stage < STAGES) ? stage_names[e->stage] : "command",
+	    e->start / 1000.0, e->length / 1000.0, e->thread);
+  }
+
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+
+  return 1;
+}
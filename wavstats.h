@@ -0,0 +1,139 @@
+/*  wavstats.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_STATS_H
+#define WAV_STATS_H
+
+#include <time.h>
+#include <stdatomic.h>
+
+#include "wavhook.h"
+
+// Where the time goes
+#define STAGE_READ      0   // Getting input blocks
+#define STAGE_DETECT    1   // Detector and splitter (or the whole -j scan)
+#define STAGE_WRITE     2   // piece_write()
+#define STAGE_FIX       3   // fix_file()
+#define STAGE_OPEN      4   // Creating a piece, or starting -P
+#define STAGE_CLOSE     5   // Closing it (and pclose(), or sending a -L piece)
+#define STAGE_HOOKS     6   // Waiting for -e commands at the end
+#define STAGES          7
+
+// Events kept for the trace; later ones are counted but dropped
+#define TRACE_EVENTS    (256 * 1024)
+
+struct ws_stage {
+
+  atomic_llong calls;
+  atomic_llong ns;
+  atomic_llong bytes;
+
+};
+
+struct ws_trace_event {
+
+  long long start;          // ns since the stats were started
+  long long length;
+  int stage;                // STAGES and up for -e commands
+  int thread;
+
+};
+
+// read() and write() calls, -1 if the kernel doesn't say
+struct ws_syscalls {
+
+  long long reads;
+  long long writes;
+
+};
+
+struct ws_piece_stats {
+
+  long long bytes;
+  long long frames;
+
+};
+
+struct ws_stats {
+
+  long long start;
+  struct ws_stage stages[STAGES];
+
+  struct ws_piece_stats *pieces;
+  int piece_count;
+  int piece_size;
+
+  struct ws_trace_event *events;  // NULL if there is no trace
+  atomic_int event_count;
+
+  struct ws_syscalls syscalls_start;  // The job's thread, at stats_init()
+  atomic_llong helper_reads;          // Added by -R and -j threads as they end
+  atomic_llong helper_writes;
+
+  long long uring_enters;   // Set by the caller before stats_write_json()
+
+  // process_data()'s two-level scan, also set by the caller
+  long long scan_spans;     // Spans read
+  long long scan_coarse;    // Spans the coarse level cleared on its own
+  long long scan_cells;     // Cells the coarse level looked at
+  long long scan_blocks;    // Blocks the fine level looked at
+
+};
+
+// Functions
+
+long long stats_now(void);
+
+int stats_init(struct ws_stats *s, int trace);
+void stats_free(struct ws_stats *s);
+
+void stats_add(struct ws_stats *s, int stage, long long start,
+               long long bytes);
+void stats_piece(struct ws_stats *s, long long bytes, long long frames);
+void stats_hooks(struct ws_stats *s, struct ws_hook_list *list);
+
+void stats_syscalls(struct ws_syscalls *c);
+void stats_add_syscalls(struct ws_stats *s, const struct ws_syscalls *since);
+
+int stats_write_json(struct ws_stats *s, const char *path, const char *input,
+                     int rate);
+int stats_write_trace(struct ws_stats *s, const char *path);
+
+// The timers cost a NULL check when stats are off
+static inline long long stats_start(struct ws_stats *s) {
+
+  return s ? stats_now() : 0;
+}
+
+static inline void stats_stop(struct ws_stats *s, int stage, long long start,
+                              long long bytes) {
+
+  if(s)
+    stats_add(s, stage, start, bytes);
+}
+
+#endif
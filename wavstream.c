@@ -0,0 +1,470 @@
+/*  wavstream.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    The push API of libwavsilence (see wavstream.h).
+
+    Blocks are cut from what is fed as process_data() cuts them from the
+    input: block_frames at a time from the start of the stream.  A block
+    that a buffer ends in the middle of is copied and kept until the rest
+    of it comes, so however the data is cut into buffers, the segments are
+    the ones wavsilence finds in it.  Only the last block of the stream
+    may be short.
+
+    The audio written to a segment between two events is passed on as one
+    range of the caller's buffer, or of the copy of a block that straddled
+    two buffers.
+
+    Unless exhaustive is set, the data is first checked in spans of about
+    1 MB (whole blocks, cut from the start of the stream like them), in
+    cells of half the gap: a span with a loud sample in every cell can't
+    hold a gap and goes to the splitter in one go.  Only the others are
+    checked block by block.  The windowed and per-channel detectors need
+    every block.  wavsilence reads its input in spans of ws_stream_span()
+    bytes and feeds them here.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavdetect.h"
+#include "wavsplit.h"
+#include "wavenvelope.h"
+#include "wavstream.h"
+
+// Bytes the coarse scan takes at a time, rounded down to whole blocks
+#define COARSE_SPAN     (1024 * 1024)
+
+struct ws_stream {
+
+  struct ws_stream_params params;
+  struct ws_stream_events events;
+
+  struct ws_detector detector;
+  struct ws_envelope envelope;
+  struct ws_envelope *env;  // NULL unless -D rms or peak
+  struct ws_channels chan;
+  struct ws_channels *ch;   // NULL unless -k any or a channel
+  struct ws_splitter splitter;
+
+  int frame_size;
+  int block_size;           // Bytes of a whole block
+  unsigned char *block;     // The block the last buffer ended in
+  int partial;              // Bytes of it
+
+  int cell;                 // Samples in a cell of the coarse scan; 0 if off
+  int span_frames;
+  long long span_left;      // Frames of a span the coarse scan didn't clear
+  long long coarse;         // Spans it cleared
+  long long cells;          // Cells it looked at
+  long long blocks;         // Blocks checked on their own
+
+  long long frames;         // Seen so far
+  int segment;
+  int started;
+  unsigned long long bytes; // Given to the open segment
+
+  const unsigned char *pending;   // Audio not yet passed on
+  size_t pending_size;
+
+  int in_gap;
+  long long gap_start;
+
+};
+
+void ws_stream_defaults(struct ws_stream_params *p) {
+
+  memset(p, 0, sizeof(*p));
+
+  p->format = WAVE_FORMAT_PCM;
+  p->bits = 16;
+  p->channels = 2;
+  p->rate = 44100;
+
+  p->threshold = 0.03;
+  p->gap = 1.0;
+  p->block_frames = 1;
+  p->window = 50;
+  p->channel_policy = CHANNELS_ALL;
+
+}
+
+// Returns NULL if the format or a setting can't be used
+struct ws_stream *ws_stream_open(const struct ws_stream_params *p,
+                                 const struct ws_stream_events *ev) {
+
+  struct ws_stream *st;
+  float loud;
+
+  if((p->channels < 1) || (p->rate == 0) || (p->bits < 8) ||
+     (p->threshold <= 0) || (p->gap <= 0) || (p->block_frames < 1))
+    return NULL;
+
+  st = calloc(1, sizeof(*st));
+  if(st == NULL)
+    return NULL;
+
+  st->params = *p;
+  if(ev)
+    st->events = *ev;
+
+  st->frame_size = p->channels * (p->bits / 8);
+  st->block_size = p->block_frames * st->frame_size;
+  st->block = malloc(st->block_size);
+
+  if((st->block == NULL) ||
+     !detect_init(&st->detector, p->threshold, p->format, p->bits)) {
+    ws_stream_close(st);
+    return NULL;
+  }
+
+  if(p->detector) {
+    loud = (p->loud_threshold < p->threshold) ? p->threshold
+                                              : p->loud_threshold;
+    if(!envelope_init(&st->envelope, p->detector, p->window * p->rate / 1000,
+                      p->threshold, loud, p->format, p->bits, p->channels)) {
+      ws_stream_close(st);
+      return NULL;
+    }
+    st->env = &st->envelope;
+  }
+
+  if(p->channel_policy != CHANNELS_ALL) {
+    if(p->detector || !channels_init(&st->chan, p->channel_policy,
+                                     p->channels)) {
+      ws_stream_close(st);
+      return NULL;
+    }
+    st->ch = &st->chan;
+  }
+
+  split_init(&st->splitter, (long long)(p->rate * p->gap * p->channels),
+             (p->override > p->gap) ? (long long)(p->rate * p->override *
+                                                  p->channels) : -1,
+             p->min_length, p->rate, p->skip_silence);
+  st->splitter.max_frames = (long long)(p->max_length * p->rate);
+
+  if(!p->exhaustive && !st->env && !st->ch) {
+    st->span_frames = (COARSE_SPAN / st->frame_size / p->block_frames) *
+      p->block_frames;
+    if(st->span_frames < p->block_frames)
+      st->span_frames = p->block_frames;
+    // A cell as long as the span is the whole span
+    st->cell = ((st->splitter.gap + 1) / 2 < st->span_frames * p->channels)
+      ? (st->splitter.gap + 1) / 2 : st->span_frames * p->channels;
+  }
+
+  return st;
+}
+
+void ws_stream_close(struct ws_stream *st) {
+
+  if(st == NULL)
+    return;
+
+  if(st->env)
+    envelope_free(st->env);
+  free(st->block);
+  free(st);
+
+}
+
+static int flush(struct ws_stream *st) {
+
+  int ok = 1;
+
+  if(st->pending_size && st->events.segment_data)
+    ok = st->events.segment_data(st->events.user, st->segment, st->pending,
+                                 st->pending_size);
+
+  st->pending_size = 0;
+
+  return ok;
+}
+
+static int start(struct ws_stream *st) {
+
+  st->started = 1;
+
+  return !st->events.segment_start ||
+    st->events.segment_start(st->events.user, st->segment, st->frames);
+}
+
+static int end_gap(struct ws_stream *st) {
+
+  st->in_gap = 0;
+
+  return !st->events.silence ||
+    st->events.silence(st->events.user, st->gap_start,
+                       st->frames - st->gap_start);
+}
+
+// Passes count samples at data on to the open segment
+static int take(struct ws_stream *st, const unsigned char *data, int count) {
+
+  if(st->pending + st->pending_size != data) {
+    if(!flush(st))
+      return 0;
+    st->pending = data;
+  }
+  st->pending_size += count * (st->params.bits / 8);
+  st->bytes += count * (st->params.bits / 8);
+
+  return 1;
+}
+
+// The coarse level: if no run of silence in the count samples of span can
+// reach the gap, feeds the splitter the whole span and returns 1.  Returns
+// 0 if its blocks have to be checked one by one, and -1 if a callback said
+// to stop.
+static int run_span(struct ws_stream *st, const unsigned char *span,
+                    int count) {
+
+  struct ws_splitter *sp = &st->splitter;
+  int frames = count / st->params.channels;
+  long long before = sp->silence_counter;
+  int tail, n, passed;
+
+  // Right after a split, the blocks that clear the silence flag matter; and
+  // the silence carried in plus the start of the first cell must stay
+  // within the gap
+  if(sp->silence_flag ||
+     (sp->silence_counter + ((st->cell < count) ? st->cell : count) - 1 >
+      sp->gap))
+    return 0;
+
+  // Nor may the segment reach max_length in the span
+  if(sp->max_frames && (sp->file_sample_c + frames > sp->max_frames))
+    return 0;
+
+  passed = detect_coarse(&st->detector, span, count, st->cell, &tail, &n);
+  st->cells += n;
+  if(!passed)
+    return 0;
+
+  st->coarse++;
+
+  if(!st->started && !start(st))
+    return -1;
+
+  split_feed(sp, tail, frames);
+
+  if(st->in_gap && (sp->silence_counter < before + count) && !end_gap(st))
+    return -1;
+
+  if(!take(st, span, count))
+    return -1;
+
+  st->frames += frames;
+
+  return 1;
+}
+
+// One block of count samples
+static int run_block(struct ws_stream *st, const unsigned char *block,
+                     int count) {
+
+  struct ws_splitter *sp = &st->splitter;
+  int frames = count / st->params.channels;
+  long long before = sp->silence_counter;
+  int tail, any_loud, result;
+
+  if(!st->started && !start(st))
+    return 0;
+
+  st->blocks++;
+
+  if(st->ch)
+    result = split_feed(sp, channels_block(&st->detector, st->ch, block,
+                                           count), frames);
+  else {
+    if(st->env)
+      any_loud = envelope_block(st->env, block, count, &tail);
+    else
+      any_loud = detect_block(&st->detector, block, count, &tail);
+    result = split_block(sp, any_loud, tail, count, frames);
+  }
+
+  if(st->events.block &&
+     !st->events.block(st->events.user, sp, block, count, result))
+    return 0;
+
+  // The run of silence was broken somewhere in the block
+  if(st->in_gap && (sp->silence_counter < before + count) && !end_gap(st))
+    return 0;
+
+  if(result & SPLIT_NEW_PIECE) {
+    if(!flush(st))
+      return 0;
+    if(st->events.segment_end &&
+       !st->events.segment_end(st->events.user, st->segment,
+                               sp->piece_sample_c, st->bytes))
+      return 0;
+    st->segment++;
+    st->bytes = 0;
+    if(!start(st))
+      return 0;
+    // A cut for max_length isn't at a gap
+    if(!(result & SPLIT_FORCED)) {
+      st->in_gap = 1;
+      st->gap_start = st->frames + frames - sp->silence_counter /
+        st->params.channels;
+    }
+  }
+
+  if((result & SPLIT_WRITE) && !take(st, block, count))
+    return 0;
+
+  st->frames += frames;
+
+  return 1;
+}
+
+// Runs size bytes of interleaved samples through the splitter.  Returns 0
+// if a callback said to stop.
+int ws_stream_feed(struct ws_stream *st, const void *buffer, size_t size) {
+
+  const unsigned char *p = buffer;
+  int block = st->params.block_frames;
+  int count = st->block_size / (st->params.bits / 8);
+  size_t n;
+  int passed;
+
+  // Finish the block the last buffer ended in
+  if(st->partial) {
+    n = st->block_size - st->partial;
+    if(n > size)
+      n = size;
+    memcpy(st->block + st->partial, p, n);
+    st->partial += n;
+    p += n;
+    size -= n;
+    if(st->partial < st->block_size)
+      return 1;
+    st->partial = 0;
+    if(!run_block(st, st->block, count) || !flush(st))
+      return 0;
+    if(st->span_left)
+      st->span_left -= block;
+  }
+
+  while(size >= (size_t)st->block_size) {
+
+    // A span is the whole blocks of the buffer, up to span_frames
+    if(st->cell && (st->span_left == 0)) {
+      n = size / st->frame_size;
+      if(n > (size_t)st->span_frames)
+        n = st->span_frames;
+      n -= n % block;
+      passed = run_span(st, p, n * st->frame_size / (st->params.bits / 8));
+      if(passed < 0)
+        return 0;
+      if(passed) {
+        p += n * st->frame_size;
+        size -= n * st->frame_size;
+        continue;
+      }
+      // Otherwise its blocks are checked one by one
+      st->span_left = n;
+    }
+
+    if(!run_block(st, p, count))
+      return 0;
+    if(st->span_left)
+      st->span_left -= block;
+    p += st->block_size;
+    size -= st->block_size;
+  }
+
+  if(size) {
+    memcpy(st->block, p, size);
+    st->partial = size;
+  }
+
+  // The buffer is the caller's again once this returns
+  return flush(st);
+}
+
+// Runs the short block the stream ends in, if any.  A frame that was never
+// finished is dropped.
+int ws_stream_drain(struct ws_stream *st) {
+
+  int frames = st->partial / st->frame_size;
+
+  st->partial = 0;
+
+  return !frames ||
+    (run_block(st, st->block, frames * st->params.channels) && flush(st));
+}
+
+// Ends the last segment, and the silence it ends in
+int ws_stream_finish(struct ws_stream *st) {
+
+  if(!ws_stream_drain(st))
+    return 0;
+
+  if(!st->started && !start(st))
+    return 0;
+
+  if(st->in_gap && !end_gap(st))
+    return 0;
+
+  return !st->events.segment_end ||
+    st->events.segment_end(st->events.user, st->segment,
+                           st->splitter.file_sample_c, st->bytes);
+}
+
+long long ws_stream_frames(const struct ws_stream *st) {
+
+  return st->frames;
+}
+
+int ws_stream_segments(const struct ws_stream *st) {
+
+  return st->segment + 1;
+}
+
+// Bytes of the spans the coarse scan checks, or of a block if it is off.
+// Buffers of this size go to the coarse scan whole, with nothing to copy.
+size_t ws_stream_span(const struct ws_stream *st) {
+
+  return (size_t)(st->cell ? st->span_frames : st->params.block_frames) *
+    st->frame_size;
+}
+
+// What the scan did so far: spans the coarse level cleared, the cells it
+// looked at, and the blocks checked one by one
+void ws_stream_scan(const struct ws_stream *st, long long *coarse,
+                    long long *cells, long long *blocks) {
+
+  *coarse = st->coarse;
+  *cells = st->cells;
+  *blocks = st->blocks;
+
+}
@@ -0,0 +1,127 @@
+/*  wavstream.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    libwavsilence: the silence splitter for programs that already have the
+    PCM in memory.  Open a stream with the format and the settings, feed it
+    the samples as they come, and it calls back when a segment starts and
+    ends, with the audio of each segment, and when a stretch of silence it
+    split at is over.  The audio handed to segment_data() points into the
+    buffer given to ws_stream_feed(), or for a block that two buffers share,
+    into the stream's copy of it.  There is no global state, so any number
+    of streams can run at once, one thread each.
+
+      struct ws_stream_params p;
+      struct ws_stream_events ev = { .user = me, .segment_data = got };
+      struct ws_stream *st;
+
+      ws_stream_defaults(&p);
+      p.rate = 44100;
+      p.gap = 2.0;
+      st = ws_stream_open(&p, &ev);
+      while((n = next_pcm(&buf)) > 0)
+        ws_stream_feed(st, buf, n);
+      ws_stream_finish(st);
+      ws_stream_close(st);
+*/
+
+#ifndef WAV_STREAM_H
+#define WAV_STREAM_H
+
+#include <stddef.h>
+
+#include "wavdetect.h"
+#include "wavenvelope.h"
+#include "wavsplit.h"
+
+// The same settings as the wavsilence options
+struct ws_stream_params {
+
+  int format;               // WAVE_FORMAT_PCM (default) or _IEEE_FLOAT
+  int bits;                 // 16 is default
+  int channels;             // 2 is default
+  unsigned int rate;        // 44100 is default
+
+  float threshold;          // -t, as a fraction of full scale
+  double gap;               // -g, in seconds
+  double override;          // -o, in seconds; 0 if off
+  float min_length;         // -m, in seconds
+  int skip_silence;         // -s
+  int block_frames;         // -b
+  double max_length;        // -H, in seconds; 0 if off
+
+  int detector;             // -D: 0 for single samples, ENV_RMS, ENV_PEAK
+  double window;            // -W, in ms
+  float loud_threshold;     // -E; below threshold means the same
+  int channel_policy;       // -k: CHANNELS_ALL, CHANNELS_ANY or a channel
+  int exhaustive;           // -X: check every block, no coarse scan
+
+};
+
+// What the stream reports.  Any of them may be NULL.  Frames count from the
+// start of the stream.  A callback returns non-zero to go on; zero makes
+// the ws_stream_*() call it came from fail.
+struct ws_stream_events {
+
+  void *user;               // Passed to each of them
+
+  int (*segment_start)(void *user, int segment, long long frame);
+  // Audio of the open segment, from the caller's buffer (or the copy of a
+  // block cut in two by the end of one)
+  int (*segment_data)(void *user, int segment, const void *data,
+                      size_t size);
+  int (*segment_end)(void *user, int segment, long long frames,
+                     unsigned long long bytes);
+  // Silence that started a segment is over (to the block)
+  int (*silence)(void *user, long long frame, long long frames);
+  // Each block checked on its own, with what the splitter made of it
+  // (SPLIT_* from wavsplit.h), before the events that follow from it
+  int (*block)(void *user, const struct ws_splitter *sp, const void *samples,
+               int count, int result);
+
+};
+
+struct ws_stream;
+
+// Functions
+
+void ws_stream_defaults(struct ws_stream_params *p);
+
+struct ws_stream *ws_stream_open(const struct ws_stream_params *p,
+                                 const struct ws_stream_events *ev);
+int ws_stream_feed(struct ws_stream *st, const void *buffer, size_t size);
+int ws_stream_drain(struct ws_stream *st);
+int ws_stream_finish(struct ws_stream *st);
+void ws_stream_close(struct ws_stream *st);
+
+long long ws_stream_frames(const struct ws_stream *st);
+int ws_stream_segments(const struct ws_stream *st);
+size_t ws_stream_span(const struct ws_stream *st);
+void ws_stream_scan(const struct ws_stream *st, long long *coarse,
+                    long long *cells, long long *blocks);
+
+#endif
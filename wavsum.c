@@ -0,0 +1,304 @@
+/*  wavsum.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    Checksums of the data chunk, updated block by block as wavinfo -v reads
+    it, so checking a file for damage costs no second pass.
+
+    CRC32C (Castagnoli) is what iSCSI, ext4 and many archive tools use.
+    With SSE4.2 it is the crc32 instruction, 8 bytes at a time; without it,
+    a slice-by-8 table.  XXH64 is the 64-bit xxHash, which is faster still
+    in plain C and is common in deduplicating archives.
+*/
+
+
+#include <string.h>
+#include <strings.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_CRC
+#include <immintrin.h>
+#endif
+
+#include "wavsum.h"
+
+#define CRC32C_POLY     0x82F63B78  // Reflected
+
+#define XXH_P1          0x9E3779B185EBCA87ULL
+#define XXH_P2          0xC2B2AE3D27D4EB4FULL
+#define XXH_P3          0x165667B19E3779F9ULL
+#define XXH_P4          0x85EBCA77C2B2AE63ULL
+#define XXH_P5          0x27D4EB2F165667C5ULL
+
+// Returns SUM_CRC32C or SUM_XXH64, or 0 if name is neither
+int sum_type(const char *name) {
+
+  if(!strcasecmp(name, "crc32c"))
+    return SUM_CRC32C;
+  if(!strcasecmp(name, "xxh64") || !strcasecmp(name, "xxhash"))
+    return SUM_XXH64;
+
+  return 0;
+}
+
+// Unaligned little-endian loads, which x86 and gcc turn into plain moves
+static unsigned long long load64(const unsigned char *p) {
+
+  unsigned long long v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static unsigned int load32(const unsigned char *p) {
+
+  unsigned int v;
+
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static void crc_table(struct ws_sum *s) {
+
+  unsigned int c;
+  int i, j;
+
+  for(i = 0; i < 256; i++) {
+    c = i;
+    for(j = 0; j < 8; j++)
+      c = (c >> 1) ^ ((c & 1) ? CRC32C_POLY : 0);
+    s->table[0][i] = c;
+  }
+
+  for(i = 0; i < 256; i++)
+    for(j = 1; j < 8; j++)
+      s->table[j][i] = (s->table[j-1][i] >> 8) ^
+        s->table[0][s->table[j-1][i] & 0xff];
+
+}
+
+static unsigned int crc_soft(const struct ws_sum *s, unsigned int crc,
+                             const unsigned char *p, size_t size) {
+
+  unsigned long long w;
+
+  while(size >= 8) {
+    w = load64(p) ^ crc;
+    crc = s->table[7][w & 0xff] ^ s->table[6][(w >> 8) & 0xff] ^
+      s->table[5][(w >> 16) & 0xff] ^ s->table[4][(w >> 24) & 0xff] ^
+      s->table[3][(w >> 32) & 0xff] ^ s->table[2][(w >> 40) & 0xff] ^
+      s->table[1][(w >> 48) & 0xff] ^ s->table[0][w >> 56];
+    p += 8;
+    size -= 8;
+  }
+
+  while(size--)
+    crc = (crc >> 8) ^ s->table[0][(crc ^ *p++) & 0xff];
+
+  return crc;
+}
+
+#ifdef HAVE_X86_CRC
+__attribute__((target("sse4.2")))
+static unsigned int crc_sse42(unsigned int crc, const unsigned char *p,
+                              size_t size) {
+
+#ifdef __x86_64__
+  unsigned long long c = crc;
+
+  while(size >= 8) {
+    c = _mm_crc32_u64(c, load64(p));
+    p += 8;
+    size -= 8;
+  }
+  crc = c;
+#endif
+
+  while(size >= 4) {
+    crc = _mm_crc32_u32(crc, load32(p));
+    p += 4;
+    size -= 4;
+  }
+
+  while(size--)
+    crc = _mm_crc32_u8(crc, *p++);
+
+  return crc;
+}
+#endif
+
+static unsigned long long rotl64(unsigned long long x, int r) {
+
+  return (x << r) | (x >> (64 - r));
+}
+
+static unsigned long long xxh_round(unsigned long long acc,
+                                    unsigned long long input) {
+
+  acc += input * XXH_P2;
+  return rotl64(acc, 31) * XXH_P1;
+}
+
+static unsigned long long xxh_merge(unsigned long long acc,
+                                    unsigned long long v) {
+
+  acc ^= xxh_round(0, v);
+  return acc * XXH_P1 + XXH_P4;
+}
+
+static void xxh_stripes(struct ws_sum *s, const unsigned char *p,
+                        size_t stripes) {
+
+  unsigned long long v0 = s->v[0], v1 = s->v[1], v2 = s->v[2], v3 = s->v[3];
+
+  while(stripes--) {
+    v0 = xxh_round(v0, load64(p));
+    v1 = xxh_round(v1, load64(p + 8));
+    v2 = xxh_round(v2, load64(p + 16));
+    v3 = xxh_round(v3, load64(p + 24));
+    p += 32;
+  }
+
+  s->v[0] = v0;
+  s->v[1] = v1;
+  s->v[2] = v2;
+  s->v[3] = v3;
+
+}
+
+void sum_init(struct ws_sum *s, int type) {
+
+  memset(s, 0, sizeof(*s));
+  s->type = type;
+
+  if(type == SUM_CRC32C) {
+    s->name = "crc32c";
+    s->crc = 0xFFFFFFFF;
+#ifdef HAVE_X86_CRC
+    s->hardware = __builtin_cpu_supports("sse4.2");
+#endif
+    if(s->hardware)
+      s->kernel = "sse4.2";
+    else {
+      s->kernel = "table";
+      crc_table(s);
+    }
+    return;
+  }
+
+  s->name = "xxh64";
+  s->kernel = "scalar";
+  s->v[0] = XXH_P1 + XXH_P2;
+  s->v[1] = XXH_P2;
+  s->v[2] = 0;
+  s->v[3] = -XXH_P1;
+
+}
+
+void sum_update(struct ws_sum *s, const void *data, size_t size) {
+
+  const unsigned char *p = data;
+  size_t n;
+
+  if(s->type == SUM_CRC32C) {
+#ifdef HAVE_X86_CRC
+    if(s->hardware) {
+      s->crc = crc_sse42(s->crc, p, size);
+      return;
+    }
+#endif
+    s->crc = crc_soft(s, s->crc, p, size);
+    return;
+  }
+
+  s->total += size;
+
+  // Top up a stripe left over from the last block
+  if(s->buffered) {
+    n = 32 - s->buffered;
+    if(n > size)
+      n = size;
+    memcpy(s->buffer + s->buffered, p, n);
+    s->buffered += n;
+    p += n;
+    size -= n;
+    if(s->buffered < 32)
+      return;
+    xxh_stripes(s, s->buffer, 1);
+    s->buffered = 0;
+  }
+
+  xxh_stripes(s, p, size / 32);
+  p += size & ~(size_t)31;
+  size &= 31;
+
+  memcpy(s->buffer, p, size);
+  s->buffered = size;
+
+}
+
+unsigned long long sum_final(struct ws_sum *s) {
+
+  const unsigned char *p = s->buffer;
+  int size = s->buffered;
+  unsigned long long h;
+
+  if(s->type == SUM_CRC32C)
+    return s->crc ^ 0xFFFFFFFF;
+
+  if(s->total >= 32) {
+    h = rotl64(s->v[0], 1) + rotl64(s->v[1], 7) + rotl64(s->v[2], 12) +
+      rotl64(s->v[3], 18);
+    h = xxh_merge(h, s->v[0]);
+    h = xxh_merge(h, s->v[1]);
+    h = xxh_merge(h, s->v[2]);
+    h = xxh_merge(h, s->v[3]);
+  } else
+    h = XXH_P5;
+
+  h += s->total;
+
+  for(; size >= 8; p += 8, size -= 8)
+    h = rotl64(h ^ xxh_round(0, load64(p)), 27) * XXH_P1 + XXH_P4;
+
+  if(size >= 4) {
+    h = rotl64(h ^ (load32(p) * XXH_P1), 23) * XXH_P2 + XXH_P3;
+    p += 4;
+    size -= 4;
+  }
+
+  for(; size > 0; p++, size--)
+    h = rotl64(h ^ (*p * XXH_P5), 11) * XXH_P1;
+
+  h ^= h >> 33;
+  h *= XXH_P2;
+  h ^= h >> 29;
+  h *= XXH_P3;
+  h ^= h >> 32;
+
+  return h;
+}
@@ -0,0 +1,63 @@
+/*  wavsum.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_SUM_H
+#define WAV_SUM_H
+
+#include <stddef.h>
+
+#define SUM_CRC32C      1
+#define SUM_XXH64       2
+
+// A running checksum of the data chunk (wavinfo -c)
+struct ws_sum {
+
+  int type;
+  const char *name;         // Of the type, for the report
+  const char *kernel;       // How it is computed
+
+  // CRC32C
+  unsigned int crc;
+  int hardware;             // SSE4.2 crc32 instruction
+  unsigned int table[8][256];
+
+  // XXH64
+  unsigned long long v[4];
+  unsigned long long total;
+  unsigned char buffer[32]; // Input short of a whole stripe
+  int buffered;
+
+};
+
+// Functions
+
+int sum_type(const char *name);
+void sum_init(struct ws_sum *s, int type);
+void sum_update(struct ws_sum *s, const void *data, size_t size);
+unsigned long long sum_final(struct ws_sum *s);
+
+#endif
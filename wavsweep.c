@@ -0,0 +1,272 @@
+/*  wavsweep.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+/*
+    Parameter sweep (-S).
+
+    Every combination of the given thresholds, gaps and minimum lengths is
+    tried in one read of the input.  The silence counter only depends on the
+    threshold, so there is one detector per threshold, and each block is
+    scanned once for each of them; every combination then has its own
+    splitter, fed exactly as process_data() feeds its one, so the split
+    points are the ones a real run with those settings would give.  Nothing
+    is written: each combination only keeps where its pieces start and how
+    long the silence at each split was (to the block).
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wavsweep.h"
+
+// Upper ends of the gap length buckets, in seconds
+static const double bucket_limits[SWEEP_BUCKETS - 1] = {
+  0.5, 1, 2, 5, 10, 30
+};
+
+static const char *bucket_names[SWEEP_BUCKETS] = {
+  "<0.5s", "<1s", "<2s", "<5s", "<10s", "<30s", "30s+"
+};
+
+// Parses "<thresholds>[/<gaps>[/<min lengths>]]", each a comma-separated
+// list that may be empty.  Thresholds are in % as for -t.  Returns 0 if
+// the spec is malformed or has no values at all.
+int sweep_parse(struct ws_sweep_lists *lists, const char *spec) {
+
+  const char *p = spec;
+  char *end;
+  double v;
+  int list = 0;
+
+  memset(lists, 0, sizeof(*lists));
+
+  while(*p) {
+
+    if(*p == '/') {
+      if(++list > SWEEP_LENGTH)
+        return 0;
+      p++;
+      continue;
+    }
+
+    v = strtod(p, &end);
+    if((end == p) || (lists->count[list] == MAX_SWEEP))
+      return 0;
+    if((list == SWEEP_LENGTH) ? (v < 0) : (v <= 0))
+      return 0;
+
+    if(list == SWEEP_THRESHOLD)
+      v /= 100.0;
+    lists->value[list][lists->count[list]++] = v;
+
+    p = end;
+    if(*p == ',')
+      p++;
+    else if(*p && (*p != '/'))
+      return 0;
+  }
+
+  return lists->count[SWEEP_THRESHOLD] || lists->count[SWEEP_GAP] ||
+    lists->count[SWEEP_LENGTH];
+}
+
+// Sets up a combination for every value of the lists, with threshold,
+// gap and min_length standing in for a list that is empty.  override is
+// -o, in seconds.  Returns 0 if a threshold can't be used on the format.
+int sweep_init(struct ws_sweep *sw, const struct ws_sweep_lists *lists,
+               float threshold, double gap, float min_length,
+               double override, int format, int bits, unsigned int rate,
+               int channels) {
+
+  struct ws_sweep_combo *c;
+  int i, j, k;
+  long long gap_samples;
+
+  memset(sw, 0, sizeof(*sw));
+
+  sw->lists = *lists;
+  sw->rate = rate;
+  sw->channels = channels;
+
+  if(!sw->lists.count[SWEEP_THRESHOLD])
+    sw->lists.value[SWEEP_THRESHOLD][sw->lists.count[SWEEP_THRESHOLD]++] =
+      threshold;
+  if(!sw->lists.count[SWEEP_GAP])
+    sw->lists.value[SWEEP_GAP][sw->lists.count[SWEEP_GAP]++] = gap;
+  if(!sw->lists.count[SWEEP_LENGTH])
+    sw->lists.value[SWEEP_LENGTH][sw->lists.count[SWEEP_LENGTH]++] =
+      min_length;
+
+  for(i = 0; i < sw->lists.count[SWEEP_THRESHOLD]; i++)
+    if(!detect_init(&sw->detectors[i], sw->lists.value[SWEEP_THRESHOLD][i],
+                    format, bits))
+      return 0;
+
+  sw->combo_count = sw->lists.count[SWEEP_THRESHOLD] *
+    sw->lists.count[SWEEP_GAP] * sw->lists.count[SWEEP_LENGTH];
+  sw->combos = calloc(sw->combo_count, sizeof(*sw->combos));
+  if(sw->combos == NULL) {
+    fprintf(stderr, "sweep: Out of memory\n");
+    return 0;
+  }
+
+  // By threshold, so each detector's combinations are together
+  c = sw->combos;
+  for(i = 0; i < sw->lists.count[SWEEP_THRESHOLD]; i++)
+    for(j = 0; j < sw->lists.count[SWEEP_GAP]; j++)
+      for(k = 0; k < sw->lists.count[SWEEP_LENGTH]; k++, c++) {
+        c->threshold = i;
+        c->gap = sw->lists.value[SWEEP_GAP][j];
+        c->min_length = sw->lists.value[SWEEP_LENGTH][k];
+        gap_samples = (long long)(rate * c->gap * channels);
+        split_init(&c->splitter, gap_samples,
+                   (override > c->gap) ? (long long)(rate * override * channels)
+                                       : -1,
+                   c->min_length, rate, 0);
+      }
+
+  return 1;
+}
+
+void sweep_free(struct ws_sweep *sw) {
+
+  int i;
+
+  for(i = 0; i < sw->combo_count; i++)
+    free(sw->combos[i].splits);
+  free(sw->combos);
+  sw->combos = NULL;
+  sw->combo_count = 0;
+
+}
+
+static void add_gap(struct ws_sweep *sw, struct ws_sweep_combo *c,
+                    long long frames) {
+
+  double seconds = (double)frames / sw->rate;
+  int b = 0;
+
+  while((b < SWEEP_BUCKETS - 1) && (seconds >= bucket_limits[b]))
+    b++;
+  c->histogram[b]++;
+  c->in_gap = 0;
+
+}
+
+// Runs count samples through every combination.  Returns 0 if out of
+// memory.
+int sweep_block(struct ws_sweep *sw, const void *samples, int count) {
+
+  struct ws_sweep_combo *c = sw->combos;
+  struct ws_sweep_combo *end = sw->combos + sw->combo_count;
+  int frames = count / sw->channels;
+  int i, any_loud, tail, result;
+  long long *s;
+
+  for(i = 0; i < sw->lists.count[SWEEP_THRESHOLD]; i++) {
+
+    any_loud = detect_block(&sw->detectors[i], samples, count, &tail);
+
+    for(; (c < end) && (c->threshold == i); c++) {
+
+      if(any_loud && c->in_gap)
+        add_gap(sw, c, sw->frames - c->gap_start);
+
+      result = split_block(&c->splitter, any_loud, tail, count, frames);
+
+      if(result & SPLIT_NEW_PIECE) {
+        if(c->split_count == c->split_size) {
+          c->split_size = c->split_size ? c->split_size * 2 : 64;
+          s = realloc(c->splits, c->split_size * sizeof(*s));
+          if(s == NULL) {
+            fprintf(stderr, "sweep: Out of memory\n");
+            return 0;
+          }
+          c->splits = s;
+        }
+        c->splits[c->split_count++] = sw->frames;
+        c->in_gap = 1;
+        c->gap_start = sw->frames + frames -
+          c->splitter.silence_counter / sw->channels;
+      }
+    }
+  }
+
+  sw->frames += frames;
+
+  return 1;
+}
+
+// A gap still open at the end runs to the end of the input
+void sweep_finish(struct ws_sweep *sw) {
+
+  int i;
+
+  for(i = 0; i < sw->combo_count; i++)
+    if(sw->combos[i].in_gap)
+      add_gap(sw, &sw->combos[i], sw->frames - sw->combos[i].gap_start);
+
+}
+
+// The table of every combination, then the split times of each
+void sweep_print(struct ws_sweep *sw, FILE *fp, const char *input) {
+
+  struct ws_sweep_combo *c;
+  int i, j;
+
+  fprintf(fp, "Sweep of %s: %.2f seconds, %i combinations\n", input,
+          (double)sw->frames / sw->rate, sw->combo_count);
+
+  fprintf(fp, "%8s %8s %8s %7s", "-t (%)", "-g (s)", "-m (s)", "pieces");
+  for(j = 0; j < SWEEP_BUCKETS; j++)
+    fprintf(fp, " %6s", bucket_names[j]);
+  fprintf(fp, "\n");
+
+  for(i = 0; i < sw->combo_count; i++) {
+    c = &sw->combos[i];
+    fprintf(fp, "%8g %8g %8g %7i",
+            sw->lists.value[SWEEP_THRESHOLD][c->threshold] * 100.0, c->gap,
+            c->min_length, c->split_count + 1);
+    for(j = 0; j < SWEEP_BUCKETS; j++)
+      fprintf(fp, " %6lli", c->histogram[j]);
+    fprintf(fp, "\n");
+  }
+
+  fprintf(fp, "Split times (s):\n");
+  for(i = 0; i < sw->combo_count; i++) {
+    c = &sw->combos[i];
+    fprintf(fp, "  -t %g -g %g -m %g:",
+            sw->lists.value[SWEEP_THRESHOLD][c->threshold] * 100.0, c->gap,
+            c->min_length);
+    for(j = 0; j < c->split_count; j++)
+      fprintf(fp, " %.2f", (double)c->splits[j] / sw->rate);
+    fprintf(fp, "%s\n", c->split_count ? "" : " none");
+  }
+
+}
@@ -0,0 +1,97 @@
+/*  wavsweep.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_SWEEP_H
+#define WAV_SWEEP_H
+
+#include <stdio.h>
+
+#include "wavdetect.h"
+#include "wavsplit.h"
+
+#define MAX_SWEEP       16  // Values in each -S list
+#define SWEEP_BUCKETS   7   // Gap lengths: <0.5, <1, <2, <5, <10, <30, more
+
+// The -S lists; a list that wasn't given is the -t, -g or -m value
+#define SWEEP_THRESHOLD 0
+#define SWEEP_GAP       1
+#define SWEEP_LENGTH    2
+
+struct ws_sweep_lists {
+
+  int count[3];
+  double value[3][MAX_SWEEP];
+
+};
+
+// One combination of threshold, gap and minimum length
+struct ws_sweep_combo {
+
+  int threshold;            // Index into the sweep's detectors
+  double gap;
+  double min_length;
+  struct ws_splitter splitter;
+
+  long long *splits;        // First frame of every piece after the first
+  int split_count;
+  int split_size;
+
+  int in_gap;               // Since a split, until the sound comes back
+  long long gap_start;      // Frame its silence started at
+  long long histogram[SWEEP_BUCKETS];
+
+};
+
+struct ws_sweep {
+
+  struct ws_sweep_lists lists;
+  struct ws_detector detectors[MAX_SWEEP];
+
+  struct ws_sweep_combo *combos;
+  int combo_count;
+
+  unsigned int rate;
+  int channels;
+  long long frames;         // Seen so far
+
+};
+
+// Functions
+
+int sweep_parse(struct ws_sweep_lists *lists, const char *spec);
+
+int sweep_init(struct ws_sweep *sw, const struct ws_sweep_lists *lists,
+               float threshold, double gap, float min_length,
+               double override, int format, int bits, unsigned int rate,
+               int channels);
+void sweep_free(struct ws_sweep *sw);
+
+int sweep_block(struct ws_sweep *sw, const void *samples, int count);
+void sweep_finish(struct ws_sweep *sw);
+void sweep_print(struct ws_sweep *sw, FILE *fp, const char *input);
+
+#endif
@@ -0,0 +1,523 @@
+/*  wavuring.c
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+/*
+    io_uring I/O backend (built with HAVE_IO_URING, see the Makefile).
+
+    The ring is driven with the raw system calls, so liburing isn't needed.
+    Everything here fails softly: if the kernel (or a seccomp filter) says
+    no to io_uring_setup(), uring_init() returns 0 and the callers go back to
+    read() and stdio.
+
+    The writer copies piece data into URING_BUFFER_SIZE buffers and queues
+    each one as a single write as soon as it fills, so small -b values no
+    longer cost a write() per block.  The WAV header fixups for a finished
+    piece are queued with IOSQE_IO_DRAIN so they land after the data, and
+    the file is closed when its last write completes; only -e has to wait
+    for that.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#include "wavuring.h"
+
+#ifdef HAVE_IO_URING
+
+static int sys_io_uring_setup(unsigned int entries,
+                              struct io_uring_params *p) {
+
+  return syscall(__NR_io_uring_setup, entries, p);
+
+}
+
+static int sys_io_uring_enter(int fd, unsigned int submit,
+                              unsigned int wait, unsigned int flags) {
+
+  return syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+
+}
+
+int uring_init(struct ws_uring *u, unsigned int entries) {
+
+  struct io_uring_params p;
+  unsigned char *sq, *cq;
+
+  memset(u, 0, sizeof(*u));
+  memset(&p, 0, sizeof(p));
+
+  u->fd = sys_io_uring_setup(entries, &p);
+  if(u->fd == -1)
+    return 0;
+
+  u->entries = p.sq_entries;
+  u->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+  if(p.features & IORING_FEAT_SINGLE_MMAP) {
+    if(u->cq_len > u->sq_len)
+      u->sq_len = u->cq_len;
+    u->cq_len = 0;
+  }
+
+  u->sq_ring = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if(u->sq_ring == MAP_FAILED) {
+    u->sq_ring = NULL;
+    uring_exit(u);
+    return 0;
+  }
+
+  if(u->cq_len) {
+    u->cq_ring = mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    if(u->cq_ring == MAP_FAILED) {
+      u->cq_ring = NULL;
+      uring_exit(u);
+      return 0;
+    }
+  } else
+    u->cq_ring = u->sq_ring;
+
+  u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if(u->sqes == MAP_FAILED) {
+    u->sqes = NULL;
+    uring_exit(u);
+    return 0;
+  }
+
+  sq = u->sq_ring;
+  u->sq_head = (unsigned int *)(sq + p.sq_off.head);
+  u->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+  u->sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+  u->sq_array = (unsigned int *)(sq + p.sq_off.array);
+
+  cq = u->cq_ring;
+  u->cq_head = (unsigned int *)(cq + p.cq_off.head);
+  u->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+  u->cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+  u->cqes = cq + p.cq_off.cqes;
+
+  return 1;
+}
+
+void uring_exit(struct ws_uring *u) {
+
+  if(u->sqes)
+    munmap(u->sqes, u->sqes_len);
+  if(u->cq_ring && (u->cq_ring != u->sq_ring))
+    munmap(u->cq_ring, u->cq_len);
+  if(u->sq_ring)
+    munmap(u->sq_ring, u->sq_len);
+  if(u->fd != -1)
+    close(u->fd);
+
+  memset(u, 0, sizeof(*u));
+  u->fd = -1;
+
+}
+
+// Puts a read or write in the submission queue.  Returns 0 if the queue is
+// full; uring_submit() makes room.  With drain set, the request waits for
+// everything queued before it.
+int uring_queue(struct ws_uring *u, int op, int fd, void *buf,
+                unsigned int len, off_t offset, unsigned long long data,
+                int drain) {
+
+  struct io_uring_sqe *sqe;
+  unsigned int tail = *u->sq_tail;
+  unsigned int head = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE);
+  unsigned int idx;
+
+  if(tail - head == u->entries)
+    return 0;
+
+  idx = tail & *u->sq_mask;
+  sqe = (struct io_uring_sqe *)u->sqes + idx;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = (op == URING_READ) ? IORING_OP_READ : IORING_OP_WRITE;
+  sqe->flags = drain ? IOSQE_IO_DRAIN : 0;
+  sqe->fd = fd;
+  sqe->addr = (unsigned long)buf;
+  sqe->len = len;
+  sqe->off = offset;
+  sqe->user_data = data;
+
+  u->sq_array[idx] = idx;
+  __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  u->queued++;
+
+  return 1;
+}
+
+static int uring_enter(struct ws_uring *u, unsigned int wait) {
+
+  int ret;
+
+  do {
+    ret = sys_io_uring_enter(u->fd, u->queued, wait,
+                             wait ? IORING_ENTER_GETEVENTS : 0);
+  } while((ret == -1) && (errno == EINTR));
+
+  u->enters++;
+
+  if(ret == -1) {
+    fprintf(stderr, "io_uring: Submit failed. Error = %d.\n", errno);
+    return 0;
+  }
+
+  u->queued -= ret;
+  u->inflight += ret;
+
+  return 1;
+}
+
+// Hands everything queued to the kernel
+int uring_submit(struct ws_uring *u) {
+
+  if(u->queued == 0)
+    return 1;
+
+  return uring_enter(u, 0);
+}
+
+// Takes one completion off the ring.  Returns 0 if there is none (or, with
+// wait set, if there is nothing in flight to wait for).
+int uring_reap(struct ws_uring *u, unsigned long long *data, int *res,
+               int wait) {
+
+  struct io_uring_cqe *cqe;
+  unsigned int head, tail;
+
+  for(;;) {
+    head = *u->cq_head;
+    tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    if(head != tail)
+      break;
+
+    if(!wait || (u->inflight + u->queued == 0))
+      return 0;
+
+    if(!uring_enter(u, 1))
+      return 0;
+  }
+
+  cqe = (struct io_uring_cqe *)u->cqes + (head & *u->cq_mask);
+  *data = cqe->user_data;
+  *res = cqe->res;
+
+  __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+
+  u->inflight--;
+
+  return 1;
+}
+
+#else
+
+int uring_init(struct ws_uring *u, unsigned int entries) {
+
+  memset(u, 0, sizeof(*u));
+  u->fd = -1;
+
+  return 0;
+}
+
+void uring_exit(struct ws_uring *u) {
+}
+
+int uring_queue(struct ws_uring *u, int op, int fd, void *buf,
+                unsigned int len, off_t offset, unsigned long long data,
+                int drain) {
+
+  return 0;
+}
+
+int uring_submit(struct ws_uring *u) {
+
+  return 0;
+}
+
+int uring_reap(struct ws_uring *u, unsigned long long *data, int *res,
+               int wait) {
+
+  return 0;
+}
+
+#endif
+
+// user_data of a writer request: the file slot, and the buffer (or
+// WRITER_PATCH for a header fixup)
+#define WRITER_PATCH    0xff
+#define WRITER_DATA(slot, tag)  (((unsigned long long)(slot) << 8) | (tag))
+
+static void writer_done(struct ws_writer *w, struct writer_file *f) {
+
+  if(f->closing && (f->ops == 0)) {
+    if(close(f->fd) == -1) {
+      fprintf(stderr, "output: Error closing a piece. Error = %d.\n", errno);
+      w->error = 1;
+    }
+    f->fd = -1;
+    f->closing = 0;
+  }
+
+}
+
+// Deals with one completion; returns 0 if there was none
+static int writer_reap(struct ws_writer *w, int wait) {
+
+  unsigned long long data;
+  struct writer_file *f;
+  int res, tag;
+  ssize_t count;
+
+  if(!uring_reap(&w->ring, &data, &res, wait))
+    return 0;
+
+  f = &w->slots[data >> 8];
+  tag = data & 0xff;
+
+  if(res < 0) {
+    fprintf(stderr, "output: Write error. Error = %d.\n", -res);
+    w->error = 1;
+  } else if(tag != WRITER_PATCH) {
+    // A short write to a regular file is rare enough to finish by hand
+    while((size_t)res < w->lengths[tag]) {
+      count = pwrite(f->fd, w->buffers[tag] + res, w->lengths[tag] - res,
+                     w->offsets[tag] + res);
+      if(count <= 0) {
+        if((count == -1) && (errno == EINTR))
+          continue;
+        fprintf(stderr, "output: Write error. Error = %d.\n", errno);
+        w->error = 1;
+        break;
+      }
+      res += count;
+    }
+  }
+
+  if(tag != WRITER_PATCH)
+    w->files[tag] = -1;
+
+  f->ops--;
+  writer_done(w, f);
+
+  return 1;
+}
+
+static void writer_queue(struct ws_writer *w, void *buf, size_t len,
+                         off_t offset, int tag, int drain) {
+
+  while(!uring_queue(&w->ring, URING_WRITE, w->slots[w->file].fd, buf, len,
+                     offset, WRITER_DATA(w->file, tag), drain))
+    uring_submit(&w->ring);
+
+  w->slots[w->file].ops++;
+
+}
+
+// Sends the current buffer off and moves on to the next free one
+static void writer_flush(struct ws_writer *w) {
+
+  if(w->fill == 0)
+    return;
+
+  w->lengths[w->cur] = w->fill;
+  w->offsets[w->cur] = w->pos;
+  w->files[w->cur] = w->file;
+  writer_queue(w, w->buffers[w->cur], w->fill, w->pos, w->cur, 0);
+  uring_submit(&w->ring);
+
+  w->pos += w->fill;
+  w->fill = 0;
+  w->cur = (w->cur + 1) % URING_BUFFERS;
+
+  while(w->files[w->cur] != -1)
+    if(!writer_reap(w, 1))
+      break;
+
+}
+
+// Returns 0 if io_uring can't be used
+int writer_init(struct ws_writer *w) {
+
+  int i;
+
+  memset(w, 0, sizeof(*w));
+
+  w->file = -1;
+
+  if(!uring_init(&w->ring, URING_ENTRIES))
+    return 0;
+
+  for(i = 0; i < URING_BUFFERS; i++) {
+    w->buffers[i] = malloc(URING_BUFFER_SIZE);
+    w->files[i] = -1;
+    if(w->buffers[i] == NULL) {
+      writer_finish(w);
+      return 0;
+    }
+  }
+
+  for(i = 0; i < WRITER_FILES; i++)
+    w->slots[i].fd = -1;
+
+  return 1;
+}
+
+int writer_open(struct ws_writer *w, const char *name) {
+
+  int i;
+
+  for(;;) {
+    for(i = 0; i < WRITER_FILES; i++)
+      if((w->slots[i].fd == -1) && (w->slots[i].ops == 0))
+        break;
+    if(i < WRITER_FILES)
+      break;
+    // Every slot is a piece still being written
+    if(!writer_reap(w, 1))
+      return 0;
+  }
+
+  w->slots[i].fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if(w->slots[i].fd == -1)
+    return 0;
+
+  w->slots[i].patches = 0;
+  w->file = i;
+  w->pos = 0;
+  w->fill = 0;
+
+  return 1;
+}
+
+void writer_write(struct ws_writer *w, const void *data, size_t size) {
+
+  size_t count;
+
+  while(size > 0) {
+    count = URING_BUFFER_SIZE - w->fill;
+    if(count > size)
+      count = size;
+
+    memcpy(w->buffers[w->cur] + w->fill, data, count);
+    w->fill += count;
+    data = (const unsigned char *)data + count;
+    size -= count;
+
+    if(w->fill == URING_BUFFER_SIZE)
+      writer_flush(w);
+  }
+
+}
+
+// Overwrites size bytes (at most WRITER_PATCH_SIZE) at offset of the open
+// piece, after everything written so far
+void writer_patch(struct ws_writer *w, off_t offset, const void *data,
+                  size_t size) {
+
+  struct writer_file *f = &w->slots[w->file];
+
+  // Still in the buffer, as it is for any piece under a megabyte
+  if((w->pos == 0) && (offset + size <= w->fill)) {
+    memcpy(w->buffers[w->cur] + offset, data, size);
+    return;
+  }
+
+  writer_flush(w);
+
+  if(f->patches == WRITER_PATCHES) {
+    fprintf(stderr, "output: Too many header fixups\n");
+    w->error = 1;
+    return;
+  }
+
+  memcpy(f->patch[f->patches], data, size);
+  writer_queue(w, f->patch[f->patches], size, offset, WRITER_PATCH, 1);
+  f->patches++;
+
+}
+
+// Finishes the open piece.  With wait set, returns only after the piece is
+// on disk and closed.
+void writer_close(struct ws_writer *w, int wait) {
+
+  struct writer_file *f;
+
+  if(w->file == -1)
+    return;
+
+  f = &w->slots[w->file];
+
+  writer_flush(w);
+  uring_submit(&w->ring);
+
+  f->closing = 1;
+  writer_done(w, f);
+
+  while(wait && (f->fd != -1))
+    if(!writer_reap(w, 1))
+      break;
+
+  w->file = -1;
+
+}
+
+// Waits for every write and frees the writer
+void writer_finish(struct ws_writer *w) {
+
+  int i;
+
+  writer_close(w, 0);
+
+  while(writer_reap(w, 1))
+    ;
+
+  for(i = 0; i < URING_BUFFERS; i++)
+    free(w->buffers[i]);
+
+  uring_exit(&w->ring);
+
+}
@@ -0,0 +1,120 @@
+/*  wavuring.h
+
+  wavsilence - A program to split a WAV file into smaller pieces, based on
+               detected silence
+
+  Copyright 2003 Daniel Smith (dsmith@danplanet.com)
+
+   New project location:
+      https://github.com/DOSx86/wavsilence
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+*/
+
+
+#ifndef WAV_URING_H
+#define WAV_URING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define URING_ENTRIES       64
+#define URING_BUFFERS       4               // Reads or writes in flight
+#define URING_BUFFER_SIZE   (1024 * 1024)
+
+#define URING_READ          0
+#define URING_WRITE         1
+
+// Raw io_uring instance (no liburing).  Only one thread may use it.
+struct ws_uring {
+
+  int fd;                           // -1 if not set up
+  unsigned int entries;
+
+  void *sq_ring;
+  void *cq_ring;
+  void *sqes;
+  size_t sq_len;
+  size_t cq_len;
+  size_t sqes_len;
+
+  unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned int *cq_head, *cq_tail, *cq_mask;
+  void *cqes;
+
+  unsigned int queued;              // Not yet submitted
+  unsigned int inflight;            // Submitted, not yet reaped
+  long long enters;                 // io_uring_enter() calls
+
+};
+
+// Piece output through io_uring.  Writes are copied into big buffers that
+// go to the kernel as they fill; the header fixups are queued behind them,
+// and a finished piece is closed once all of its writes are done.
+
+#define WRITER_FILES        8
+#define WRITER_PATCHES      4
+#define WRITER_PATCH_SIZE   128         // A whole WAV header
+
+struct writer_file {
+
+  int fd;                           // -1 if the slot is free
+  int ops;                          // Writes in flight
+  int closing;
+  int patches;
+  unsigned char patch[WRITER_PATCHES][WRITER_PATCH_SIZE];
+
+};
+
+struct ws_writer {
+
+  struct ws_uring ring;
+
+  unsigned char *buffers[URING_BUFFERS];
+  size_t lengths[URING_BUFFERS];    // Of the write in flight
+  off_t offsets[URING_BUFFERS];
+  int files[URING_BUFFERS];         // Slot the write belongs to, -1 if idle
+  int cur;
+  size_t fill;
+
+  struct writer_file slots[WRITER_FILES];
+  int file;                         // Slot being written, -1 if none
+  off_t pos;                        // File offset of buffers[cur]
+
+  int error;
+
+};
+
+// Functions
+
+int uring_init(struct ws_uring *u, unsigned int entries);
+void uring_exit(struct ws_uring *u);
+int uring_queue(struct ws_uring *u, int op, int fd, void *buf,
+                unsigned int len, off_t offset, unsigned long long data,
+                int drain);
+int uring_submit(struct ws_uring *u);
+int uring_reap(struct ws_uring *u, unsigned long long *data, int *res,
+               int wait);
+
+int writer_init(struct ws_writer *w);
+int writer_open(struct ws_writer *w, const char *name);
+void writer_write(struct ws_writer *w, const void *data, size_t size);
+void writer_patch(struct ws_writer *w, off_t offset, const void *data,
+                  size_t size);
+void writer_close(struct ws_writer *w, int wait);
+void writer_finish(struct ws_writer *w);
+
+#endif